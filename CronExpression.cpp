@@ -0,0 +1,292 @@
+#include "CronExpression.h"
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+using namespace std::chrono;
+
+static constexpr const char * monthNames[] = {"JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"};
+static constexpr const char * weekdayNames[] = {"SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
+
+static inline int nextBit(std::uint64_t mask, unsigned from) //-1 - no bit at or above from
+{
+    if(from >= 64) return -1;
+    mask = mask >> from << from;
+    return (mask) ? std::countr_zero(mask) : -1;
+}
+
+static bool parseValue(std::string_view value, unsigned first, const char * const * names, unsigned count, unsigned & result)
+{
+    if(value.empty()) return false;
+
+    if(names && value.size() == 3 && (value[0] < '0' || value[0] > '9'))
+    {
+       for(unsigned i = 0; i < count; i++)
+       {
+           bool equal = true;
+           for(int c = 0; c < 3; c++) equal = equal && (value[c] & ~0x20) == names[i][c];
+
+           if(equal){ result = first + i; return true; }
+       }
+
+       return false;
+    }
+
+    if(value.size() > 2) return false;
+
+    result = 0;
+
+    for(char c : value)
+    {
+        if(c < '0' || c > '9') return false;
+        result = result * 10 + (c - '0');
+    }
+
+    return true;
+}
+
+//[low, high] - the values of the field, names - of the values from first
+static bool parseField(std::string_view field, unsigned low, unsigned high, const char * const * names, unsigned first, unsigned count, std::uint64_t & mask)
+{
+    mask = 0;
+
+    while(true)
+    {
+        const std::size_t comma = field.find(',');
+        std::string_view item = field.substr(0, comma);
+
+        unsigned begin = low, end = high, step = 1;
+
+        if(const std::size_t slash = item.find('/'); slash != std::string_view::npos)
+        {
+           if(!parseValue(item.substr(slash + 1), 0, nullptr, 0, step) || step == 0) return false;
+           item = item.substr(0, slash);
+        }
+        else step = 0; //n without a step is n alone
+
+        if(item != "*")
+        {
+           const std::size_t dash = item.find('-');
+
+           if(!parseValue(item.substr(0, dash), first, names, count, begin)) return false;
+
+           if(dash != std::string_view::npos){ if(!parseValue(item.substr(dash + 1), first, names, count, end)) return false; }
+           else if(step == 0) end = begin;
+
+           if(begin < low || end > high || begin > end) return false;
+        }
+
+        for(unsigned value = begin; value <= end; value += (step) ? step : 1) mask |= std::uint64_t(1) << value;
+
+        if(comma == std::string_view::npos) return true;
+        field.remove_prefix(comma + 1);
+    }
+}
+
+CronExpression::CronExpression(){}
+
+CronExpression::CronExpression(std::string_view value){ parse(value); }
+
+bool CronExpression::isValid() const
+{
+    return !source.empty();
+}
+
+const std::string & CronExpression::text() const
+{
+    return source;
+}
+
+bool CronExpression::parse(std::string_view value)
+{
+    *this = CronExpression();
+
+    std::string_view fields[6];
+    std::size_t count = 0;
+
+    while(true)
+    {
+        const std::size_t begin = value.find_first_not_of(" \t");
+        if(begin == std::string_view::npos) break;
+
+        value.remove_prefix(begin);
+        const std::size_t end = value.find_first_of(" \t");
+
+        if(count == 6) return false;
+        fields[count++] = value.substr(0, end);
+        value.remove_prefix(std::min(end, value.size()));
+    }
+
+    if(count == 5) //mm hh DD MM W
+    {
+       for(std::size_t i = 5; i > 0; i--) fields[i] = fields[i - 1];
+       fields[0] = "0";
+    }
+    else if(count != 6) return false;
+
+    std::uint64_t hours, days, months, weekdays;
+
+    if(!parseField(fields[0], 0, 59, nullptr, 0, 0, seconds) ||
+       !parseField(fields[1], 0, 59, nullptr, 0, 0, minutes) ||
+       !parseField(fields[2], 0, 23, nullptr, 0, 0, hours) ||
+       !parseField(fields[3], 1, 31, nullptr, 0, 0, days) ||
+       !parseField(fields[4], 1, 12, monthNames, 1, 12, months) ||
+       !parseField(fields[5], 0, 7, weekdayNames, 0, 7, weekdays))
+    {
+       *this = CronExpression();
+       return false;
+    }
+
+    this->hours = static_cast<std::uint32_t>(hours);
+    this->days = static_cast<std::uint32_t>(days);
+    this->months = static_cast<std::uint16_t>(months);
+    this->weekdays = static_cast<std::uint8_t>((weekdays | weekdays >> 7) & 0x7F); //7 is Sunday
+    anyDay = fields[3].starts_with('*');
+    anyWeekday = fields[5].starts_with('*');
+
+    //a month with a restricted DD alone must have one of its days, Feb 29 counts
+    if(!anyDay && anyWeekday)
+    {
+       static constexpr unsigned lengths[] = {0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+       bool possible = false;
+       for(unsigned month = 1; month <= 12; month++) possible = possible || ((this->months >> month & 1) && std::countr_zero(this->days) <= int(lengths[month]));
+
+       if(!possible)
+       {
+          *this = CronExpression();
+          return false;
+       }
+    }
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+        if(i) source += ' ';
+        source += (count == 5) ? fields[i + 1] : fields[i];
+    }
+
+    return true;
+}
+
+std::uint64_t CronExpression::daysOf(int year, unsigned month) const
+{
+    const ::year_month ym{::year(year), ::month(month)};
+    const unsigned length = static_cast<unsigned>(year_month_day_last{ym.year(), month_day_last{ym.month()}}.day());
+    const unsigned first = weekday{sys_days{ym / 1}}.c_encoding();
+
+    std::uint64_t week = ((weekdays >> first) | (weekdays << (7 - first))) & 0x7F; //bit i - weekday of the day i + 1
+    week |= week << 7;
+    week |= week << 14;
+    week |= week << 28;
+    week <<= 1;
+
+    const std::uint64_t dates = (anyDay || anyWeekday) ? (days & week) : (days | week);
+    return dates & (((std::uint64_t(1) << length) - 1) << 1);
+}
+
+std::int64_t CronExpression::next(std::int64_t from) const
+{
+    if(!isValid()) return -1;
+
+    const ::seconds time(from);
+    const sys_days date = floor<::days>(sys_seconds(time));
+    const year_month_day ymd(date);
+    const hh_mm_ss<::seconds> clock(time - date.time_since_epoch());
+
+    int year = static_cast<int>(ymd.year());
+    unsigned month = static_cast<unsigned>(ymd.month());
+    unsigned day = static_cast<unsigned>(ymd.day());
+    unsigned hour = static_cast<unsigned>(clock.hours().count());
+    unsigned minute = static_cast<unsigned>(clock.minutes().count());
+    unsigned second = static_cast<unsigned>(clock.seconds().count());
+
+    //every valid expression matches a date within the 400 years of the Gregorian cycle
+    for(const int last = year + 400; year <= last; )
+    {
+        int found = nextBit(months, month);
+        if(found < 0){ year++; month = 1; day = 1; hour = minute = second = 0; continue; }
+        if(unsigned(found) != month){ month = found; day = 1; hour = minute = second = 0; }
+
+        found = nextBit(daysOf(year, month), day);
+        if(found < 0){ month++; day = 1; hour = minute = second = 0; continue; }
+        if(unsigned(found) != day){ day = found; hour = minute = second = 0; }
+
+        found = nextBit(hours, hour);
+        if(found < 0){ day++; hour = minute = second = 0; continue; }
+        if(unsigned(found) != hour){ hour = found; minute = second = 0; }
+
+        found = nextBit(minutes, minute);
+        if(found < 0){ hour++; minute = second = 0; continue; }
+        if(unsigned(found) != minute){ minute = found; second = 0; }
+
+        found = nextBit(seconds, second);
+        if(found < 0){ minute++; second = 0; continue; }
+
+        const sys_days fire{::year(year) / ::month(month) / ::day(day)};
+        return (fire.time_since_epoch() + ::hours(hour) + ::minutes(minute) + ::seconds(found)).count();
+    }
+
+    return -1;
+}
+
+bool CronExpression::isSubDaily() const
+{
+    return std::popcount(seconds) * std::popcount(minutes) * std::popcount(hours) > 1;
+}
+
+//------------------intern table--------------------
+
+namespace
+{
+    struct CronTable
+    {
+        static constexpr unsigned chunkBits = 8;
+        static constexpr std::size_t chunkCount = 4096; //a million expressions
+
+        std::mutex mutex; //writers
+        std::unordered_map<std::string, std::uint32_t> ids;
+        std::unique_ptr<CronExpression[]> chunks[chunkCount];
+        std::atomic<std::uint32_t> count = 0; //published, an expression is complete before its id
+    };
+
+    CronTable & cronTable()
+    {
+        static CronTable table;
+        return table;
+    }
+}
+
+std::uint32_t CronExpression::intern(const CronExpression & expression)
+{
+    if(!expression.isValid()) return 0;
+
+    CronTable & table = cronTable();
+    std::lock_guard<std::mutex>lock(table.mutex);
+
+    if(auto it = table.ids.find(expression.source); it != table.ids.end()) return it->second;
+
+    const std::uint32_t index = table.count.load(std::memory_order_relaxed);
+    if(index >= CronTable::chunkCount << CronTable::chunkBits) return 0;
+
+    auto & chunk = table.chunks[index >> CronTable::chunkBits];
+    if(!chunk) chunk = std::make_unique<CronExpression[]>(std::size_t(1) << CronTable::chunkBits);
+
+    chunk[index & ((1u << CronTable::chunkBits) - 1)] = expression;
+    table.ids.emplace(expression.source, index + 1);
+    table.count.store(index + 1, std::memory_order_release);
+
+    return index + 1;
+}
+
+const CronExpression * CronExpression::find(std::uint32_t id)
+{
+    CronTable & table = cronTable();
+    if(id == 0 || id > table.count.load(std::memory_order_acquire)) return nullptr;
+
+    const std::uint32_t index = id - 1;
+    return &table.chunks[index >> CronTable::chunkBits][index & ((1u << CronTable::chunkBits) - 1)];
+}
@@ -0,0 +1,59 @@
+#ifndef CRONEXPRESSION_H
+#define CRONEXPRESSION_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+/* Cron expression compiled into one bitmask per field
+
+   ss mm hh DD MM W, or mm hh DD MM W with the seconds 0
+
+   field: *, n, a-b, each with an optional step /s (n/s - from n to the end), and comma lists of them: 0,15,30-45/5
+   ss, mm - [0,59], hh - [0,23], DD - [1,31], MM - [1,12] or JAN-DEC, W - [0,7] or SUN-SAT, 0 and 7 - Sunday
+
+   When both DD and W are restricted (neither starts with '*'), a date matching either of them fires, as in cron.
+   An expression that no date can match (30 2 for Feb 30) is invalid.
+
+   next() goes down from the month to the second, each field is one count-trailing-zeros on its mask shifted
+   to the current value, a field without a bit left carries into the one above it. The days of a month are the
+   DD mask and the W mask rotated to the weekday of the 1st, so no dates are iterated.
+
+   Tasks keep the 32-bit id of an interned expression. The table only grows, the same text gets the same id,
+   find() reads it without a lock from any thread.
+*/
+
+class CronExpression final
+{
+public:
+
+    explicit CronExpression();
+    explicit CronExpression(std::string_view value);
+
+    bool isValid() const;
+    bool parse(std::string_view value);
+    const std::string & text() const; //the fields separated by single spaces
+
+    //first matching second at or after from, seconds since the epoch of local time, -1 - invalid
+    std::int64_t next(std::int64_t from) const;
+    bool isSubDaily() const; //more than one fire a day
+
+    static std::uint32_t intern(const CronExpression & expression); //0 - invalid
+    static const CronExpression * find(std::uint32_t id); //nullptr - not interned
+
+private:
+
+    std::uint64_t seconds = 0; //bit i - value i
+    std::uint64_t minutes = 0;
+    std::uint32_t hours = 0;
+    std::uint32_t days = 0;    //bits 1-31
+    std::uint16_t months = 0;  //bits 1-12
+    std::uint8_t weekdays = 0; //bits 0-6, Sunday 0
+    bool anyDay = true;        //DD starts with '*'
+    bool anyWeekday = true;
+    std::string source;
+
+    std::uint64_t daysOf(int year, unsigned month) const; //bits 1-31, the matching days of the month
+};
+
+#endif // CRONEXPRESSION_H
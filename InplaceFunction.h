@@ -0,0 +1,117 @@
+#ifndef INPLACEFUNCTION_H
+#define INPLACEFUNCTION_H
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/* std::function without the heap
+
+   The callable is stored in a buffer of Capacity bytes inside the object. The constructor is constrained on fits<F>,
+   a callable that does not fit or may throw on a move (a const std::string capture is copied) does not convert,
+   so std::is_constructible and overload resolution see it and the caller can fall back to std::function.
+   Copies and moves copy and move the callable in place, a std::function or a function pointer that is empty
+   gives an empty InplaceFunction.
+*/
+
+template<typename Signature, std::size_t Capacity = 56>
+class InplaceFunction;
+
+template<typename R, typename... Args, std::size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> final
+{
+    struct Operations
+    {
+        R (*invoke)(void * callable, Args &&... args);
+        void (*copy)(void * to, const void * from);
+        void (*move)(void * to, void * from) noexcept; //and destroys from
+        void (*destroy)(void * callable) noexcept;
+    };
+
+    template<typename F>
+    static constexpr Operations operations =
+    {
+        [](void * callable, Args &&... args) -> R { return std::invoke(*static_cast<F*>(callable), std::forward<Args>(args)...); },
+        [](void * to, const void * from){ ::new(to) F(*static_cast<const F*>(from)); },
+        [](void * to, void * from) noexcept { ::new(to) F(std::move(*static_cast<F*>(from))); static_cast<F*>(from)->~F(); },
+        [](void * callable) noexcept { static_cast<F*>(callable)->~F(); }
+    };
+
+    alignas(std::max_align_t) mutable unsigned char storage[Capacity];
+    const Operations * operations_ = nullptr;
+
+public:
+
+    template<typename F, typename D = std::decay_t<F>>
+    static constexpr bool fits = sizeof(D) <= Capacity && alignof(D) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<D> &&
+                                 std::is_copy_constructible_v<D> && std::is_invocable_r_v<R, D&, Args...>;
+
+    InplaceFunction() noexcept = default;
+
+    template<typename F, typename D = std::decay_t<F>> requires (!std::is_same_v<D, InplaceFunction> && fits<F>)
+    InplaceFunction(F && callable)
+    {
+        if constexpr(std::is_pointer_v<D> || std::is_member_pointer_v<D> || std::is_same_v<D, std::function<R(Args...)>>)
+        {
+           if(!callable) return;
+        }
+
+        ::new(static_cast<void*>(storage)) D(std::forward<F>(callable));
+        operations_ = &operations<D>;
+    }
+
+    InplaceFunction(const InplaceFunction & other) : operations_(other.operations_)
+    {
+        if(operations_) operations_->copy(storage, other.storage);
+    }
+
+    InplaceFunction(InplaceFunction && other) noexcept : operations_(other.operations_)
+    {
+        if(operations_) operations_->move(storage, other.storage);
+        other.operations_ = nullptr;
+    }
+
+    ~InplaceFunction()
+    {
+        if(operations_) operations_->destroy(storage);
+    }
+
+    InplaceFunction & operator=(const InplaceFunction & other)
+    {
+        if(this != &other)
+        {
+           InplaceFunction copy(other);
+           *this = std::move(copy);
+        }
+
+        return *this;
+    }
+
+    InplaceFunction & operator=(InplaceFunction && other) noexcept
+    {
+        if(this != &other)
+        {
+           if(operations_) operations_->destroy(storage);
+           operations_ = other.operations_;
+           if(operations_) operations_->move(storage, other.storage);
+           other.operations_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return operations_ != nullptr;
+    }
+
+    R operator()(Args... args) const
+    {
+        if(!operations_) throw std::bad_function_call();
+        return operations_->invoke(storage, std::forward<Args>(args)...);
+    }
+};
+
+#endif // INPLACEFUNCTION_H
@@ -0,0 +1,245 @@
+#include "Journal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+#ifdef WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static constexpr std::size_t headerSize = 17;
+
+static std::uint32_t checksum(std::uint64_t sequence, unsigned char kind, std::string_view payload, std::string_view tail = {}) //FNV-1a
+{
+    std::uint32_t hash = 2166136261u;
+    auto mix = [&](const void * data, std::size_t size)
+    {
+        for(std::size_t i = 0; i < size; i++) hash = (hash ^ static_cast<const unsigned char*>(data)[i]) * 16777619u;
+    };
+
+    mix(&sequence, sizeof(sequence));
+    mix(&kind, 1);
+    mix(payload.data(), payload.size());
+    mix(tail.data(), tail.size());
+
+    return hash;
+}
+
+static bool flush(std::FILE * file)
+{
+    if(std::fflush(file) != 0) return false;
+
+#ifdef WIN32
+    return _commit(_fileno(file)) == 0;
+#elif defined(__linux__)
+    return fdatasync(fileno(file)) == 0;
+#else
+    return fsync(fileno(file)) == 0;
+#endif
+}
+
+Journal::Journal(){}
+
+Journal::~Journal()
+{
+    close();
+}
+
+bool Journal::isOpen() const
+{
+    return file != nullptr;
+}
+
+bool Journal::replayFile(const std::string & path, const Replay & replay, std::uint64_t after, std::uint64_t & last, std::uint64_t * valid)
+{
+    std::ifstream in(path, std::ios::binary);
+    if(!in) return false;
+
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::size_t at = 0;
+
+    while(data.size() - at >= headerSize)
+    {
+        std::uint32_t size, sum;
+        std::uint64_t sequence;
+        std::memcpy(&size, data.data() + at, 4);
+        std::memcpy(&sum, data.data() + at + 4, 4);
+        std::memcpy(&sequence, data.data() + at + 8, 8);
+        const unsigned char kind = static_cast<unsigned char>(data[at + 16]);
+
+        if(data.size() - at - headerSize < size) break; //torn by a crash during the write
+
+        const std::string_view payload(data.data() + at + headerSize, size);
+        if(checksum(sequence, kind, payload) != sum || sequence <= last) break;
+
+        if(sequence > after) replay(sequence, kind, payload);
+        last = sequence;
+        at += headerSize + size;
+    }
+
+    if(valid) *valid = at;
+
+    return true;
+}
+
+bool Journal::open(const std::string & path, const Replay & replay, std::uint64_t after)
+{
+    close();
+
+    std::uint64_t last = 0;
+    std::uint64_t valid = 0;
+
+    replayFile(path + ".old", replay, after, last, nullptr); //left by a crash between rotate() and dropRotated()
+
+    if(replayFile(path, replay, after, last, &valid))
+    {
+       std::error_code error;
+       if(std::filesystem::file_size(path, error) != valid) std::filesystem::resize_file(path, valid, error);
+       if(error) return false;
+    }
+
+    file = std::fopen(path.c_str(), "ab");
+    if(!file) return false;
+
+    this->path = path;
+    appended = durable = std::max(last, after);
+    failed = false;
+    writer = std::jthread([this](std::stop_token token){ write(token); });
+
+    return true;
+}
+
+void Journal::close()
+{
+    if(!writer.joinable()) return;
+
+    writer.request_stop();
+    pending.notify_all();
+    writer.join(); //writes the last group before it returns
+
+    if(file) std::fclose(file);
+    file = nullptr;
+}
+
+std::uint64_t Journal::append(unsigned char kind, std::string_view head, std::string_view tail)
+{
+    std::lock_guard<std::mutex>lock(mutex);
+
+    const std::uint64_t sequence = ++appended;
+    const std::uint32_t size = static_cast<std::uint32_t>(head.size() + tail.size());
+    const std::uint32_t sum = checksum(sequence, kind, head, tail);
+
+    group.append(reinterpret_cast<const char*>(&size), 4);
+    group.append(reinterpret_cast<const char*>(&sum), 4);
+    group.append(reinterpret_cast<const char*>(&sequence), 8);
+    group.push_back(static_cast<char>(kind));
+    group.append(head).append(tail);
+
+    pending.notify_one();
+
+    return sequence;
+}
+
+bool Journal::sync()
+{
+    std::unique_lock<std::mutex>lock(mutex);
+    written.wait(lock, [this]{ return durable >= appended || failed || !file; });
+    return !failed;
+}
+
+void Journal::write(std::stop_token token)
+{
+    std::string current;
+
+    std::unique_lock<std::mutex>lock(mutex);
+
+    while(true)
+    {
+        pending.wait(lock, token, [this]{ return !group.empty(); });
+        if(group.empty()) return; //stopped with nothing left
+
+        current.swap(group);
+        const std::uint64_t last = appended;
+
+        lock.unlock();
+
+        const bool ok = file && std::fwrite(current.data(), 1, current.size(), file) == current.size() && flush(file);
+        current.clear();
+
+        lock.lock();
+
+        if(!ok) failed = true;
+        durable = last;
+        written.notify_all();
+    }
+}
+
+std::uint64_t Journal::rotate()
+{
+    sync();
+
+    std::lock_guard<std::mutex>lock(mutex); //the writer is idle, the group is empty
+
+    if(file) std::fclose(file);
+
+    const std::string old = path + ".old";
+
+    std::error_code error;
+    if(!std::filesystem::exists(old, error)) std::filesystem::rename(path, old, error);
+    else if(!appendFile(path, old)) error = std::make_error_code(std::errc::io_error); //the log stays, its records are not lost
+
+    file = std::fopen(path.c_str(), (error) ? "ab" : "wb");
+    if(!file) failed = true;
+
+    return appended;
+}
+
+bool Journal::appendFile(const std::string & from, const std::string & to)
+{
+    std::ifstream in(from, std::ios::binary);
+    if(!in) return false;
+
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    std::FILE * out = std::fopen(to.c_str(), "ab");
+    if(!out) return false;
+
+    const bool ok = std::fwrite(data.data(), 1, data.size(), out) == data.size() && flush(out);
+    std::fclose(out);
+
+    return ok;
+}
+
+bool Journal::writeFile(const std::string & path, std::string_view data)
+{
+    const std::string temporary = path + ".tmp";
+
+    std::FILE * out = std::fopen(temporary.c_str(), "wb");
+    if(!out) return false;
+
+    const bool ok = std::fwrite(data.data(), 1, data.size(), out) == data.size() && flush(out);
+    std::fclose(out);
+
+    std::error_code error;
+    if(ok) std::filesystem::rename(temporary, path, error);
+
+    if(!ok || error)
+    {
+       std::filesystem::remove(temporary, error);
+       return false;
+    }
+
+    return true;
+}
+
+void Journal::dropRotated()
+{
+    std::error_code error;
+    std::filesystem::remove(path + ".old", error);
+}
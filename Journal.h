@@ -0,0 +1,70 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+
+/* Append-only log with group commit
+
+   append() copies the record into the open group under a mutex and returns its sequence number,
+   a background thread writes every group with one write and one sync, so the appends made while
+   a sync runs share the next one. Records carry a checksum, a torn or damaged tail is dropped
+   when the log is opened.
+
+   rotate() moves the log to path + ".old" and starts an empty one, the owner writes a snapshot
+   of everything up to the returned sequence and then calls dropRotated(). An .old left by a snapshot
+   that failed is not replaced, the log is appended to it, so its records stay in a file until a snapshot
+   covers them. The owner runs one rotation at a time, up to dropRotated().
+
+   record: size(4) checksum(4) sequence(8) kind(1) payload(size)
+*/
+
+class Journal final
+{
+public:
+    using Replay = std::function<void(std::uint64_t sequence, unsigned char kind, std::string_view payload)>;
+
+    explicit Journal();
+    ~Journal(); //writes the open group
+
+    Journal(const Journal &) = delete;
+    Journal & operator=(const Journal &) = delete;
+
+    //Replays path + ".old" and path, then appends to path. The records up to after are in a snapshot of the owner,
+    //they are skipped and the sequence numbers go on from there.
+    bool open(const std::string & path, const Replay & replay, std::uint64_t after = 0);
+    bool isOpen() const;
+    void close();
+
+    std::uint64_t append(unsigned char kind, std::string_view head, std::string_view tail = {});
+    bool sync(); //until every appended record is on disk
+
+    std::uint64_t rotate(); //returns the sequence of the last record in the rotated log
+    void dropRotated();
+
+    static bool writeFile(const std::string & path, std::string_view data); //synced to disk, replaces path at once
+
+private:
+    std::string path;
+    std::FILE * file = nullptr;
+    std::string group; //appended, not written yet
+    std::uint64_t appended = 0;
+    std::uint64_t durable = 0;
+    bool failed = false;
+    std::mutex mutex;
+    std::condition_variable written;
+    std::condition_variable_any pending;
+    std::jthread writer;
+
+    void write(std::stop_token token);
+    static bool appendFile(const std::string & from, const std::string & to); //synced
+    static bool replayFile(const std::string & path, const Replay & replay, std::uint64_t after, std::uint64_t & last, std::uint64_t * valid);
+};
+
+#endif // JOURNAL_H
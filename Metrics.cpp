@@ -0,0 +1,335 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+static void raise(std::atomic<std::uint64_t> & maximum, std::uint64_t value)
+{
+    std::uint64_t current = maximum.load(std::memory_order_relaxed);
+    while(value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed));
+}
+
+static void escapeLabel(std::string & out, std::string_view value) //the text format escapes only these three, any other byte is valid UTF-8 as is
+{
+    for(char c : value)
+    {
+        if(c == '\\' || c == '"'){ out.push_back('\\'); out.push_back(c); }
+        else if(c == '\n') out += "\\n";
+        else out.push_back(c);
+    }
+}
+
+static void escapeJson(std::string & out, std::string_view value)
+{
+    for(char c : value)
+    {
+        if(c == '\\' || c == '"'){ out.push_back('\\'); out.push_back(c); }
+        else if(c == '\n') out += "\\n";
+        else if(static_cast<unsigned char>(c) < 0x20)
+        {
+           char code[8];
+           std::snprintf(code, sizeof(code), "\\u%04x", c);
+           out += code;
+        }
+        else out.push_back(c);
+    }
+}
+
+static void append(std::string & out, const char * format, auto... values)
+{
+    char line[256];
+    int size = std::snprintf(line, sizeof(line), format, values...);
+    if(size > 0) out.append(line, std::min<std::size_t>(size, sizeof(line) - 1));
+}
+
+//------------------Histogram-------------------------
+
+std::uint64_t Histogram::Snapshot::upperBound(unsigned bucket)
+{
+    if(bucket + 1 >= buckets) return std::numeric_limits<std::uint64_t>::max();
+    return (bucket == 0) ? 0 : (std::uint64_t(1) << bucket);
+}
+
+std::uint64_t Histogram::Snapshot::percentile(double p) const
+{
+    if(count == 0) return 0;
+
+    const std::uint64_t target = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(p * count)));
+    std::uint64_t seen = 0;
+
+    for(unsigned i = 0; i < buckets; i++)
+    {
+        seen += counts[i];
+        if(seen >= target) return upperBound(i);
+    }
+
+    return upperBound(buckets - 1);
+}
+
+Histogram::Snapshot & Histogram::Snapshot::operator+=(const Snapshot & other)
+{
+    for(unsigned i = 0; i < buckets; i++) counts[i] += other.counts[i];
+    count += other.count;
+    sum += other.sum;
+
+    return *this;
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snapshot;
+
+    for(unsigned i = 0; i < buckets; i++)
+    {
+        snapshot.counts[i] = counts[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+
+    snapshot.sum = sum.load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+void Histogram::clear()
+{
+    for(auto & count : counts) count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+}
+
+//------------------Metrics---------------------------
+
+void Metrics::Task::record(std::chrono::nanoseconds late, std::chrono::nanoseconds took)
+{
+    const std::uint64_t lateness = std::max<std::int64_t>(0, late.count());
+    const std::uint64_t callback = std::max<std::int64_t>(0, took.count());
+
+    latenessSum.fetch_add(lateness, std::memory_order_relaxed);
+    callbackSum.fetch_add(callback, std::memory_order_relaxed);
+    raise(latenessMax, lateness);
+    raise(callbackMax, callback);
+}
+
+std::shared_ptr<Metrics::Task> Metrics::add(const std::string & name)
+{
+    auto stats = std::make_shared<Task>();
+    stats->name = name;
+
+    std::lock_guard<std::mutex>lock(mutex);
+    registry[name] = stats;
+
+    return stats;
+}
+
+void Metrics::remove(const std::string & name)
+{
+    std::lock_guard<std::mutex>lock(mutex);
+    registry.erase(name);
+}
+
+void Metrics::clearTasks()
+{
+    std::lock_guard<std::mutex>lock(mutex);
+    registry.clear();
+}
+
+TasksMetrics Metrics::snapshot() const
+{
+    TasksMetrics snapshot;
+
+    snapshot.ticks = ticks.load(std::memory_order_relaxed);
+    snapshot.fires = fires.load(std::memory_order_relaxed);
+    snapshot.timers = timers.load(std::memory_order_relaxed);
+    snapshot.clockSteps = clockSteps.load(std::memory_order_relaxed);
+    snapshot.skipped = skipped.load(std::memory_order_relaxed);
+    snapshot.shed = shed.load(std::memory_order_relaxed);
+    snapshot.unowned = unowned.load(std::memory_order_relaxed);
+    snapshot.locks = locks.load(std::memory_order_relaxed);
+    snapshot.contended = contended.load(std::memory_order_relaxed);
+    snapshot.tasks = tasks.load(std::memory_order_relaxed);
+
+    snapshot.tick = tick.snapshot();
+    snapshot.lateness = lateness.snapshot();
+    snapshot.callback = callback.snapshot();
+    snapshot.lockWait = lockWait.snapshot();
+
+    std::lock_guard<std::mutex>lock(mutex);
+
+    snapshot.perTask.reserve(registry.size());
+
+    for(const auto & [name, stats] : registry)
+    {
+        snapshot.perTask.push_back({name, stats->fires.load(std::memory_order_relaxed),
+                                    stats->callbackSum.load(std::memory_order_relaxed), stats->callbackMax.load(std::memory_order_relaxed),
+                                    stats->latenessSum.load(std::memory_order_relaxed), stats->latenessMax.load(std::memory_order_relaxed)});
+    }
+
+    return snapshot;
+}
+
+void Metrics::clear()
+{
+    for(auto counter : {&ticks, &fires, &timers, &clockSteps, &skipped, &shed, &unowned, &locks, &contended}) counter->store(0, std::memory_order_relaxed);
+    for(auto histogram : {&tick, &lateness, &callback, &lockWait}) histogram->clear();
+
+    std::lock_guard<std::mutex>lock(mutex);
+
+    for(auto & [name, stats] : registry)
+    {
+        for(auto counter : {&stats->fires, &stats->callbackSum, &stats->callbackMax, &stats->latenessSum, &stats->latenessMax}) counter->store(0, std::memory_order_relaxed);
+    }
+}
+
+//------------------TasksMetrics----------------------
+
+TasksMetrics & TasksMetrics::operator+=(const TasksMetrics & other)
+{
+    ticks += other.ticks;
+    fires += other.fires;
+    timers += other.timers;
+    clockSteps += other.clockSteps;
+    skipped += other.skipped;
+    shed += other.shed;
+    unowned += other.unowned;
+    locks += other.locks;
+    contended += other.contended;
+    tasks += other.tasks;
+
+    tick += other.tick;
+    lateness += other.lateness;
+    callback += other.callback;
+    lockWait += other.lockWait;
+
+    perTask.insert(perTask.end(), other.perTask.begin(), other.perTask.end());
+
+    return *this;
+}
+
+std::string TasksMetrics::toPrometheus(std::string_view prefix) const
+{
+    std::string out;
+    const std::string name(prefix);
+
+    auto counter = [&](const char * metric, const char * help, std::uint64_t value)
+    {
+        append(out, "# HELP %s_%s %s\n# TYPE %s_%s counter\n%s_%s %llu\n", name.c_str(), metric, help, name.c_str(), metric,
+               name.c_str(), metric, static_cast<unsigned long long>(value));
+    };
+
+    auto histogram = [&](const char * metric, const char * help, const Histogram::Snapshot & snapshot)
+    {
+        append(out, "# HELP %s_%s_seconds %s\n# TYPE %s_%s_seconds histogram\n", name.c_str(), metric, help, name.c_str(), metric);
+
+        std::uint64_t cumulative = 0;
+
+        for(unsigned i = 0; i + 1 < Histogram::buckets; i++)
+        {
+            cumulative += snapshot.counts[i];
+            append(out, "%s_%s_seconds_bucket{le=\"%.9g\"} %llu\n", name.c_str(), metric, Histogram::Snapshot::upperBound(i) / 1e9,
+                   static_cast<unsigned long long>(cumulative));
+        }
+
+        append(out, "%s_%s_seconds_bucket{le=\"+Inf\"} %llu\n%s_%s_seconds_sum %.9f\n%s_%s_seconds_count %llu\n", name.c_str(), metric,
+               static_cast<unsigned long long>(snapshot.count), name.c_str(), metric, snapshot.sum / 1e9, name.c_str(), metric,
+               static_cast<unsigned long long>(snapshot.count));
+    };
+
+    counter("ticks_total", "Passes of the scheduler over the deadlines.", ticks);
+    counter("fires_total", "Fired tasks.", fires);
+    counter("timers_total", "Expired delay timers.", timers);
+    counter("clock_steps_total", "Detected changes of the wall clock.", clockSteps);
+    counter("skipped_total", "Fires dropped or merged by the overrun policy of their task.", skipped);
+    counter("shed_total", "Fires dropped by the cap on callbacks in flight.", shed);
+    counter("unowned_total", "Fires left to another replica by the lease.", unowned);
+    counter("locks_total", "Acquisitions of the scheduler mutex by callers.", locks);
+    counter("locks_contended_total", "Acquisitions that waited for the scheduler mutex.", contended);
+
+    append(out, "# HELP %s_tasks Registered tasks.\n# TYPE %s_tasks gauge\n%s_tasks %llu\n", name.c_str(), name.c_str(), name.c_str(),
+           static_cast<unsigned long long>(tasks));
+
+    histogram("tick", "Scheduler work of one tick without the callbacks.", tick);
+    histogram("lateness", "Start of the callbacks after the deadline.", lateness);
+    histogram("callback", "Duration of the callbacks of one fire.", callback);
+    histogram("lock_wait", "Wait of a caller for the scheduler mutex, contended acquisitions.", lockWait);
+
+    if(perTask.empty()) return out;
+
+    const char * series[][3] = {{"task_fires_total", "counter", "Fires of the task."},
+                                {"task_callback_seconds_total", "counter", "Duration of the callbacks of the task."},
+                                {"task_callback_seconds_max", "gauge", "Longest callbacks of one fire of the task."},
+                                {"task_lateness_seconds_total", "counter", "Start of the callbacks of the task after its deadlines."},
+                                {"task_lateness_seconds_max", "gauge", "Latest start of the callbacks of the task after a deadline."}};
+
+    for(unsigned s = 0; s < 5; s++)
+    {
+        append(out, "# HELP %s_%s %s\n# TYPE %s_%s %s\n", name.c_str(), series[s][0], series[s][2], name.c_str(), series[s][0], series[s][1]);
+
+        for(const TaskMetrics & task : perTask)
+        {
+            out += name;
+            out += '_';
+            out += series[s][0];
+            out += "{task=\"";
+            escapeLabel(out, task.name);
+            out += "\"} ";
+
+            switch(s)
+            {
+               case 0: append(out, "%llu\n", static_cast<unsigned long long>(task.fires)); break;
+               case 1: append(out, "%.9f\n", task.callbackSum / 1e9); break;
+               case 2: append(out, "%.9f\n", task.callbackMax / 1e9); break;
+               case 3: append(out, "%.9f\n", task.latenessSum / 1e9); break;
+               case 4: append(out, "%.9f\n", task.latenessMax / 1e9); break;
+            }
+        }
+    }
+
+    return out;
+}
+
+std::string TasksMetrics::toJson() const
+{
+    std::string out;
+
+    auto histogram = [&](const char * metric, const Histogram::Snapshot & snapshot)
+    {
+        append(out, ",\"%s\":{\"count\":%llu,\"sum_ns\":%llu,\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"buckets\":[", metric,
+               static_cast<unsigned long long>(snapshot.count), static_cast<unsigned long long>(snapshot.sum),
+               static_cast<unsigned long long>(snapshot.percentile(0.5)), static_cast<unsigned long long>(snapshot.percentile(0.9)),
+               static_cast<unsigned long long>(snapshot.percentile(0.99)));
+
+        for(unsigned i = 0; i < Histogram::buckets; i++) append(out, (i == 0) ? "%llu" : ",%llu", static_cast<unsigned long long>(snapshot.counts[i]));
+
+        out += "]}";
+    };
+
+    append(out, "{\"ticks\":%llu,\"fires\":%llu,\"timers\":%llu,\"clock_steps\":%llu,\"skipped\":%llu,\"shed\":%llu,\"unowned\":%llu,\"locks\":%llu,\"locks_contended\":%llu,\"tasks\":%llu",
+           static_cast<unsigned long long>(ticks), static_cast<unsigned long long>(fires), static_cast<unsigned long long>(timers),
+           static_cast<unsigned long long>(clockSteps), static_cast<unsigned long long>(skipped), static_cast<unsigned long long>(shed),
+           static_cast<unsigned long long>(unowned), static_cast<unsigned long long>(locks), static_cast<unsigned long long>(contended),
+           static_cast<unsigned long long>(tasks));
+
+    histogram("tick", tick);
+    histogram("lateness", lateness);
+    histogram("callback", callback);
+    histogram("lock_wait", lockWait);
+
+    out += ",\"per_task\":[";
+
+    for(std::size_t i = 0; i < perTask.size(); i++)
+    {
+        const TaskMetrics & task = perTask[i];
+
+        out += (i == 0) ? "{\"name\":\"" : ",{\"name\":\"";
+        escapeJson(out, task.name);
+        append(out, "\",\"fires\":%llu,\"callback_sum_ns\":%llu,\"callback_max_ns\":%llu,\"lateness_sum_ns\":%llu,\"lateness_max_ns\":%llu}",
+               static_cast<unsigned long long>(task.fires), static_cast<unsigned long long>(task.callbackSum),
+               static_cast<unsigned long long>(task.callbackMax), static_cast<unsigned long long>(task.latenessSum),
+               static_cast<unsigned long long>(task.latenessMax));
+    }
+
+    out += "]}";
+
+    return out;
+}
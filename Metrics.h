@@ -0,0 +1,139 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/* Runtime metrics of a TasksController
+
+   Counters and histograms are relaxed atomics, the scheduler and the callers write them
+   without a lock and snapshot() reads them from any thread, so a snapshot taken during a
+   tick may be off by the values of that tick. A histogram counts nanoseconds in power-of-two
+   buckets: bucket 0 - zero, bucket i - [2^(i-1), 2^i), the last one also everything above.
+
+   Per-task stats are blocks shared by the slot of the task and a registry with its own mutex,
+   reading them never takes the mutex of the scheduler.
+*/
+
+class Histogram final
+{
+public:
+    static constexpr unsigned buckets = 48; //2^47 ns - about 39 hours
+
+    struct Snapshot
+    {
+        std::array<std::uint64_t, buckets> counts = {};
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0; //ns
+
+        std::uint64_t percentile(double p) const; //upper bound of the bucket, ns
+        static std::uint64_t upperBound(unsigned bucket);
+        Snapshot & operator+=(const Snapshot & other);
+    };
+
+    void record(std::chrono::nanoseconds value)
+    {
+        const std::uint64_t ns = (value.count() > 0) ? static_cast<std::uint64_t>(value.count()) : 0;
+        const unsigned bucket = std::min<unsigned>(static_cast<unsigned>(std::bit_width(ns)), buckets - 1);
+
+        counts[bucket].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const;
+    void clear();
+
+private:
+    std::array<std::atomic<std::uint64_t>, buckets> counts = {};
+    std::atomic<std::uint64_t> sum = 0;
+};
+
+struct TaskMetrics
+{
+    std::string name;
+    std::uint64_t fires = 0;
+    std::uint64_t callbackSum = 0; //ns
+    std::uint64_t callbackMax = 0;
+    std::uint64_t latenessSum = 0;
+    std::uint64_t latenessMax = 0;
+};
+
+struct TasksMetrics
+{
+    std::uint64_t ticks = 0;     //passes of run() or processDue() over the deadlines
+    std::uint64_t fires = 0;     //tasks
+    std::uint64_t timers = 0;    //expired delay timers
+    std::uint64_t clockSteps = 0;
+    std::uint64_t skipped = 0;   //fires dropped or merged by the overrun policy of their task
+    std::uint64_t shed = 0;      //fires dropped by the cap on callbacks in flight
+    std::uint64_t unowned = 0;   //fires left to another replica by the lease
+    std::uint64_t locks = 0;     //acquisitions of the mutex by callers
+    std::uint64_t contended = 0; //of them, those that waited
+    std::uint64_t tasks = 0;     //registered at the last tick
+
+    Histogram::Snapshot tick;     //scheduler work of a tick: commands, deadlines, dispatch without the callbacks
+    Histogram::Snapshot lateness; //start of the callbacks - deadline
+    Histogram::Snapshot callback; //all callbacks of one fire
+    Histogram::Snapshot lockWait; //contended acquisitions only
+
+    std::vector<TaskMetrics> perTask; //empty unless enabled
+
+    TasksMetrics & operator+=(const TasksMetrics & other);
+
+    std::string toPrometheus(std::string_view prefix = "taskscontroller") const;
+    std::string toJson() const;
+};
+
+class Metrics final
+{
+public:
+    struct Task //stats of one task
+    {
+        std::string name;
+        std::atomic<std::uint64_t> fires = 0;
+        std::atomic<std::uint64_t> callbackSum = 0;
+        std::atomic<std::uint64_t> callbackMax = 0;
+        std::atomic<std::uint64_t> latenessSum = 0;
+        std::atomic<std::uint64_t> latenessMax = 0;
+
+        void record(std::chrono::nanoseconds lateness, std::chrono::nanoseconds callback);
+    };
+
+    std::atomic<std::uint64_t> ticks = 0;
+    std::atomic<std::uint64_t> fires = 0;
+    std::atomic<std::uint64_t> timers = 0;
+    std::atomic<std::uint64_t> clockSteps = 0;
+    std::atomic<std::uint64_t> skipped = 0;
+    std::atomic<std::uint64_t> shed = 0;
+    std::atomic<std::uint64_t> unowned = 0;
+    std::atomic<std::uint64_t> locks = 0;
+    std::atomic<std::uint64_t> contended = 0;
+    std::atomic<std::uint64_t> tasks = 0;
+
+    Histogram tick;
+    Histogram lateness;
+    Histogram callback;
+    Histogram lockWait;
+
+    std::shared_ptr<Task> add(const std::string & name); //registers the stats of a task
+    void remove(const std::string & name);
+    void clearTasks();
+
+    TasksMetrics snapshot() const;
+    void clear(); //counters and histograms, the per-task stats stay registered
+
+private:
+    mutable std::mutex mutex; //registry
+    std::unordered_map<std::string, std::shared_ptr<Task>> registry;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,70 @@
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <utility>
+
+/* Multi-producer single-consumer queue (D. Vyukov)
+
+   push - wait-free, one atomic exchange, never blocks on the consumer
+   pop  - consumer only, may report empty for a moment while a producer is between
+          its exchange and its link, the producer wakes the consumer after push anyway
+*/
+
+template<typename T>
+class MpscQueue final
+{
+    struct Node
+    {
+        std::atomic<Node*> next = nullptr;
+        T value;
+    };
+
+    std::atomic<Node*> head;
+    Node * tail;
+
+public:
+
+    explicit MpscQueue() : head(new Node), tail(head.load()){}
+
+    ~MpscQueue()
+    {
+        while(tail)
+        {
+            Node * next = tail->next.load();
+            delete tail;
+            tail = next;
+        }
+    }
+
+    MpscQueue(const MpscQueue &) = delete;
+    MpscQueue & operator=(const MpscQueue &) = delete;
+
+    void push(T && value)
+    {
+        Node * node = new Node;
+        node->value = std::move(value);
+
+        Node * prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T & value)
+    {
+        Node * next = tail->next.load(std::memory_order_acquire);
+        if(!next) return false;
+
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+
+        return true;
+    }
+
+    bool empty() const
+    {
+        return tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+};
+
+#endif // MPSCQUEUE_H
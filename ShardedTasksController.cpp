@@ -0,0 +1,384 @@
+#include "ShardedTasksController.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#ifdef WIN32
+#include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+static void pinThread(unsigned index)
+{
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+#ifdef WIN32
+    SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << (index % cores % (sizeof(DWORD_PTR) * 8)));
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)index;
+    (void)cores;
+#endif
+}
+
+ShardedTasksController::ShardedTasksController(unsigned shards, unsigned short accuracy, bool pin) : pin(pin)
+{
+    if(shards == 0) shards = std::max(1u, std::thread::hardware_concurrency());
+    for(unsigned i = 0; i < shards; i++) controllers.push_back(std::make_unique<TasksController>(accuracy));
+}
+
+unsigned ShardedTasksController::shards() const
+{
+    return static_cast<unsigned>(controllers.size());
+}
+
+unsigned ShardedTasksController::shardOf(const std::string & name) const
+{
+    //std::hash of the name is also the bucket hash inside the shard, mixed so both do not pick the same bits
+    const std::uint64_t hash = static_cast<std::uint64_t>(std::hash<std::string_view>()(name)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<unsigned>((hash >> 32) % controllers.size());
+}
+
+TasksController & ShardedTasksController::shard(unsigned index)
+{
+    return *controllers[index % controllers.size()];
+}
+
+TasksController & ShardedTasksController::shard(const std::string & name)
+{
+    return *controllers[shardOf(name)];
+}
+
+bool ShardedTasksController::clearTasks()
+{
+    for(auto & controller : controllers) controller->clearTasks();
+    return true;
+}
+
+int ShardedTasksController::countTasks()
+{
+    int count = 0;
+    for(auto & controller : controllers) count += controller->countTasks();
+    return count;
+}
+
+unsigned short ShardedTasksController::accuracy() const
+{
+    return controllers.front()->accuracy();
+}
+
+bool ShardedTasksController::setAccuracy(unsigned short ms)
+{
+    for(auto & controller : controllers) controller->setAccuracy(ms);
+    return true;
+}
+
+bool ShardedTasksController::setPrecise(bool enabled)
+{
+    bool result = true;
+    for(auto & controller : controllers) result = controller->setPrecise(enabled) && result;
+    return result;
+}
+
+bool ShardedTasksController::setTimeZone(std::string_view name)
+{
+    bool result = true;
+    for(auto & controller : controllers) result = controller->setTimeZone(name) && result;
+    return result;
+}
+
+bool ShardedTasksController::setMetrics(bool enabled, bool perTask)
+{
+    bool result = true;
+    for(auto & controller : controllers) result = controller->setMetrics(enabled, perTask) && result;
+    return result;
+}
+
+TasksMetrics ShardedTasksController::metrics() const
+{
+    TasksMetrics metrics;
+    for(auto & controller : controllers) metrics += controller->metrics();
+    return metrics;
+}
+
+bool ShardedTasksController::contains(const std::string & name)
+{
+    return shard(name).contains(name);
+}
+
+TaskHandle ShardedTasksController::find(const std::string & name)
+{
+    return shard(name).find(name);
+}
+
+TaskHandle ShardedTasksController::addTask(const std::string & name, std::string_view value)
+{
+    return shard(name).addTask(name, value);
+}
+
+TaskHandle ShardedTasksController::addTask(const std::string & name, std::string_view value, const std::function<void()> & callback)
+{
+    return shard(name).addTask(name, value, callback);
+}
+
+TaskHandle ShardedTasksController::addTask(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks)
+{
+    return shard(name).addTask(name, value, callbacks);
+}
+
+TaskHandle ShardedTasksController::addTask(const std::string & name, const Task & task)
+{
+    return shard(name).addTask(name, task);
+}
+
+TaskHandle ShardedTasksController::addTask(const std::string & name, const Task & task, const std::function<void()> & callback)
+{
+    return shard(name).addTask(name, task, callback);
+}
+
+TaskHandle ShardedTasksController::addTask(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks)
+{
+    return shard(name).addTask(name, task, callbacks);
+}
+
+std::size_t ShardedTasksController::loadTasks(std::string_view lines, std::vector<TaskLoadError> * errors, unsigned threads)
+{
+    struct Part
+    {
+        std::string lines;
+        std::vector<std::size_t> numbers; //line number in the input of every line of the part
+        std::vector<TaskLoadError> errors;
+        std::size_t added = 0;
+    };
+
+    std::vector<Part> parts(controllers.size());
+
+    {
+      std::size_t number = 0;
+      std::string name;
+
+      while(!lines.empty())
+      {
+          std::size_t end = lines.find('\n');
+          std::string_view line = lines.substr(0, end);
+          lines.remove_prefix((end == std::string_view::npos) ? lines.size() : end + 1);
+          number++;
+
+          if(line.ends_with('\r')) line.remove_suffix(1);
+          if(line.empty() || line.front() == '#') continue;
+
+          std::size_t tab = line.find('\t');
+
+          if(tab == 0 || tab == std::string_view::npos || tab + 1 == line.size())
+          {
+             if(errors) errors->push_back({number, TaskLoadError::Format});
+             continue;
+          }
+
+          name.assign(line.substr(0, tab));
+
+          Part & part = parts[shardOf(name)];
+          part.lines.append(line);
+          part.lines.push_back('\n');
+          part.numbers.push_back(number);
+      }
+    }
+
+    //----------------
+
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::max(1u, threads / shards());
+
+    {
+      std::vector<std::jthread> loaders;
+
+      for(unsigned i = 0; i < shards(); i++)
+      {
+          if(parts[i].lines.empty()) continue;
+          loaders.emplace_back([this, &parts, errors, threads, i]{ parts[i].added = controllers[i]->loadTasks(parts[i].lines, errors ? &parts[i].errors : nullptr, threads); });
+      }
+    }
+
+    //----------------
+
+    std::size_t added = 0;
+
+    for(auto & part : parts)
+    {
+        added += part.added;
+        if(errors){ for(auto & error : part.errors) errors->push_back({part.numbers[error.line - 1], error.reason}); }
+    }
+
+    if(errors) std::sort(errors->begin(), errors->end(), [](const TaskLoadError & a, const TaskLoadError & b){ return a.line < b.line; });
+
+    return added;
+}
+
+bool ShardedTasksController::remove(const std::string & name)
+{
+    return shard(name).remove(name);
+}
+
+bool ShardedTasksController::setOverrun(const std::string & name, TasksController::Overrun policy, unsigned limit)
+{
+    return shard(name).setOverrun(name, policy, limit);
+}
+
+void ShardedTasksController::setMaxCallbacksInFlight(std::size_t callbacks)
+{
+    for(auto & controller : controllers) controller->setMaxCallbacksInFlight(callbacks);
+}
+
+bool ShardedTasksController::setPriority(const std::string & name, TasksController::Priority priority)
+{
+    return shard(name).setPriority(name, priority);
+}
+
+bool ShardedTasksController::setLaneWorkers(TasksController::Priority lane, unsigned threads)
+{
+    bool result = true;
+    for(auto & controller : controllers) result = controller->setLaneWorkers(lane, threads) && result;
+    return result;
+}
+
+bool ShardedTasksController::setSplay(std::chrono::milliseconds window)
+{
+    bool result = true;
+    for(auto & controller : controllers) result = controller->setSplay(window) && result;
+    return result;
+}
+
+bool ShardedTasksController::setSplay(const std::string & name, std::chrono::milliseconds window)
+{
+    return shard(name).setSplay(name, window);
+}
+
+std::vector<Task::Now> ShardedTasksController::nextOccurrences(const std::string & name, std::size_t n)
+{
+    return shard(name).nextOccurrences(name, n);
+}
+
+std::vector<TasksController::Occurrence> ShardedTasksController::firesInWindow(const Task::Now & from, const Task::Now & to, std::size_t limit)
+{
+    std::vector<TasksController::Occurrence> fires;
+
+    for(auto & controller : controllers)
+    {
+        auto part = controller->firesInWindow(from, to, limit); //every shard gives its first limit fires, the merge keeps the first limit of all
+        const std::size_t middle = fires.size();
+
+        fires.insert(fires.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+        std::inplace_merge(fires.begin(), fires.begin() + middle, fires.end(), [](const auto & a, const auto & b){ return a.time < b.time; });
+
+        if(fires.size() > limit) fires.resize(limit);
+    }
+
+    return fires;
+}
+
+std::vector<std::size_t> ShardedTasksController::fireDensity(const Task::Now & from, const Task::Now & to)
+{
+    std::vector<std::size_t> density;
+
+    for(auto & controller : controllers)
+    {
+        const auto part = controller->fireDensity(from, to);
+
+        density.resize(part.size());
+        for(std::size_t i = 0; i < part.size(); i++) density[i] += part[i];
+    }
+
+    return density;
+}
+
+bool ShardedTasksController::setLease(std::shared_ptr<TaskLease> lease, TasksController::Sharing sharing)
+{
+    bool result = true;
+    for(auto & controller : controllers) result = controller->setLease(lease, sharing) && result;
+    return result;
+}
+
+bool ShardedTasksController::isOwner(const std::string & name)
+{
+    return shard(name).isOwner(name);
+}
+
+bool ShardedTasksController::addCallback(const std::string & name, const std::function<void()> & callback)
+{
+    return shard(name).addCallback(name, callback);
+}
+
+bool ShardedTasksController::addCallbacks(const std::string & name, const std::vector<std::function<void()>> & callbacks)
+{
+    return shard(name).addCallbacks(name, callbacks);
+}
+
+void ShardedTasksController::clearCallbacks(const std::string & name)
+{
+    shard(name).clearCallbacks(name);
+}
+
+bool ShardedTasksController::isRun() const
+{
+    return isrun.load();
+}
+
+void ShardedTasksController::run()
+{
+    {
+      std::lock_guard<std::mutex>lock(mutex);
+
+      if(isrun.load()) return;
+      if(std::exchange(stopped, false) || countTasks() == 0) return; //stopped before it started
+
+      isrun = true;
+
+      for(unsigned i = 0; i < shards(); i++)
+      {
+          threads.emplace_back([this, i](std::stop_token token)
+          {
+              if(pin) pinThread(i);
+              controllers[i]->run(token);
+          });
+      }
+    }
+
+    for(auto & thread : threads) thread.join(); //stop() only requests, it never touches the vector while run() is active
+
+    std::lock_guard<std::mutex>lock(mutex);
+    threads.clear();
+    stopped = false;
+    isrun = false;
+}
+
+void ShardedTasksController::stop()
+{
+    std::lock_guard<std::mutex>lock(mutex); //ordered with the start of the shard threads by run()
+
+    if(threads.empty()) stopped = true;
+    for(auto & thread : threads) thread.request_stop();
+}
+
+bool ShardedTasksController::stopAndJoin(std::chrono::milliseconds timeout)
+{
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    stop();
+
+    bool result = true;
+
+    for(auto & controller : controllers)
+    {
+        const auto left = std::max(deadline - std::chrono::steady_clock::now(), std::chrono::steady_clock::duration(0));
+        result = controller->stopAndJoin(std::chrono::ceil<std::chrono::milliseconds>(left)) && result;
+    }
+
+    return result;
+}
@@ -0,0 +1,136 @@
+#ifndef SHARDEDTASKSCONTROLLER_H
+#define SHARDEDTASKSCONTROLLER_H
+
+#include <string>
+#include <string_view>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+#include "TasksController.h"
+
+/* TasksController split into shards by the hash of the task name
+
+   Every shard is a TasksController with its own mutex, slot table, deadline heap and scheduler thread,
+   so evaluation and dispatch of one shard never wait for another. A task always lives in the shard
+   of its name, the name based calls keep the semantics of TasksController. The handles returned by
+   addTask() belong to that shard, shard(name) gives it for the handle based calls.
+*/
+
+class ShardedTasksController final
+{
+    std::vector<std::unique_ptr<TasksController>> controllers;
+    std::atomic_bool isrun = false;
+    bool pin;
+    bool stopped = false; //a stop() while no shard thread runs, the next run() returns at once
+    std::mutex mutex; //threads, stopped
+    std::vector<std::jthread> threads;
+
+public:
+
+    //shards == 0 - hardware concurrency, pin - the scheduler thread of shard i runs on core i % cores
+    explicit ShardedTasksController(unsigned shards, unsigned short accuracy = 10, bool pin = false);
+
+    ShardedTasksController(const ShardedTasksController &) = delete;
+    ShardedTasksController & operator=(const ShardedTasksController &) = delete;
+
+    unsigned shards() const;
+    unsigned shardOf(const std::string & name) const;
+    TasksController & shard(unsigned index);
+    TasksController & shard(const std::string & name);
+
+    bool clearTasks();
+    int countTasks();
+
+    unsigned short accuracy() const;
+    bool setAccuracy(unsigned short ms = 10);
+    bool setPrecise(bool enabled);
+    bool setTimeZone(std::string_view name);
+
+    bool setMetrics(bool enabled, bool perTask = false);
+    TasksMetrics metrics() const; //sum of the shards
+
+    bool contains(const std::string & name);
+    TaskHandle find(const std::string & name);
+
+    TaskHandle addTask(const std::string & name, std::string_view value);
+    TaskHandle addTask(const std::string & name, std::string_view value, const std::function<void()> & callback);
+    TaskHandle addTask(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks);
+
+    TaskHandle addTask(const std::string & name, const Task & task);
+    TaskHandle addTask(const std::string & name, const Task & task, const std::function<void()> & callback);
+    TaskHandle addTask(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks);
+
+    template<typename... Functions>
+    TaskHandle emplaceTask(std::string && name, const Task & task, Functions &&... callbacks)
+    {
+        TasksController & target = shard(name);
+        return target.emplaceTask(std::move(name), task, std::forward<Functions>(callbacks)...);
+    }
+
+    template<typename... Functions>
+    TaskHandle emplaceTask(std::string && name, std::string_view value, Functions &&... callbacks)
+    {
+        TasksController & target = shard(name);
+        return target.emplaceTask(std::move(name), value, std::forward<Functions>(callbacks)...);
+    }
+
+    //Split by shard, then one lock per shard, see TasksController::addTasks()
+    template<std::ranges::input_range Range> requires std::is_same_v<std::remove_cvref_t<std::ranges::range_reference_t<Range>>, TasksController::Entry>
+    std::size_t addTasks(Range && entries)
+    {
+        constexpr bool movable = !std::is_lvalue_reference_v<Range> && !std::is_const_v<std::remove_reference_t<std::ranges::range_reference_t<Range>>>;
+
+        std::vector<std::vector<TasksController::Entry>> parts(controllers.size());
+
+        for(auto && entry : entries)
+        {
+            auto & part = parts[shardOf(entry.name)];
+
+            if constexpr(movable) part.push_back(std::move(entry));
+            else part.push_back(entry);
+        }
+
+        std::size_t added = 0;
+        for(unsigned i = 0; i < parts.size(); i++) added += controllers[i]->addTasks(std::move(parts[i]));
+
+        return added;
+    }
+
+    //Same format and errors as TasksController::loadTasks(), the shards are loaded in parallel
+    std::size_t loadTasks(std::string_view lines, std::vector<TaskLoadError> * errors = nullptr, unsigned threads = 0);
+
+    bool remove(const std::string & name);
+
+    bool setOverrun(const std::string & name, TasksController::Overrun policy, unsigned limit = 0);
+    void setMaxCallbacksInFlight(std::size_t callbacks); //the cap of every shard
+
+    bool setPriority(const std::string & name, TasksController::Priority priority);
+    bool setLaneWorkers(TasksController::Priority lane, unsigned threads); //threads for the lane in every shard
+
+    bool setSplay(std::chrono::milliseconds window); //the window of every shard, the offsets depend on the names only
+    bool setSplay(const std::string & name, std::chrono::milliseconds window);
+
+    std::vector<Task::Now> nextOccurrences(const std::string & name, std::size_t n);
+    std::vector<TasksController::Occurrence> firesInWindow(const Task::Now & from, const Task::Now & to, std::size_t limit = 1000000); //merged by time
+    std::vector<std::size_t> fireDensity(const Task::Now & from, const Task::Now & to); //summed over the shards
+
+    bool setLease(std::shared_ptr<TaskLease> lease, TasksController::Sharing sharing = TasksController::Leader); //one replica, every shard renews it
+    bool isOwner(const std::string & name);
+
+    bool addCallback(const std::string & name, const std::function<void()> & callback);
+    bool addCallbacks(const std::string & name, const std::vector<std::function<void()>> & callbacks);
+    void clearCallbacks(const std::string & name);
+
+    //run() - one scheduler thread per shard, returns after stop(). A stop() before run() has started the shard threads,
+    //also from another thread that has not entered run() yet, is kept: the next run() returns at once.
+    bool isRun() const;
+    void run();
+    void stop();
+    bool stopAndJoin(std::chrono::milliseconds timeout); //stops the shards and waits for the callbacks on their pools, run() returns on its thread
+};
+
+#endif // SHARDEDTASKSCONTROLLER_H
@@ -0,0 +1,61 @@
+#include "TaskClock.h"
+
+using namespace std::chrono;
+
+namespace
+{
+    class SystemClock final : public TaskClock
+    {
+    public:
+        system_clock::time_point utc() const override { return system_clock::now(); }
+        steady_clock::time_point steady() const override { return steady_clock::now(); }
+    };
+
+    SystemClock systemClock;
+    std::atomic<TaskClock*> currentClock = &systemClock;
+}
+
+TaskClock & TaskClock::system()
+{
+    return systemClock;
+}
+
+TaskClock & TaskClock::current()
+{
+    return *currentClock.load(std::memory_order_acquire);
+}
+
+void TaskClock::setCurrent(TaskClock * clock)
+{
+    currentClock.store((clock) ? clock : &systemClock, std::memory_order_release);
+}
+
+//===============================================
+
+ManualClock::ManualClock() : ManualClock(system_clock::now()){}
+
+ManualClock::ManualClock(system_clock::time_point utc) : wall(duration_cast<nanoseconds>(utc.time_since_epoch()).count()),
+                                                         monotonic(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count()){}
+
+system_clock::time_point ManualClock::utc() const
+{
+    return system_clock::time_point(duration_cast<system_clock::duration>(nanoseconds(wall.load(std::memory_order_acquire))));
+}
+
+steady_clock::time_point ManualClock::steady() const
+{
+    return steady_clock::time_point(duration_cast<steady_clock::duration>(nanoseconds(monotonic.load(std::memory_order_acquire))));
+}
+
+void ManualClock::advance(nanoseconds step)
+{
+    if(step.count() <= 0) return;
+
+    monotonic.fetch_add(step.count(), std::memory_order_acq_rel);
+    wall.fetch_add(step.count(), std::memory_order_acq_rel);
+}
+
+void ManualClock::setUtc(system_clock::time_point utc)
+{
+    wall.store(duration_cast<nanoseconds>(utc.time_since_epoch()).count(), std::memory_order_release);
+}
@@ -0,0 +1,48 @@
+#ifndef TASKCLOCK_H
+#define TASKCLOCK_H
+
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+/* Source of the wall clock and the monotonic clock of Task and TasksController
+
+   TaskClock::system() reads system_clock and steady_clock. Task reads TaskClock::current(), a TasksController
+   its own clock if it was given one (setClock()), otherwise the current one too.
+
+   ManualClock stands still until it is moved: advance() moves both clocks like elapsed time, setUtc() steps
+   only the wall clock like a clock change. TasksController::advanceClock() moves it from deadline to deadline
+   and fires everything due on the way without sleeping, a year of schedules replays in the time of its fires.
+*/
+
+class TaskClock
+{
+public:
+    virtual ~TaskClock() = default;
+
+    virtual std::chrono::system_clock::time_point utc() const = 0;
+    virtual std::chrono::steady_clock::time_point steady() const = 0;
+
+    static TaskClock & system();
+    static TaskClock & current();
+    static void setCurrent(TaskClock * clock); //nullptr - system(), the clock must outlive the tasks that read it
+};
+
+class ManualClock final : public TaskClock
+{
+public:
+    explicit ManualClock(); //at the time of the system clocks
+    explicit ManualClock(std::chrono::system_clock::time_point utc); //steady() starts at steady_clock::now()
+
+    std::chrono::system_clock::time_point utc() const override;
+    std::chrono::steady_clock::time_point steady() const override;
+
+    void advance(std::chrono::nanoseconds step); //both clocks, step >= 0
+    void setUtc(std::chrono::system_clock::time_point utc);
+
+private:
+    std::atomic<std::int64_t> wall; //ns since the epochs
+    std::atomic<std::int64_t> monotonic;
+};
+
+#endif // TASKCLOCK_H
@@ -0,0 +1,133 @@
+#include "TaskExecutor.h"
+
+static thread_local const TaskExecutor * current = nullptr; //the pool of the worker on this thread
+
+TaskExecutor::TaskExecutor(unsigned threads)
+{
+    if(threads == 0) threads = 1;
+
+    for(unsigned i = 0; i < threads; i++) workers.push_back(std::make_unique<Worker>());
+    for(unsigned i = 0; i < threads; i++) this->threads.emplace_back(&TaskExecutor::work, this, i);
+}
+
+TaskExecutor::~TaskExecutor()
+{
+    {
+      std::lock_guard<std::mutex>lock(mutex);
+      isrun = false;
+    }
+
+    condition.notify_all();
+    for(auto & thread : threads) thread.join();
+}
+
+unsigned TaskExecutor::size() const
+{
+    return static_cast<unsigned>(workers.size());
+}
+
+std::size_t TaskExecutor::pending() const
+{
+    return queued.load() + active.load();
+}
+
+bool TaskExecutor::isWorker() const
+{
+    return current == this;
+}
+
+void TaskExecutor::post(std::function<void()> job)
+{
+    if(!job) return;
+
+    Worker & worker = *workers[next++ % workers.size()];
+
+    {
+      std::lock_guard<std::mutex>lock(worker.mutex);
+      worker.jobs.push_back(std::move(job));
+    }
+
+    queued++;
+
+    if(sleeping.load() > 0)
+    {
+       std::lock_guard<std::mutex>lock(mutex);
+       condition.notify_one();
+    }
+}
+
+void TaskExecutor::wait()
+{
+    if(isWorker()) return; //its own job would never finish
+
+    std::unique_lock<std::mutex>lock(mutex);
+    idle.wait(lock, [this]{ return queued.load() == 0 && active.load() == 0; });
+}
+
+bool TaskExecutor::waitUntil(std::chrono::steady_clock::time_point deadline)
+{
+    if(isWorker()) return false;
+
+    std::unique_lock<std::mutex>lock(mutex);
+    return idle.wait_until(lock, deadline, [this]{ return queued.load() == 0 && active.load() == 0; });
+}
+
+bool TaskExecutor::take(unsigned index, std::function<void()> & job)
+{
+    for(unsigned i = 0; i < workers.size(); i++)
+    {
+        Worker & worker = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex>lock(worker.mutex);
+
+        if(worker.jobs.empty()) continue;
+
+        if(i == 0) //own deque - oldest first
+        {
+           job = std::move(worker.jobs.front());
+           worker.jobs.pop_front();
+        }
+        else //steal from the back
+        {
+           job = std::move(worker.jobs.back());
+           worker.jobs.pop_back();
+        }
+
+        active++;
+        queued--;
+
+        return true;
+    }
+
+    return false;
+}
+
+void TaskExecutor::work(unsigned index)
+{
+    std::function<void()> job;
+    current = this;
+
+    while(true)
+    {
+        if(take(index, job))
+        {
+           job();
+           job = nullptr;
+
+           if(--active == 0 && queued.load() == 0)
+           {
+              std::lock_guard<std::mutex>lock(mutex);
+              idle.notify_all();
+           }
+
+           continue;
+        }
+
+        std::unique_lock<std::mutex>lock(mutex);
+
+        sleeping++;
+        condition.wait(lock, [this]{ return queued.load() > 0 || !isrun.load(); });
+        sleeping--;
+
+        if(!isrun.load() && queued.load() == 0) return;
+    }
+}
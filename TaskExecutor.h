@@ -0,0 +1,63 @@
+#ifndef TASKEXECUTOR_H
+#define TASKEXECUTOR_H
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+/* Fixed pool of worker threads for task callbacks
+
+   Every worker has its own deque, post() spreads jobs round-robin over them,
+   a worker takes jobs from the front of its own deque and steals from the back
+   of the others when it runs dry, so one slow job never holds up the rest.
+
+   A job cannot wait for its own pool: wait() and waitUntil() return at once on a worker,
+   waitUntil() with false.
+*/
+
+class TaskExecutor final
+{
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> jobs;
+    };
+
+    std::atomic_bool isrun = true;
+    std::atomic_size_t queued = 0;
+    std::atomic_size_t active = 0;
+    std::atomic_size_t sleeping = 0;
+    std::atomic_uint next = 0;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::condition_variable idle;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    bool take(unsigned index, std::function<void()> & job);
+    void work(unsigned index);
+
+public:
+
+    explicit TaskExecutor(unsigned threads);
+    ~TaskExecutor(); //runs the queued jobs and joins the workers
+
+    TaskExecutor(const TaskExecutor &) = delete;
+    TaskExecutor & operator=(const TaskExecutor &) = delete;
+
+    unsigned size() const;
+    std::size_t pending() const; //queued + running
+    bool isWorker() const; //the calling thread is a worker of this pool
+
+    void post(std::function<void()> job);
+    void wait(); //until every posted job has finished
+    bool waitUntil(std::chrono::steady_clock::time_point deadline); //false - jobs left at the deadline
+};
+
+#endif // TASKEXECUTOR_H
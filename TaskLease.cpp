@@ -0,0 +1,127 @@
+#include "TaskLease.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <random>
+#include <thread>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+
+FileLease::FileLease(const std::string & path, milliseconds ttl) : period(ttl)
+{
+    std::random_device random;
+    do self = (std::uint64_t(random()) << 32) | random(); while(self == 0);
+
+#ifndef WIN32
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+#else
+    (void)path;
+#endif
+}
+
+FileLease::~FileLease()
+{
+    release();
+
+#ifndef WIN32
+    if(fd >= 0) ::close(fd);
+#endif
+}
+
+bool FileLease::isOpen() const
+{
+    return fd >= 0;
+}
+
+std::uint64_t FileLease::id() const
+{
+    return self;
+}
+
+milliseconds FileLease::ttl() const
+{
+    return period;
+}
+
+bool FileLease::renew(std::vector<std::uint64_t> & members)
+{
+    return update(false, &members);
+}
+
+void FileLease::release()
+{
+    update(true, nullptr);
+}
+
+bool FileLease::update(bool leave, std::vector<std::uint64_t> * members)
+{
+#ifndef WIN32
+    if(fd < 0) return false;
+
+    std::lock_guard<std::mutex>guard(mutex);
+
+    //Called by the scheduler between its ticks, a stopped or hung peer holding the lock must not freeze it:
+    //the renewal fails after a bounded wait and this replica owns nothing until one succeeds
+    for(unsigned attempt = 1; ::flock(fd, LOCK_EX | LOCK_NB) != 0; attempt++)
+    {
+        if((errno != EWOULDBLOCK && errno != EINTR) || attempt == lockAttempts) return false;
+        std::this_thread::sleep_for(microseconds(100));
+    }
+
+    Member table[capacity] = {};
+
+    if(::pread(fd, table, sizeof(table), 0) < 0) //a new file reads as empty, a short one as zeros
+    {
+       ::flock(fd, LOCK_UN); //the rows of the peers are only written back after they were read
+       return false;
+    }
+
+    const std::int64_t now = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    const std::int64_t expired = now - duration_cast<nanoseconds>(period).count();
+
+    Member * own = nullptr;
+    Member * free = nullptr;
+
+    for(Member & member : table)
+    {
+        if(member.id != 0 && member.heartbeat < expired) member = Member(); //dead, its row is reused
+        if(member.id == self) own = &member;
+        if(member.id == 0 && !free) free = &member;
+    }
+
+    bool result = true;
+
+    if(leave){ if(own) *own = Member(); }
+    else if(own) own->heartbeat = now;
+    else if(free) *free = {self, now, now};
+    else result = false; //the table is full
+
+    result = ::pwrite(fd, table, sizeof(table), 0) == ssize_t(sizeof(table)) && result;
+
+    if(members && result)
+    {
+       Member * alive[capacity];
+       std::size_t count = 0;
+
+       for(Member & member : table){ if(member.id != 0) alive[count++] = &member; }
+       std::sort(alive, alive + count, [](const Member * a, const Member * b){ return (a->joined != b->joined) ? a->joined < b->joined : a->id < b->id; });
+
+       members->clear();
+       for(std::size_t i = 0; i < count; i++) members->push_back(alive[i]->id);
+    }
+
+    ::flock(fd, LOCK_UN);
+
+    return result;
+#else
+    (void)leave;
+    (void)members;
+    return false;
+#endif
+}
@@ -0,0 +1,69 @@
+#ifndef TASKLEASE_H
+#define TASKLEASE_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Membership of the replicas that share the tasks of a TasksController
+
+   Every replica renews its lease, renew() records it as alive and gives the ids of the live replicas in the order
+   they joined, so the first one is the leader. A replica that has not renewed for ttl() is dead for the others,
+   one that comes back after that joins again at the end. TasksController::setLease() renews every ttl / 3 from
+   its scheduler and decides from the members which tasks fire on this replica.
+
+   FileLease keeps the members in a table of a file on one host, a path in /dev/shm is a shared-memory segment.
+   The table is read and written under flock(), the time is steady_clock, the same for every process of the host.
+   The lock is waited for a few milliseconds at most, renew() fails while a stopped or hung peer holds it.
+   Other backends (a database row, a lock service) implement the three calls. Windows: renew() fails.
+*/
+
+class TaskLease
+{
+public:
+    virtual ~TaskLease() = default;
+
+    virtual std::uint64_t id() const = 0; //of this replica, not 0
+    virtual std::chrono::milliseconds ttl() const = 0;
+    virtual bool renew(std::vector<std::uint64_t> & members) = 0; //false - the backend failed, members is not valid
+    virtual void release() = 0; //leaves at once, the others see it on their next renew()
+};
+
+class FileLease final : public TaskLease
+{
+public:
+    static constexpr std::size_t capacity = 64; //replicas in one table
+    static constexpr unsigned lockAttempts = 20; //100 us apart
+
+    explicit FileLease(const std::string & path, std::chrono::milliseconds ttl = std::chrono::seconds(3));
+    ~FileLease(); //release()
+
+    FileLease(const FileLease &) = delete;
+    FileLease & operator=(const FileLease &) = delete;
+
+    bool isOpen() const;
+
+    std::uint64_t id() const override;
+    std::chrono::milliseconds ttl() const override;
+    bool renew(std::vector<std::uint64_t> & members) override;
+    void release() override;
+
+private:
+    struct Member //a row of the table, id 0 - free
+    {
+        std::uint64_t id;
+        std::int64_t joined;    //ns of steady_clock
+        std::int64_t heartbeat;
+    };
+
+    std::mutex mutex; //the threads of a process share the flock() of the descriptor
+    int fd = -1;
+    std::uint64_t self;
+    std::chrono::milliseconds period;
+
+    bool update(bool leave, std::vector<std::uint64_t> * members); //one locked read-modify-write of the table
+};
+
+#endif // TASKLEASE_H
@@ -1,29 +1,44 @@
 #include "TasksController.h"
 
+#include <algorithm>
+#include <type_traits>
 #include <thread>
-#include <charconv>
+#include <fstream>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(TASKSCONTROLLER_NO_SIMD)
+#include <emmintrin.h>
+#endif
 
 #ifdef WIN32
 #include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #endif
 
 using Now = std::chrono::system_clock::time_point;
 using namespace std::chrono;
 
-static hours getTimeZone()
+static inline system_clock::time_point GetFromNow() //local time of the system zone, a controller uses its own zone and clock
 {
-#ifdef WIN32
-    TIME_ZONE_INFORMATION timeZoneInfo;
-    if(GetTimeZoneInformation(&timeZoneInfo) == TIME_ZONE_ID_INVALID) return hours(0);
-    return hours(-(timeZoneInfo.Bias/60));
-#else
-       return hours(0);
-#endif
-}
+    thread_local TimeZone::Period period = {}; //empty, the first call looks the zone up
 
-static inline system_clock::time_point GetFromNow()
-{
-    return system_clock::now() + getTimeZone();
+    const auto utc = TaskClock::current().utc();
+    if(utc >= period.end || utc < period.begin) period = TimeZone::local().period(utc);
+
+    return utc + period.offset;
 }
 
 static inline system_clock::time_point GetFromDate(const unsigned char day, const unsigned char month, const unsigned int year)
@@ -45,7 +60,7 @@ static inline system_clock::time_point GetOnlyDateFromPoint(const Now & now)
 
 //------------------Day------------------------------
 
-static void dayPattern(std::function<bool(const Now &, bool)> & calculate, const unsigned char day, const system_clock::time_point & now, const seconds & sum)
+static Now dayPattern(const unsigned char day, const Now & now, const milliseconds & sum)
 {
     int year;
     unsigned char month;
@@ -57,7 +72,7 @@ static void dayPattern(std::function<bool(const Now &, bool)> & calculate, const
     }
 
     while(!month_day(::month(month), ::day(day)).ok()) month++;
-    system_clock::time_point finish = GetFromDate(day, month, year) + sum;
+    Now finish = GetFromDate(day, month, year) + sum;
 
     if(now > finish)
     {
@@ -70,37 +85,34 @@ static void dayPattern(std::function<bool(const Now &, bool)> & calculate, const
        else finish = GetFromDate(day, 1, year + 1) + sum;
     }
 
-    calculate = [day, sum, finish](const Now & now, bool recalc) mutable
-    {
-       if(now > finish || recalc)
-       {          
-          int year;
-          unsigned char month;
+    return finish;
+}
 
-          {
-            year_month_day ymd(floor<days>(now));
-            year = static_cast<int>(ymd.year());
-            month = static_cast<unsigned>(ymd.month()) + 1;
-          }
+static Now dayPatternNext(const unsigned char day, const Now & now, const milliseconds & sum)
+{
+    int year;
+    unsigned char month;
 
-          if(month <= 12)
-          {
-             while(!month_day(::month(month), ::day(day)).ok()) month++;
-             finish = GetFromDate(day, month, year) + sum;
-          }
-          else finish = GetFromDate(day, 1, year + 1) + sum;
+    {
+      year_month_day ymd(floor<days>(now));
+      year = static_cast<int>(ymd.year());
+      month = static_cast<unsigned>(ymd.month()) + 1;
+    }
 
-          return !recalc;
-       }
-       return false;
-    };
+    if(month <= 12)
+    {
+       while(!month_day(::month(month), ::day(day)).ok()) month++;
+       return GetFromDate(day, month, year) + sum;
+    }
+
+    return GetFromDate(day, 1, year + 1) + sum;
 }
 
-static void dayMonthPattern(std::function<bool(const Now &, bool)> & calculate, const unsigned char day, const unsigned char month, const system_clock::time_point & now, const seconds & sum)
+static Now dayMonthPattern(const unsigned char day, const unsigned char month, const Now & now, const milliseconds & sum)
 {
     int year = static_cast<int>(year_month_day(floor<days>(now)).year());
     while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
-    system_clock::time_point finish = GetFromDate(day, month, year) + sum;
+    Now finish = GetFromDate(day, month, year) + sum;
 
     if(now > finish)
     {
@@ -109,172 +121,209 @@ static void dayMonthPattern(std::function<bool(const Now &, bool)> & calculate,
        finish = GetFromDate(day, month, year) + sum;
     }
 
-    calculate = [day, month, sum, finish](const Now & now, bool recalc) mutable
-    {
-       if(now > finish || recalc)
-       {
-          int year = static_cast<int>(year_month_day(floor<days>(now)).year()) + 1;
-          while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
-          finish = GetFromDate(day, month, year) + sum;
+    return finish;
+}
 
-          return !recalc;
-       }
-       return false;
-    };
+static Now dayMonthPatternNext(const unsigned char day, const unsigned char month, const Now & now, const milliseconds & sum)
+{
+    int year = static_cast<int>(year_month_day(floor<days>(now)).year()) + 1;
+    while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
+    return GetFromDate(day, month, year) + sum;
 }
 
 //------------------Only Weekday--------------------------
 
-static void weekdayPattern(std::function<bool(const Now &, bool)> & calculate, const unsigned char weekday, const system_clock::time_point & now, const seconds & sum)
+static Now weekdayPattern(const unsigned char c_weekday, const Now & now, const milliseconds & sum)
 {
-    const unsigned char c_weekday = (weekday == 7) ? 0 : weekday;
     year_month_weekday cw{floor<days>(now)};
-    system_clock::time_point finish = GetFromWeekDate(cw.weekday_indexed().index(), c_weekday, cw.month(), cw.year()) + sum;
+    Now finish = GetFromWeekDate(cw.weekday_indexed().index(), c_weekday, cw.month(), cw.year()) + sum;
 
     if(now > finish) finish = GetFromWeekDate(cw.weekday_indexed().index() + 1, c_weekday, cw.month(), cw.year()) + sum;
 
-    calculate = [c_weekday, sum, finish](const Now & now, bool recalc) mutable
-    {
-       if(now > finish || recalc)
-       {
-          year_month_weekday cw{floor<days>(now)};
-          finish = GetFromWeekDate(cw.weekday_indexed().index(), c_weekday, cw.month(), cw.year()) + sum;
-          if(now > finish) finish = GetFromWeekDate(cw.weekday_indexed().index() + 1, c_weekday, cw.month(), cw.year()) + sum;
-
-          return !recalc;
-       }
-       return false;
-    };
+    return finish;
 }
 
 //------------------Only Month----------------------------
 
-static void monthPattern(std::function<bool(const Now &, bool)> & calculate, const unsigned char month, const system_clock::time_point & now, const seconds & sum)
+static Now monthPattern(const unsigned char month, const Now & now, const milliseconds & sum)
 {
     year_month_day ymd(floor<days>(now));
-    system_clock::time_point finish = GetFromDate(1, month, static_cast<int>(ymd.year())) + sum;
+    Now finish = GetFromDate(1, month, static_cast<int>(ymd.year())) + sum;
 
     if(now > finish) finish = GetFromDate(1, month, static_cast<int>(ymd.year()) + 1) + sum;
 
-    calculate = [month, sum, finish](const Now & now, bool recalc) mutable
-    {
-       if(now > finish || recalc)
-       {
-          year_month_day ymd(floor<days>(now));
-          finish = GetFromDate(1, month, static_cast<int>(ymd.year()) + 1) + sum;
+    return finish;
+}
 
-          return !recalc;
-       }
-       return false;
-    };
+static Now monthPatternNext(const unsigned char month, const Now & now, const milliseconds & sum)
+{
+    year_month_day ymd(floor<days>(now));
+    return GetFromDate(1, month, static_cast<int>(ymd.year()) + 1) + sum;
 }
 
 //------------------Only Time-----------------------------
 
-static void hoursPattern(std::function<bool(const Now &, bool)> & calculate, const system_clock::time_point & now, const seconds & sum)
+static Now hoursPattern(const Now & now, const milliseconds & sum)
 {
-    system_clock::time_point finish = GetOnlyDateFromPoint(now) + sum;
+    Now finish = GetOnlyDateFromPoint(now) + sum;
 
     if(now > finish) finish += days(1);
 
-    calculate = [sum, finish](const Now & now, bool recalc) mutable
-    {
-       if(now > finish || recalc)
-       {
-          finish = GetOnlyDateFromPoint(now) + days(1) + sum;
-
-          return !recalc;
-       }
-       return false;
-    };
+    return finish;
 }
 
-static void minutesPattern(std::function<bool(const Now &, bool)> & calculate, const system_clock::time_point & now, const seconds & sum)
+static Now minutesPattern(const Now & now, const milliseconds & sum)
 {
     auto onlyDate = GetOnlyDateFromPoint(now);
     hh_mm_ss time(now - onlyDate);
-    system_clock::time_point finish = onlyDate + time.hours() + sum;
+    Now finish = onlyDate + time.hours() + sum;
 
     if(now > finish) finish += ::hours(1);
 
-    calculate = [sum, finish](const Now & now, bool recalc) mutable
-    {
-       if(now > finish || recalc)
-       {
-          system_clock::time_point date = GetOnlyDateFromPoint(now);
-          hh_mm_ss time(now - date);
-          finish = date + time.hours() + ::hours(1) + sum;
-
-          return !recalc;
-       }
-       return false;
-    };
+    return finish;
 }
 
-static bool onlyTimePattern(std::function<bool(const Now &, bool)> & calculate,
-                            const unsigned char seconds,
-                            const unsigned char minutes,
-                            const unsigned char hours,
-                            const system_clock::time_point & now,
-                            bool isZeroHour,
-                            bool isZeroMinute,
-                            bool isZeroSecond)
+static Now minutesPatternNext(const Now & now, const milliseconds & sum)
 {
-    if(hours > 0 || isZeroHour)
-    {
-       hoursPattern(calculate, now, ::seconds(seconds) + ::minutes(minutes) + ::hours(hours));
-       return true;
-    }
+    Now date = GetOnlyDateFromPoint(now);
+    hh_mm_ss time(now - date);
+    return date + time.hours() + ::hours(1) + sum;
+}
 
-    if(minutes > 0 || isZeroMinute)
-    {
-       minutesPattern(calculate, now, ::seconds(seconds) + ::minutes(minutes));
-       return true;
-    }
+static Now secondsPattern(const Now & now, const milliseconds & sum)
+{
+    auto onlyDate = GetOnlyDateFromPoint(now);
+    hh_mm_ss time(now - onlyDate);
+    Now finish = onlyDate + time.hours() + time.minutes() + sum;
 
-    if(seconds > 0 || isZeroSecond)
-    {
-       ::seconds s_seconds(seconds);
-       auto onlyDate = GetOnlyDateFromPoint(now);
-       hh_mm_ss time(now - onlyDate);
-       system_clock::time_point finish = onlyDate + time.hours() + time.minutes() + s_seconds;
+    if(now > finish) finish += ::minutes(1);
 
-       if(now > finish) finish += ::minutes(1);
+    return finish;
+}
 
-       calculate = [s_seconds, finish](const Now & now, bool recalc) mutable
-       {
-          if(now > finish || recalc)
-          {
-             system_clock::time_point date = GetOnlyDateFromPoint(now);
-             hh_mm_ss time(now - date);
-             finish = date + time.hours() + time.minutes() + ::minutes(1) + s_seconds;
+static Now secondsPatternNext(const Now & now, const milliseconds & sum)
+{
+    Now date = GetOnlyDateFromPoint(now);
+    hh_mm_ss time(now - date);
+    return date + time.hours() + time.minutes() + ::minutes(1) + sum;
+}
 
-             return !recalc;
-          }
-          return false;
-       };
+//------------------Cron Expression-----------------------
 
-       return true;
-    }
+static Now cronPattern(const std::uint32_t expression, const Now & now, bool recalc) //recalc - at or after now, otherwise after it
+{
+    const CronExpression * cron = CronExpression::find(expression);
+    const seconds from = (recalc) ? ceil<seconds>(now.time_since_epoch()) : floor<seconds>(now.time_since_epoch()) + seconds(1);
+    const std::int64_t next = (cron) ? cron->next(from.count()) : -1;
 
-    return false;
+    return (next < 0) ? Now::max() : Now(seconds(next));
 }
 
 //-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 
+static_assert(std::is_trivially_copyable_v<Task>, "Task is copied into the slot table without allocations");
+static_assert(sizeof(Task) <= 24, "Task should stay a compact schedule record");
+
 Task::Task(){}
 
 Task::Task(std::string_view value){ parseFromString(value); }
 
 bool Task::isValid() const
 {
-    return (calculate) ? true : false;
+    return pattern != Empty;
 }
 
-bool Task::taskCalculate(const Now &now, bool recalc) const
+bool Task::taskCalculate(const Now & now, bool recalc) const
 {
-    if(calculate) return calculate(now, recalc);
-    return false;
+    return taskCalculate(now, TaskClock::current().steady(), recalc);
+}
+
+bool Task::taskCalculate(const Now & now, const Steady & steady, bool recalc) const
+{
+    if(pattern == Empty) return false;
+
+    if(pattern == Period)
+    {
+       const nanoseconds current = steady.time_since_epoch();
+
+       if(recalc) finish = current + sum;
+       else if(current <= finish) return false;
+       else finish = (current < finish + sum) ? finish + sum : current + sum; //keeps the cadence, missed periods are skipped
+
+       return !recalc;
+    }
+
+    if(now.time_since_epoch() <= finish && !recalc) return false;
+
+    Now next;
+
+    if(recalc) //the first fire from now, nothing is fired for the time the clock skipped
+    {
+       switch(pattern)
+       {
+          case Day:      next = dayPattern(day, now, sum); break;
+          case DayMonth: next = dayMonthPattern(day, month, now, sum); break;
+          case Weekday:  next = weekdayPattern(day, now, sum); break;
+          case Month:    next = monthPattern(month, now, sum); break;
+          case Hours:    next = hoursPattern(now, sum); break;
+          case Minutes:  next = minutesPattern(now, sum); break;
+          case Seconds:  next = secondsPattern(now, sum); break;
+          case Expression: next = cronPattern(expression, now, true); break;
+          default: return false;
+       }
+    }
+    else
+    {
+       switch(pattern)
+       {
+          case Day:      next = dayPatternNext(day, now, sum); break;
+          case DayMonth: next = dayMonthPatternNext(day, month, now, sum); break;
+          case Weekday:  next = weekdayPattern(day, now, sum); break;
+          case Month:    next = monthPatternNext(month, now, sum); break;
+          case Hours:    next = GetOnlyDateFromPoint(now) + days(1) + sum; break;
+          case Minutes:  next = minutesPatternNext(now, sum); break;
+          case Seconds:  next = secondsPatternNext(now, sum); break;
+          case Expression: next = cronPattern(expression, now, false); break;
+          default: return false;
+       }
+    }
+
+    setFinish(next);
+
+    return !recalc;
+}
+
+Now Task::nextFire() const
+{
+    if(pattern == Period) return GetFromNow() + duration_cast<system_clock::duration>(finish - TaskClock::current().steady().time_since_epoch());
+    return Now(duration_cast<system_clock::duration>(finish));
+}
+
+Task::Steady Task::nextSteadyFire() const
+{
+    if(pattern == Period) return Steady(duration_cast<steady_clock::duration>(finish));
+    return TaskClock::current().steady() + duration_cast<steady_clock::duration>(finish - GetFromNow().time_since_epoch());
+}
+
+bool Task::isCalendar() const
+{
+    return pattern != Empty && pattern != Period;
+}
+
+bool Task::isSubDaily() const
+{
+    if(pattern == Expression)
+    {
+       const CronExpression * cron = CronExpression::find(expression);
+       return cron && cron->isSubDaily();
+    }
+
+    return pattern == Minutes || pattern == Seconds;
+}
+
+void Task::setFinish(const Now & time) const
+{
+    finish = duration_cast<nanoseconds>(time.time_since_epoch());
 }
 
 Task::Type Task::taskType() const
@@ -284,7 +333,53 @@ Task::Type Task::taskType() const
 
 bool Task::isSingle() const
 {
-    return (type == SinglePoint || type == SingleInterval);
+    return (type == SinglePoint || type == SingleInterval || type == SingleCron);
+}
+
+void Task::reset()
+{
+    type = None;
+    pattern = Empty;
+    day = 0;
+    month = 0;
+    expression = 0;
+    sum = ::seconds(0);
+    finish = nanoseconds(0);
+}
+
+bool Task::onlyTimeInit(const unsigned char seconds,
+                        const unsigned char minutes,
+                        const unsigned char hours,
+                        const Now & now,
+                        bool isZeroHour,
+                        bool isZeroMinute,
+                        bool isZeroSecond)
+{
+    if(hours > 0 || isZeroHour)
+    {
+       pattern = Hours;
+       sum = ::seconds(seconds) + ::minutes(minutes) + ::hours(hours);
+       setFinish(hoursPattern(now, sum));
+       return true;
+    }
+
+    if(minutes > 0 || isZeroMinute)
+    {
+       pattern = Minutes;
+       sum = ::seconds(seconds) + ::minutes(minutes);
+       setFinish(minutesPattern(now, sum));
+       return true;
+    }
+
+    if(seconds > 0 || isZeroSecond)
+    {
+       pattern = Seconds;
+       sum = ::seconds(seconds);
+       setFinish(secondsPattern(now, sum));
+       return true;
+    }
+
+    return false;
 }
 
 bool Task::pointDayTaskInit(const unsigned char seconds,
@@ -293,8 +388,7 @@ bool Task::pointDayTaskInit(const unsigned char seconds,
                             const unsigned char day,
                             const unsigned char month)
 {
-    calculate = nullptr;
-    type = None;
+    reset();
 
     //==============================================
 
@@ -328,30 +422,46 @@ bool Task::pointDayTaskInit(const unsigned char seconds,
 
     //----------------
 
-    system_clock::time_point now = GetFromNow();
+    Now now = GetFromNow();
+    const ::seconds time = ::seconds(s) + ::minutes(m) + ::hours(h);
 
     //----------------
 
     if(day > 0 && month == 0)
     {
-       dayPattern(calculate, day, now, ::seconds(s) + ::minutes(m) + ::hours(h));
+       pattern = Day;
+       this->day = day;
+       sum = time;
+       setFinish(dayPattern(day, now, sum));
        return true;
     }
 
     if(day == 0 && month > 0)
     {
-       monthPattern(calculate, month, now, ::seconds(s) + ::minutes(m) + ::hours(h));
+       pattern = Month;
+       this->month = month;
+       sum = time;
+       setFinish(monthPattern(month, now, sum));
        return true;
     }
 
     if(day > 0 && month > 0)
     {
-       if(!month_day{::month(month), ::day(day)}.ok()) return false;
-       dayMonthPattern(calculate, day, month, now, ::seconds(s) + ::minutes(m) + ::hours(h));
+       if(!month_day{::month(month), ::day(day)}.ok())
+       {
+          type = None;
+          return false;
+       }
+
+       pattern = DayMonth;
+       this->day = day;
+       this->month = month;
+       sum = time;
+       setFinish(dayMonthPattern(day, month, now, sum));
        return true;
     }
 
-    if(onlyTimePattern(calculate, s, m, h, now, isZeroHour, isZeroMinute, isZeroSecond)) return true;
+    if(onlyTimeInit(s, m, h, now, isZeroHour, isZeroMinute, isZeroSecond)) return true;
 
     type = None;
 
@@ -379,8 +489,7 @@ bool Task::pointWeekTaskInit(const unsigned char seconds,
                              const unsigned char hours,
                              const unsigned char weekday)
 {
-    calculate = nullptr;
-    type = None;
+    reset();
 
     //==============================================
 
@@ -393,17 +502,20 @@ bool Task::pointWeekTaskInit(const unsigned char seconds,
 
     //----------------
 
-    system_clock::time_point now = GetFromNow();
+    Now now = GetFromNow();
 
     //----------------
 
     if(weekday > 0)
     {
-       weekdayPattern(calculate, weekday, now, ::seconds(seconds) + ::minutes(minutes) + ::hours(hours));
+       pattern = Weekday;
+       day = (weekday == 7) ? 0 : weekday;
+       sum = ::seconds(seconds) + ::minutes(minutes) + ::hours(hours);
+       setFinish(weekdayPattern(day, now, sum));
        return true;
     }
 
-    if(onlyTimePattern(calculate, seconds, minutes, hours, now, false, false, false)) return true;
+    if(onlyTimeInit(seconds, minutes, hours, now, false, false, false)) return true;
 
     type = None;
 
@@ -427,33 +539,22 @@ bool Task::singlePointWeekTaskInit(const unsigned char seconds,
 bool Task::intervalTaskInit(const unsigned char seconds,
                             const unsigned char minutes,
                             const unsigned char hours,
-                            const unsigned short days)
+                            const unsigned short days,
+                            const unsigned short milliseconds)
 {
-    calculate = nullptr;
-    type = None;
+    reset();
 
     //==============================================
 
-    if(seconds >= 60 || minutes >= 60 || hours >= 24) return false;
-    if(seconds == 0 && minutes == 0 && hours == 0 && days == 0) return false;
+    if(milliseconds >= 1000 || seconds >= 60 || minutes >= 60 || hours >= 24) return false;
+    if(milliseconds == 0 && seconds == 0 && minutes == 0 && hours == 0 && days == 0) return false;
 
     //==============================================
 
     type = Point;
-
-    const ::seconds interval = ::seconds(seconds) + ::minutes(minutes) + ::hours(hours) + ::days(days);
-    system_clock::time_point finish = GetFromNow() + interval;
-
-    calculate = [interval, finish](const Now & now, bool recalc) mutable
-    {
-       if(now > finish || recalc)
-       {
-          finish = now + interval;
-
-          return !recalc;
-       }
-       else return false;
-    };
+    pattern = Period;
+    sum = ::milliseconds(milliseconds) + ::seconds(seconds) + ::minutes(minutes) + ::hours(hours) + ::days(days);
+    finish = TaskClock::current().steady().time_since_epoch() + sum;
 
     return true;
 }
@@ -461,9 +562,10 @@ bool Task::intervalTaskInit(const unsigned char seconds,
 bool Task::singleIntervalTaskInit(const unsigned char seconds,
                                   const unsigned char minutes,
                                   const unsigned char hours,
-                                  const unsigned short days)
+                                  const unsigned short days,
+                                  const unsigned short milliseconds)
 {
-    if(intervalTaskInit(seconds, minutes, hours, days))
+    if(intervalTaskInit(seconds, minutes, hours, days, milliseconds))
     {
        type = SingleInterval;
        return true;
@@ -472,409 +574,2501 @@ bool Task::singleIntervalTaskInit(const unsigned char seconds,
     return false;
 }
 
-static bool parsePoint(int offset, std::string_view value, const std::function<bool(unsigned char,unsigned char,unsigned char,unsigned char,unsigned char)> & func)
+bool Task::cronTaskInit(std::string_view expression)
 {
-    if(value[4 + offset] != '/' || value[7 + offset] != ' ' || value[10 + offset] != ':' || value[13 + offset] != ':') return false;
-
-    std::string_view sd = value.substr(2 + offset,2);
-    if(!std::isdigit(sd[0]) || !std::isdigit(sd[1])) return false;
-
-    unsigned char day;
-    std::from_chars(sd.begin(), sd.end(), day);
-
-    std::string_view sm = value.substr(5 + offset,2);
-    if(!std::isdigit(sm[0]) || !std::isdigit(sm[1])) return false;
-
-    unsigned char month;
-    std::from_chars(sm.begin(), sm.end(), month);
-
-    std::string_view th = value.substr(8 + offset,2);
-    if(!std::isdigit(th[0]) || !std::isdigit(th[1])) return false;
+    reset();
 
-    unsigned char hours;
-    std::from_chars(th.begin(), th.end(), hours);
+    //==============================================
 
-    std::string_view tm = value.substr(11 + offset,2);
-    if(!std::isdigit(tm[0]) || !std::isdigit(tm[1])) return false;
+    const std::uint32_t id = CronExpression::intern(CronExpression(expression));
+    if(id == 0) return false;
 
-    unsigned char minutes;
-    std::from_chars(tm.begin(), tm.end(), minutes);
+    //==============================================
 
-    std::string_view ts = value.substr(14 + offset,2);
-    if(!std::isdigit(ts[0]) || !std::isdigit(ts[1])) return false;
+    type = Cron;
+    pattern = Expression;
+    this->expression = id;
+    setFinish(cronPattern(id, GetFromNow(), true));
 
-    unsigned char seconds;
-    std::from_chars(ts.begin(), ts.end(), seconds);
+    return true;
+}
 
-    if(func) return func(seconds, minutes, hours, day, month);
+bool Task::singleCronTaskInit(std::string_view expression)
+{
+    if(cronTaskInit(expression))
+    {
+       type = SingleCron;
+       return true;
+    }
 
     return false;
 }
 
-static bool parseInterval(int offset, std::string_view value, const std::function<bool(unsigned char,unsigned char,unsigned char,unsigned short)> & func)
-{
-    if(value[7 + offset] != ' ' || value[10 + offset] != ':' || value[13 + offset] != ':') return false;
+//------------------Fixed-width parser--------------------
+
+/* The body of every format without its leading 'S' is one of three fixed layouts:
 
-    std::string_view sd = value.substr(2 + offset,5);
-    if(!std::isdigit(sd[0]) || !std::isdigit(sd[1]) || !std::isdigit(sd[2]) || !std::isdigit(sd[3]) || !std::isdigit(sd[4])) return false;
+   P DD/MM hh:mm:ss   - 16
+   W D hh:mm:ss       - 12
+   I DDDDD hh:mm:ss   - 16, 20 with the .mmm suffix
 
-    unsigned short days;
-    std::from_chars(sd.begin(), sd.end(), days);
+   C with a cron expression is not fixed-width, parseFromString() hands it to CronExpression.
+   '0' marks a digit position, all other positions inside the length must match literally.
+   The whole body is checked at once with SSE2 where available, the .mmm suffix separately.
+   TASKSCONTROLLER_NO_SIMD selects the scalar loop, the tests compare both with the previous parser.
+*/
 
-    std::string_view th = value.substr(8 + offset,2);
-    if(!std::isdigit(th[0]) || !std::isdigit(th[1])) return false;
+struct ScheduleLayout
+{
+    char templ[16];
+    unsigned short length;
+    unsigned short digits; //bit i - position i must be a digit
+};
 
-    unsigned char hours;
-    std::from_chars(th.begin(), th.end(), hours);
+static constexpr ScheduleLayout pointLayout    = {{'P',' ','0','0','/','0','0',' ','0','0',':','0','0',':','0','0'}, 16, 0b1101101101101100};
+static constexpr ScheduleLayout weekLayout     = {{'W',' ','0',' ','0','0',':','0','0',':','0','0', 0 , 0 , 0 , 0 }, 12, 0b0000110110110100};
+static constexpr ScheduleLayout intervalLayout = {{'I',' ','0','0','0','0','0',' ','0','0',':','0','0',':','0','0'}, 16, 0b1101101101111100};
 
-    std::string_view tm = value.substr(11 + offset,2);
-    if(!std::isdigit(tm[0]) || !std::isdigit(tm[1])) return false;
+struct Schedule
+{
+    char kind = 0; //P, W, I
+    bool single = false;
+    unsigned short days = 0;
+    unsigned char day = 0;
+    unsigned char month = 0;
+    unsigned char weekday = 0;
+    unsigned char hours = 0;
+    unsigned char minutes = 0;
+    unsigned char seconds = 0;
+    unsigned short milliseconds = 0;
+};
+
+static bool matchLayout(const char * body, const ScheduleLayout & layout)
+{
+    const unsigned mask = (1u << layout.length) - 1;
+    const unsigned literals = mask & ~static_cast<unsigned>(layout.digits);
 
-    unsigned char minutes;
-    std::from_chars(tm.begin(), tm.end(), minutes);
+#if (defined(__SSE2__) || defined(_M_X64)) && !defined(TASKSCONTROLLER_NO_SIMD)
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(body));
+    __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(layout.templ));
 
-    std::string_view ts = value.substr(14 + offset,2);
-    if(!std::isdigit(ts[0]) || !std::isdigit(ts[1])) return false;
+    unsigned digits = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                                                            _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)))));
+    unsigned equal = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, t)));
+#else
+    unsigned digits = 0, equal = 0;
 
-    unsigned char seconds;
-    std::from_chars(ts.begin(), ts.end(), seconds);
+    for(unsigned i = 0; i < 16; i++)
+    {
+        if(body[i] >= '0' && body[i] <= '9') digits |= 1u << i;
+        if(body[i] == layout.templ[i]) equal |= 1u << i;
+    }
+#endif
 
-    if(func) return func(seconds, minutes, hours, days);
+    return (digits & layout.digits) == layout.digits && (equal & literals) == literals;
+}
 
-    return false;
+static inline unsigned char twoDigits(const char * p)
+{
+    return static_cast<unsigned char>((p[0] - '0') * 10 + (p[1] - '0'));
 }
 
-static bool parseWeek(int offset, std::string_view value, const std::function<bool(unsigned char,unsigned char,unsigned char,unsigned char)> & func)
+static bool parseSchedule(std::string_view value, Schedule & schedule)
 {
-    if(value[3 + offset] != ' ' || value[6 + offset] != ':' || value[9 + offset] != ':') return false;
+    schedule.single = value.starts_with('S');
+    if(schedule.single) value.remove_prefix(1);
 
-    std::string_view swd = value.substr(2 + offset,1);
+    if(value.size() < 12 || value.size() > 20) return false;
 
-    if(!std::isdigit(swd[0])) return false;
+    alignas(16) char body[32] = {};
+    std::copy(value.begin(), value.end(), body);
 
-    unsigned char weekday;
-    std::from_chars(swd.begin(), swd.end(), weekday);
+    schedule.kind = body[0];
 
-    std::string_view th = value.substr(4 + offset,2);
-    if(!std::isdigit(th[0]) || !std::isdigit(th[1])) return false;
+    switch(schedule.kind)
+    {
+       case 'P':
 
-    unsigned char hours;
-    std::from_chars(th.begin(), th.end(), hours);
+            if(value.size() != pointLayout.length || !matchLayout(body, pointLayout)) return false;
 
-    std::string_view tm = value.substr(7 + offset,2);
-    if(!std::isdigit(tm[0]) || !std::isdigit(tm[1])) return false;
+            schedule.day = twoDigits(body + 2);
+            schedule.month = twoDigits(body + 5);
+            schedule.hours = twoDigits(body + 8);
+            schedule.minutes = twoDigits(body + 11);
+            schedule.seconds = twoDigits(body + 14);
+            return true;
 
-    unsigned char minutes;
-    std::from_chars(tm.begin(), tm.end(), minutes);
+       case 'W':
 
-    std::string_view ts = value.substr(10 + offset,2);
-    if(!std::isdigit(ts[0]) || !std::isdigit(ts[1])) return false;
+            if(value.size() != weekLayout.length || !matchLayout(body, weekLayout)) return false;
 
-    unsigned char seconds;
-    std::from_chars(ts.begin(), ts.end(), seconds);
+            schedule.weekday = static_cast<unsigned char>(body[2] - '0');
+            schedule.hours = twoDigits(body + 4);
+            schedule.minutes = twoDigits(body + 7);
+            schedule.seconds = twoDigits(body + 10);
+            return true;
 
-    if(func) return func(seconds, minutes, hours, weekday);
+       case 'I':
+       {
+            if(value.size() != intervalLayout.length && value.size() != intervalLayout.length + 4) return false;
+            if(!matchLayout(body, intervalLayout)) return false;
+
+            if(value.size() > intervalLayout.length) //.mmm
+            {
+               if(body[16] != '.') return false;
+
+               for(int i = 17; i < 20; i++)
+               {
+                   if(body[i] < '0' || body[i] > '9') return false;
+                   schedule.milliseconds = schedule.milliseconds * 10 + (body[i] - '0');
+               }
+            }
+
+            unsigned days = 0;
+            for(int i = 2; i < 7; i++) days = days * 10 + (body[i] - '0');
+            if(days > 65535) return false;
+
+            schedule.days = static_cast<unsigned short>(days);
+            schedule.hours = twoDigits(body + 8);
+            schedule.minutes = twoDigits(body + 11);
+            schedule.seconds = twoDigits(body + 14);
+            return true;
+       }
+    }
 
     return false;
 }
 
 bool Task::parseFromString(std::string_view value)
 {
-    if(value.starts_with("P "))
-    {
-       if(value.size() != 16) return false;
+    if(value.starts_with("C ")) return cronTaskInit(value.substr(2));
+    if(value.starts_with("SC ")) return singleCronTaskInit(value.substr(3));
 
-       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char day, unsigned char month){
-                       return pointDayTaskInit(seconds,minutes,hours,day,month); };
+    Schedule schedule;
+    if(!parseSchedule(value, schedule)) return false;
 
-       return parsePoint(0, value, l);
-    }
-    else if(value.starts_with("SP "))
+    switch(schedule.kind)
     {
-       if(value.size() != 17) return false;
+       case 'P':
 
-       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char day, unsigned char month){
-                       return singlePointDayTaskInit(seconds,minutes,hours,day,month); };
+            if(schedule.single) return singlePointDayTaskInit(schedule.seconds, schedule.minutes, schedule.hours, schedule.day, schedule.month);
+            return pointDayTaskInit(schedule.seconds, schedule.minutes, schedule.hours, schedule.day, schedule.month);
 
-       return parsePoint(1, value, l);
-    }
-    else if(value.starts_with("W "))
-    {
-       if(value.size() != 12) return false;
+       case 'W':
 
-       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char weekday){
-                       return pointWeekTaskInit(seconds,minutes,hours,weekday); };
+            if(schedule.single) return singlePointWeekTaskInit(schedule.seconds, schedule.minutes, schedule.hours, schedule.weekday);
+            return pointWeekTaskInit(schedule.seconds, schedule.minutes, schedule.hours, schedule.weekday);
 
-       return parseWeek(0, value, l);
+       case 'I':
+
+            if(schedule.single) return singleIntervalTaskInit(schedule.seconds, schedule.minutes, schedule.hours, schedule.days, schedule.milliseconds);
+            return intervalTaskInit(schedule.seconds, schedule.minutes, schedule.hours, schedule.days, schedule.milliseconds);
     }
-    else if(value.starts_with("SW "))
-    {
-       if(value.size() != 13) return false;
 
-       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char weekday){
-                       return singlePointWeekTaskInit(seconds,minutes,hours,weekday); };
+    return false;
+}
+
+//===============================================
 
-       return parseWeek(1, value, l);
-    }
-    else if(value.starts_with("I "))
-    {
-       if(value.size() != 16) return false;
+std::vector<Now> Task::nextOccurrences(std::size_t n) const
+{
+    std::vector<Now> fires;
+    TaskOccurrences occurrences(*this);
+
+    Now fire;
+    while(fires.size() < n && occurrences.next(fire)) fires.push_back(fire);
+
+    return fires;
+}
 
-       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned short days){
-                       return intervalTaskInit(seconds,minutes,hours,days); };
+TaskOccurrences::TaskOccurrences(const Task & task) : TaskOccurrences(task, GetFromNow(), TaskClock::current().steady()){}
+
+TaskOccurrences::TaskOccurrences(const Task & task, const Task::Now & now, const Task::Steady & steady) :
+    task(task), shift(duration_cast<nanoseconds>(now.time_since_epoch()) - duration_cast<nanoseconds>(steady.time_since_epoch())), done(!task.isValid()){}
+
+bool TaskOccurrences::next(Task::Now & fire)
+{
+    if(done) return false;
+
+    if(started) //the fire a tick just after the last one would calculate
+    {
+       if(task.isSingle())
+       {
+          done = true;
+          return false;
+       }
 
-       return parseInterval(0,value,l);
+       const nanoseconds after = task.finish + nanoseconds(1);
+       task.taskCalculate(Now(duration_cast<system_clock::duration>(after)), Task::Steady(duration_cast<steady_clock::duration>(after)), false);
     }
-    else if(value.starts_with("SI "))
+
+    started = true;
+
+    if(task.finish == nanoseconds::max()) //a cron expression without a fire
     {
-       if(value.size() != 17) return false;
+       done = true;
+       return false;
+    }
 
-       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned short days){
-                       return singleIntervalTaskInit(seconds,minutes,hours,days); };
+    fire = Now(duration_cast<system_clock::duration>((task.pattern == Task::Period) ? task.finish + shift : task.finish));
+    return true;
+}
+
+void TaskOccurrences::skipTo(const Task::Now & from)
+{
+    if(done) return;
 
-       return parseInterval(1,value,l);
+    if(started) //the last returned fire is behind
+    {
+       Now fire;
+       if(!next(fire)) return;
+       started = false;
     }
 
-    return false;
+    const nanoseconds target = duration_cast<nanoseconds>(from.time_since_epoch());
+
+    if(task.pattern == Task::Period)
+    {
+       const nanoseconds behind = target - shift - task.finish;
+       if(behind.count() > 0) task.finish += task.sum * ((behind + task.sum - nanoseconds(1)) / task.sum);
+    }
+    else if(task.finish < target) task.taskCalculate(from, Task::Steady(), true);
 }
 
 //===============================================
 
-TasksController::TasksController(){}
+TaskHandle::TaskHandle(){}
+
+TaskHandle::TaskHandle(std::uint32_t index, std::uint32_t generation) : index(index), generation(generation){}
 
-TasksController::TasksController(unsigned short accuracy)
+bool TaskHandle::isValid() const
 {
-    setAccuracy(accuracy);
+    return generation != 0;
 }
 
-bool TasksController::clearTasks()
+TaskHandle::operator bool() const
 {
-    if(isrun.load()) return false;
-    std::lock_guard<std::mutex>lock(mutex);
-    tasks.clear();
-    return true;
+    return isValid();
 }
 
-int TasksController::countTasks()
+//===============================================
+
+TaskAwaiter::TaskAwaiter(TasksController * controller, TaskHandle handle) : controller(controller), handle(handle){}
+
+bool TaskAwaiter::await_ready() const noexcept
 {
-    std::lock_guard<std::mutex>lock(mutex);
-    return tasks.size();
+    return false;
 }
 
-unsigned short TasksController::accuracy() const
+bool TaskAwaiter::await_suspend(std::coroutine_handle<> coroutine)
 {
-    return _accuracy.load();
+    this->coroutine = coroutine; //set before it is linked, the firing thread may resume it at once
+    return controller->suspend(this);
 }
 
-bool TasksController::setAccuracy(unsigned short ms)
+bool TaskAwaiter::await_resume() const noexcept
 {
-    if(ms < 10) _accuracy = 10;
-    else if(ms > 500) _accuracy = 500;
-    else _accuracy = ms;
-
-    return true;
+    return fired;
+}
+
+//===============================================
+
+#ifdef __linux__
+//The timers are on CLOCK_REALTIME with TFD_TIMER_CANCEL_ON_SET, a change of the wall clock makes them readable
+//and the read fails with ECANCELED. The steady_clock deadline is converted when the timer is armed.
+static void armTimer(int fd, TimingWheel::Clock::time_point deadline) //absolute, max() - no deadline, min() - at once
+{
+    nanoseconds since(1);
+
+    if(deadline == TimingWheel::Clock::time_point::max()) since = system_clock::now().time_since_epoch() + days(365); //stays armed, only an armed timer is cancelled
+    else if(deadline != TimingWheel::Clock::time_point::min()) since = system_clock::now().time_since_epoch() + (deadline - TimingWheel::Clock::now());
+
+    if(since.count() <= 0) since = nanoseconds(1); //zero disarms
+
+    itimerspec timer = {};
+    timer.it_value.tv_sec = since.count() / 1000000000;
+    timer.it_value.tv_nsec = since.count() % 1000000000;
+
+    timerfd_settime(fd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &timer, nullptr);
+}
+
+static bool readTimer(int fd) //false - cancelled by a change of the wall clock
+{
+    std::uint64_t ticks;
+    return !(read(fd, &ticks, sizeof(ticks)) < 0 && errno == ECANCELED); //EAGAIN if it has not expired
+}
+#endif
+
+static bool mapFile(const std::string & path, const std::function<void(std::string_view)> & use) //false - not readable
+{
+#ifdef WIN32
+    std::ifstream file(path, std::ios::binary);
+    if(!file) return false;
+
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    use(content);
+
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+
+    if(fd < 0 || ::fstat(fd, &info) != 0)
+    {
+       if(fd >= 0) ::close(fd);
+       return false;
+    }
+
+    if(info.st_size == 0)
+    {
+       ::close(fd);
+       use({});
+       return true;
+    }
+
+    void * data = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if(data == MAP_FAILED) return false;
+
+    ::madvise(data, info.st_size, MADV_SEQUENTIAL);
+    use(std::string_view(static_cast<const char*>(data), info.st_size));
+    ::munmap(data, info.st_size);
+
+    return true;
+#endif
+}
+
+//===============================================
+
+TasksController::TasksController() : TasksController(10, 0){}
+
+TasksController::TasksController(unsigned short accuracy) : TasksController(accuracy, 0){}
+
+TasksController::TasksController(unsigned short accuracy, unsigned threads)
+{
+    setAccuracy(accuracy);
+    if(threads > 0) executor = std::make_unique<TaskExecutor>(threads);
+
+#ifdef __linux__
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    timerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if(wakeFd < 0 || timerFd < 0) //run() falls back to the semaphore
+    {
+       if(wakeFd >= 0) close(wakeFd);
+       if(timerFd >= 0) close(timerFd);
+       wakeFd = timerFd = -1;
+    }
+#endif
+}
+
+TasksController::~TasksController()
+{
+    if(scheduler.joinable()) //before the descriptors and the members its loop uses are gone
+    {
+       scheduler.request_stop();
+       scheduler.join();
+    }
+
+#ifdef __linux__
+    if(wakeFd >= 0) close(wakeFd);
+    if(timerFd >= 0) close(timerFd);
+    if(readyFd.load() >= 0) close(readyFd.load());
+#endif
+}
+
+unsigned TasksController::threads() const
+{
+    return (executor) ? executor->size() : 0;
+}
+
+bool TasksController::clearTasks()
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    for(std::uint32_t i = 0; i < slots.size(); i++){ if(slots[i].active) release(i); }
+
+    names.clear();
+    calendar.clear();
+    intervals.clear();
+    stale = 0;
+
+    if(journal) journal->append(Cleared, {});
+
+    resumeCancelled(lock);
+
+    return true;
+}
+
+int TasksController::countTasks()
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    return names.size();
+}
+
+unsigned short TasksController::accuracy() const
+{
+    return _accuracy.load();
+}
+
+bool TasksController::setAccuracy(unsigned short ms)
+{
+    if(ms < 10) _accuracy = 10;
+    else if(ms > 500) _accuracy = 500;
+    else _accuracy = ms;
+
+    return true;
+}
+
+bool TasksController::isPrecise() const
+{
+    return precise.load();
+}
+
+bool TasksController::setPrecise(bool enabled)
+{
+    precise = enabled;
+    if(isrun.load()) wake(); //run() sleeps with the wake-up delay of the other mode
+
+    return true;
+}
+
+std::string TasksController::timeZone()
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    return zone.name();
+}
+
+bool TasksController::setTimeZone(std::string_view name)
+{
+    TimeZone loaded(name); //the zone file is read without the mutex
+    if(!loaded.isValid()) return false;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    zone = std::move(loaded);
+    period = {};
+
+    recalculate(localNow(), steadyNow(), ZoneChange);
+    wake();
+
+    return true;
+}
+
+bool TasksController::setClock(std::shared_ptr<TaskClock> clock)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    if(!names.empty() || !wheel.empty()) return false;
+
+    this->clock = std::move(clock);
+    period = {};
+    offset = nanoseconds(0); //jumped() measures the new clock from the next tick
+
+    return true;
+}
+
+std::size_t TasksController::advanceClock(nanoseconds step)
+{
+    ManualClock * manual = dynamic_cast<ManualClock*>(clock.get());
+    if(!manual || step.count() < 0) return 0;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    if(isrun.load()) return 0;
+
+    const TimingWheel::Clock::time_point end = manual->steady() + duration_cast<TimingWheel::Clock::duration>(step);
+    std::size_t fired = 0;
+    Batch batch;
+
+    while(true)
+    {
+        if(lease && manual->steady() >= renewal){ renew(lock); if(isrun.load()) break; }
+
+        const auto start = (measured.load(std::memory_order_relaxed)) ? TimingWheel::Clock::now() : TimingWheel::Clock::time_point();
+
+        drain();
+
+        const Now now = localNow();
+        const TimingWheel::Clock::time_point steady = manual->steady();
+
+        collect(now, steady, batch);
+
+        if(start != TimingWheel::Clock::time_point()) measureTick(start, batch);
+
+        if(!batch.empty())
+        {
+           fired += batch.expired.size() + batch.due.size();
+           dispatch(batch, lock, false);
+           continue; //the callbacks may have added tasks or timers
+        }
+
+        if(steady >= end) break;
+
+        //a deadline fires once the clock is past it
+        const auto wait = nextWait(now, steady);
+        manual->advance((wait >= end - steady) ? end - steady : std::max(wait, TimingWheel::Clock::duration(0)) + nanoseconds(1));
+    }
+
+    return fired;
 }
 
 bool TasksController::contains(const std::string & name)
 {
     if(name.empty()) return false;
-    std::lock_guard<std::mutex>lock(mutex);
-    return tasks.contains(name);
+    std::unique_lock<std::mutex>lock(acquire());
+    return names.contains(name);
+}
+
+bool TasksController::contains(TaskHandle handle)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    return slotOf(handle) != nullptr;
+}
+
+TaskHandle TasksController::find(const std::string & name)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    auto it = names.find(name);
+    if(it == names.end()) return {};
+
+    return TaskHandle(it->second, slots[it->second].generation);
+}
+
+TasksController::Slot * TasksController::slotOf(TaskHandle handle)
+{
+    if(!handle.isValid() || handle.index >= slots.size()) return nullptr;
+
+    Slot & slot = slots[handle.index];
+    if(!slot.active || slot.generation != handle.generation) return nullptr;
+
+    return &slot;
+}
+
+TasksController::Slot * TasksController::slotOf(const std::string & name)
+{
+    auto it = names.find(name);
+    if(it == names.end()) return nullptr;
+    return &slots[it->second];
+}
+
+TaskHandle TasksController::insert(std::string && name, const Task & task, CallbackList && callbacks, bool calculate)
+{
+    std::uint32_t index = (freeSlots.empty()) ? static_cast<std::uint32_t>(slots.size()) : freeSlots.back();
+
+    auto [it, added] = names.try_emplace(std::move(name), index); //the name is not moved from if it is in use
+    if(!added) return {};
+
+    if(index == slots.size()) slots.emplace_back();
+    else freeSlots.pop_back();
+
+    Slot & slot = slots[index];
+    slot.task = task;
+    slot.callbacks = std::move(callbacks);
+    slot.name = &it->first; //the nodes of the index do not move on a rehash
+    slot.active = true;
+    slot.paused = false;
+    if(perTask) slot.stats = stats.add(*slot.name);
+    if(splayWindow.count() > 0) slot.splay = splayOf(*slot.name, splayWindow);
+
+    if(calculate && (slot.task.isCalendar() || clock)) slot.task.taskCalculate(localNow(), steadyNow(), true); //parsed in the zone and on the clock of the system
+
+    schedule(index);
+    if(journal) record(Added, index);
+
+    return TaskHandle(index, slot.generation);
+}
+
+void TasksController::erase(std::uint32_t index)
+{
+    Slot & slot = slots[index];
+
+    if(!slot.paused) invalidate(index);
+    if(journal) record(Removed, index);
+    release(index);
+}
+
+void TasksController::release(std::uint32_t index)
+{
+    Slot & slot = slots[index];
+
+    slot.active = false;
+    slot.paused = false;
+    slot.callbacks.reset();
+    if(slot.stats) stats.remove(*slot.name);
+    slot.stats.reset();
+    slot.runs.reset();
+    slot.priority = Normal;
+    slot.splay = nanoseconds(0);
+    slot.splayed = false;
+    names.erase(names.find(*slot.name)); //by the iterator, the key is the name itself
+    slot.name = nullptr;
+    if(++slot.generation == 0) slot.generation = 1;
+
+    while(slot.waiters)
+    {
+        TaskAwaiter * waiter = slot.waiters;
+        slot.waiters = waiter->next;
+        waiter->next = cancelled;
+        cancelled = waiter;
+    }
+
+    freeSlots.push_back(index);
+}
+
+void TasksController::apply(Command & command)
+{
+    if(command.kind == Command::AddTask)
+    {
+       command.handle.set_value(insert(std::move(command.name), command.task, share(std::move(command.callbacks))));
+       return;
+    }
+
+    bool result = false;
+    auto it = names.find(command.name);
+
+    if(it != names.end())
+    {
+       Slot & slot = slots[it->second];
+       result = true;
+
+       switch(command.kind)
+       {
+          case Command::AddCallbacks:
+
+               slot.callbacks = share(std::move(command.callbacks), slot.callbacks);
+               break;
+
+          case Command::ClearCallbacks:
+
+               slot.callbacks.reset();
+               break;
+
+          case Command::RemoveTask:
+
+               erase(it->second);
+               break;
+
+          default: break;
+       }
+    }
+
+    command.result.set_value(result);
+}
+
+void TasksController::drain()
+{
+    Command command;
+    while(commands.pop(command)) apply(command);
+}
+
+std::future<bool> TasksController::post(Command && command)
+{
+    std::future<bool> result = command.result.get_future();
+
+    commands.push(std::move(command));
+
+    if(isrun.load()) wake(); //run() drains before it sleeps again, or on exit
+    else
+    {
+       std::unique_lock<std::mutex>lock(acquire());
+       drain();
+       resumeCancelled(lock);
+    }
+
+    return result;
+}
+
+static std::future<bool> rejected()
+{
+    std::promise<bool> result;
+    result.set_value(false);
+    return result.get_future();
+}
+
+std::future<TaskHandle> TasksController::addTaskAsync(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks)
+{
+    if(name.empty() || value.empty())
+    {
+       std::promise<TaskHandle> result;
+       result.set_value({});
+       return result.get_future();
+    }
+
+    return addTaskAsync(name, Task(value), callbacks);
+}
+
+std::future<TaskHandle> TasksController::addTaskAsync(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks)
+{
+    Command command;
+    std::future<TaskHandle> result = command.handle.get_future();
+
+    bool valid = !name.empty() && task.isValid();
+    for(auto & callback : callbacks){ if(!callback) valid = false; }
+
+    if(!valid)
+    {
+       command.handle.set_value({});
+       return result;
+    }
+
+    command.kind = Command::AddTask;
+    command.name = name;
+    command.task = task;
+    command.callbacks.assign(callbacks.begin(), callbacks.end());
+
+    post(std::move(command));
+
+    return result;
+}
+
+std::future<bool> TasksController::addCallbacksAsync(const std::string & name, const std::vector<std::function<void()>> & callbacks)
+{
+    if(name.empty() || callbacks.empty()) return rejected();
+    for(auto & callback : callbacks){ if(!callback) return rejected(); }
+
+    Command command;
+    command.kind = Command::AddCallbacks;
+    command.name = name;
+    command.callbacks.assign(callbacks.begin(), callbacks.end());
+
+    return post(std::move(command));
+}
+
+std::future<bool> TasksController::clearCallbacksAsync(const std::string & name)
+{
+    if(name.empty()) return rejected();
+
+    Command command;
+    command.kind = Command::ClearCallbacks;
+    command.name = name;
+
+    return post(std::move(command));
+}
+
+std::future<bool> TasksController::removeTaskAsync(const std::string & name)
+{
+    if(name.empty()) return rejected();
+
+    Command command;
+    command.kind = Command::RemoveTask;
+    command.name = name;
+
+    return post(std::move(command));
+}
+
+TaskHandle TasksController::addTask(const std::string & name, std::string_view value)
+{
+    if(name.empty() || value.empty()) return {};
+    return addTask(name, Task(value));
+}
+
+TaskHandle TasksController::addTask(const std::string & name, std::string_view value, const std::function<void()> & callback)
+{
+    if(name.empty() || value.empty() || !callback) return {};
+    return addTask(name, Task(value), callback);
+}
+
+TaskHandle TasksController::addTask(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks)
+{
+    if(name.empty() || value.empty() || callbacks.empty()) return {};
+    return addTask(name, Task(value), callbacks);
+}
+
+TaskHandle TasksController::addTask(const std::string & name, const Task & task)
+{
+    if(name.empty() || !task.isValid()) return {};
+
+    std::unique_lock<std::mutex>lock(acquire());
+    return insert(std::string(name), task, {});
+}
+
+TaskHandle TasksController::addTask(const std::string & name, const Task & task, const std::function<void()> & callback)
+{
+    if(!callback) return {};
+    return emplaceTask(std::string(name), task, callback);
+}
+
+TaskHandle TasksController::addTask(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks)
+{
+    if(name.empty() || !task.isValid() || callbacks.empty()) return {};
+    for(auto & callback : callbacks){ if(!callback) return {}; }
+
+    CallbackList list = share(Callbacks(callbacks.begin(), callbacks.end())); //built without the mutex
+
+    std::unique_lock<std::mutex>lock(acquire());
+    return insert(std::string(name), task, std::move(list));
+}
+
+std::size_t TasksController::loadTasks(std::string_view lines, std::vector<TaskLoadError> * errors, unsigned threads)
+{
+    struct Line
+    {
+        std::size_t number;
+        std::string_view name;
+        std::string_view value;
+        Task task;
+    };
+
+    std::vector<Line> parsed;
+
+    {
+      std::size_t number = 0;
+
+      while(!lines.empty())
+      {
+          std::size_t end = lines.find('\n');
+          std::string_view line = lines.substr(0, end);
+          lines.remove_prefix((end == std::string_view::npos) ? lines.size() : end + 1);
+          number++;
+
+          if(line.ends_with('\r')) line.remove_suffix(1);
+          if(line.empty() || line.front() == '#') continue;
+
+          std::size_t tab = line.find('\t');
+
+          if(tab == 0 || tab == std::string_view::npos || tab + 1 == line.size())
+          {
+             if(errors) errors->push_back({number, TaskLoadError::Format});
+             continue;
+          }
+
+          parsed.push_back({number, line.substr(0, tab), line.substr(tab + 1), Task()});
+      }
+    }
+
+    //----------------
+
+    if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<std::size_t>(threads, parsed.size() / 4096 + 1));
+
+    auto parse = [&parsed](std::size_t begin, std::size_t end){ for(; begin < end; begin++) parsed[begin].task.parseFromString(parsed[begin].value); };
+
+    if(threads > 1)
+    {
+       std::vector<std::thread> workers;
+       std::size_t chunk = (parsed.size() + threads - 1) / threads;
+
+       for(std::size_t begin = 0; begin < parsed.size(); begin += chunk) workers.emplace_back(parse, begin, std::min(begin + chunk, parsed.size()));
+       for(auto & worker : workers) worker.join();
+    }
+    else parse(0, parsed.size());
+
+    //----------------
+
+    std::size_t added = 0;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    names.reserve(names.size() + parsed.size());
+    slots.reserve(slots.size() + parsed.size());
+    intervals.reserve(intervals.size() + parsed.size()); //the usual bulk schedule
+
+    for(auto & line : parsed)
+    {
+        if(!line.task.isValid())
+        {
+           if(errors) errors->push_back({line.number, TaskLoadError::Schedule});
+           continue;
+        }
+
+        if(!insert(std::string(line.name), line.task, {}))
+        {
+           if(errors) errors->push_back({line.number, TaskLoadError::Duplicate});
+           continue;
+        }
+
+        added++;
+    }
+
+    if(errors) std::sort(errors->begin(), errors->end(), [](const TaskLoadError & a, const TaskLoadError & b){ return a.line < b.line; });
+
+    return added;
+}
+
+std::size_t TasksController::loadTasksFromFile(const std::string & path, std::vector<TaskLoadError> * errors, unsigned threads)
+{
+    std::size_t added = 0;
+
+    if(!mapFile(path, [&](std::string_view content){ added = loadTasks(content, errors, threads); }))
+    {
+       if(errors) errors->push_back({0, TaskLoadError::File});
+    }
+
+    return added;
+}
+
+bool TasksController::remove(TaskHandle handle)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    if(!slotOf(handle)) return false;
+    erase(handle.index);
+
+    resumeCancelled(lock);
+
+    return true;
+}
+
+bool TasksController::remove(const std::string & name)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    auto it = names.find(name);
+    if(it == names.end()) return false;
+
+    erase(it->second);
+
+    resumeCancelled(lock);
+
+    return true;
+}
+
+bool TasksController::pause(TaskHandle handle)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(handle);
+    if(!slot || slot->paused) return false;
+
+    invalidate(handle.index);
+    slot->paused = true;
+    if(journal) record(Paused, handle.index);
+
+    return true;
+}
+
+bool TasksController::resume(TaskHandle handle)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(handle);
+    if(!slot || !slot->paused) return false;
+
+    slot->paused = false;
+    slot->task.taskCalculate(localNow(), steadyNow(), true); //the fires missed while paused are skipped
+    schedule(handle.index);
+    if(journal) record(Resumed, handle.index);
+
+    return true;
+}
+
+bool TasksController::isPaused(TaskHandle handle)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(handle);
+    return slot && slot->paused;
+}
+
+TimingWheel::Timer TasksController::addAfter(milliseconds delay, const std::function<void()> & callback)
+{
+    if(delay.count() < 0 || !callback) return 0;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    auto next = wheel.nextExpiry();
+    TimingWheel::Timer timer = wheel.add(steadyNow(), delay, callback);
+    if(wheel.nextExpiry() < next) wake();
+
+    return timer;
+}
+
+bool TasksController::cancel(TimingWheel::Timer timer)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    return wheel.cancel(timer);
+}
+
+int TasksController::countTimers()
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    return wheel.size();
+}
+
+void TasksController::clearTimers()
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    wheel.clear();
+}
+
+TaskAwaiter TasksController::nextFire(TaskHandle handle)
+{
+    return TaskAwaiter(this, handle);
+}
+
+TaskAwaiter TasksController::nextFire(const std::string & name)
+{
+    return TaskAwaiter(this, find(name));
+}
+
+std::vector<Now> TasksController::nextOccurrences(TaskHandle handle, std::size_t n)
+{
+    std::vector<Now> fires;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(handle);
+    if(!slot || slot->paused) return fires;
+
+    TaskOccurrences occurrences(slot->task, localNow(), steadyNow());
+
+    const auto splay = duration_cast<system_clock::duration>(slot->splay);
+
+    Now fire;
+    while(fires.size() < n && occurrences.next(fire)) fires.push_back(fire + splay);
+
+    return fires;
+}
+
+std::vector<Now> TasksController::nextOccurrences(const std::string & name, std::size_t n)
+{
+    return nextOccurrences(find(name), n);
+}
+
+std::vector<TasksController::Occurrence> TasksController::firesInWindow(const Now & from, const Now & to, std::size_t limit)
+{
+    std::vector<Occurrence> fires;
+    if(to <= from || limit == 0) return fires;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    const Now now = localNow();
+    const TimingWheel::Clock::time_point steady = steadyNow();
+    const nanoseconds shift = duration_cast<nanoseconds>(now.time_since_epoch() - steady.time_since_epoch());
+
+    //A heap entry is not later than its children, a subtree whose root is at or after to has no fire in the window
+    std::vector<std::uint32_t> due;
+    std::vector<std::size_t> stack;
+
+    auto before = [&](const std::vector<Deadline> & heap, nanoseconds end)
+    {
+        if(!heap.empty()) stack.push_back(0);
+
+        while(!stack.empty())
+        {
+            const std::size_t i = stack.back();
+            stack.pop_back();
+
+            if(heap[i].time >= end) continue;
+            if(slots[heap[i].index].sequence == heap[i].sequence) due.push_back(heap[i].index);
+
+            if(2 * i + 1 < heap.size()) stack.push_back(2 * i + 1);
+            if(2 * i + 2 < heap.size()) stack.push_back(2 * i + 2);
+        }
+    };
+
+    before(calendar, duration_cast<nanoseconds>(to.time_since_epoch()));
+    before(intervals, duration_cast<nanoseconds>(to.time_since_epoch()) - shift);
+
+    //k-way merge of the occurrences of the found tasks, each one calculation ahead
+    struct Cursor
+    {
+        Now fire;
+        std::uint32_t index;
+        TaskOccurrences occurrences;
+    };
+
+    std::vector<Cursor> cursors;
+    cursors.reserve(due.size());
+
+    for(std::uint32_t index : due)
+    {
+        const auto splay = duration_cast<system_clock::duration>(slots[index].splay);
+
+        TaskOccurrences occurrences(slots[index].task, now, steady);
+        occurrences.skipTo(from - splay);
+
+        Now fire;
+        if(occurrences.next(fire) && fire + splay < to) cursors.push_back({fire + splay, index, occurrences});
+    }
+
+    auto later = [](const Cursor & a, const Cursor & b){ return a.fire > b.fire; };
+    std::make_heap(cursors.begin(), cursors.end(), later);
+
+    while(!cursors.empty() && fires.size() < limit)
+    {
+        std::pop_heap(cursors.begin(), cursors.end(), later);
+        Cursor & cursor = cursors.back();
+        const Slot & slot = slots[cursor.index];
+
+        fires.push_back({*slot.name, TaskHandle(cursor.index, slot.generation), cursor.fire});
+
+        const auto splay = duration_cast<system_clock::duration>(slot.splay);
+
+        if(cursor.occurrences.next(cursor.fire) && (cursor.fire += splay) < to) std::push_heap(cursors.begin(), cursors.end(), later);
+        else cursors.pop_back();
+    }
+
+    return fires;
+}
+
+std::vector<std::size_t> TasksController::fireDensity(const Now & from, const Now & to)
+{
+    std::vector<std::size_t> density;
+    if(to <= from) return density;
+
+    density.resize(static_cast<std::size_t>(ceil<::seconds>(to - from).count()));
+    for(const Occurrence & fire : firesInWindow(from, to, std::numeric_limits<std::size_t>::max())) density[floor<::seconds>(fire.time - from).count()]++;
+
+    return density;
+}
+
+bool TasksController::addCallback(const std::string & name, const std::function<void()> & callback)
+{
+    if(!callback) return false;
+    return appendCallbacks(name, Callbacks{callback});
+}
+
+bool TasksController::addCallbacks(const std::string & name, const std::vector<std::function<void()>> & callbacks)
+{
+    return appendCallbacks(name, Callbacks(callbacks.begin(), callbacks.end()));
+}
+
+bool TasksController::appendCallbacks(const std::string & name, Callbacks && callbacks)
+{
+    if(name.empty() || callbacks.empty() || !isValid(callbacks)) return false;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(name);
+    if(!slot) return false;
+
+    slot->callbacks = share(std::move(callbacks), slot->callbacks);
+
+    return true;
+}
+
+TasksController::CallbackList TasksController::share(Callbacks && callbacks, const CallbackList & before)
+{
+    std::size_t kept = 0;
+    if(before){ while(before[kept]) kept++; }
+
+    if(kept + callbacks.size() == 0) return {};
+
+    auto list = std::make_shared<Callback[]>(kept + callbacks.size() + 1); //the control block and the array in one allocation
+
+    for(std::size_t i = 0; i < kept; i++) list[i] = before[i];
+    for(std::size_t i = 0; i < callbacks.size(); i++) list[kept + i] = std::move(callbacks[i]);
+
+    return list;
+}
+
+bool TasksController::isValid(const Callbacks & callbacks)
+{
+    for(auto & callback : callbacks){ if(!callback) return false; }
+    return true;
+}
+
+void TasksController::clearCallbacks(const std::string & name)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(name);
+    if(!slot) return;
+
+    slot->callbacks.reset();
+}
+
+bool TasksController::isRun() const
+{
+    return isrun.load();
+}
+
+bool TasksController::later(const Deadline & a, const Deadline & b)
+{
+    return a.time > b.time;
+}
+
+void TasksController::schedule(std::uint32_t index, bool notify)
+{
+    const Slot & slot = slots[index];
+
+    std::vector<Deadline> & heap = (slot.task.isCalendar()) ? calendar : intervals;
+    const auto time = (slot.task.isCalendar()) ? slot.task.nextFire().time_since_epoch() : slot.task.nextSteadyFire().time_since_epoch();
+
+    heap.push_back({duration_cast<nanoseconds>(time) + slot.splay, index, slot.sequence});
+    std::push_heap(heap.begin(), heap.end(), later);
+
+    if(notify && heap.front().index == index) wake();
+}
+
+void TasksController::invalidate(std::uint32_t index)
+{
+    slots[index].sequence++;
+    slots[index].overdue = false;
+    stale++;
+
+    if(stale > 1024 && stale > (calendar.size() + intervals.size()) / 2) //drop the stale entries, amortized O(1)
+    {
+       for(auto heap : {&calendar, &intervals})
+       {
+           std::erase_if(*heap, [this](const Deadline & d){ return slots[d.index].sequence != d.sequence; });
+           std::make_heap(heap->begin(), heap->end(), later);
+       }
+
+       stale = 0;
+    }
+}
+
+bool TasksController::jumped(const Now & utc, TimingWheel::Clock::time_point steady)
+{
+    //Portable check for a clock change between two ticks, the timerfd also catches it while run() sleeps.
+    //The drift of NTP slewing stays far below the limit.
+    const nanoseconds current = duration_cast<nanoseconds>(utc.time_since_epoch() - steady.time_since_epoch());
+    const nanoseconds previous = std::exchange(offset, current);
+
+    return previous.count() != 0 && abs(current - previous) > ::seconds(1);
+}
+
+Now TasksController::localNow()
+{
+    const auto utc = utcNow();
+
+    if(utc >= period.end || utc < period.begin) //one comparison on the usual tick
+    {
+       const TimeZone::Period next = zone.period(utc);
+       if(period.end != Now() && next.offset != period.offset) transition = true; //not on the first lookup
+       period = next;
+    }
+
+    return utc + period.offset;
+}
+
+Now TasksController::utcNow() const
+{
+    return (clock) ? clock->utc() : TaskClock::current().utc();
+}
+
+TimingWheel::Clock::time_point TasksController::steadyNow() const
+{
+    return (clock) ? clock->steady() : TaskClock::current().steady();
+}
+
+void TasksController::recalculate(const Now & now, TimingWheel::Clock::time_point steady, Shift shift)
+{
+    //One pass rebuilds the calendar heap, the interval heap is on steady_clock and is not touched
+    for(const Deadline & deadline : calendar){ if(slots[deadline.index].sequence != deadline.sequence) stale--; }
+    calendar.clear();
+    transition = false;
+
+    for(std::uint32_t i = 0; i < slots.size(); i++)
+    {
+        Slot & slot = slots[i];
+        slot.overdue = false;
+        if(!slot.active || slot.paused || !slot.task.isCalendar()) continue;
+
+        //A fire the clock stepped over stays due and fires once, the others are calculated from now,
+        //so after a step back a fire of the repeated time is not lost. The deadlines are local times,
+        //after a transition only the hourly and minutely schedules follow the elapsed time,
+        //a daily one does not fire twice in a repeated hour.
+        //A splayed task is calculated on its own time, now - its offset.
+        //The fire after a stepped over one is calculated from the step too, not from the late fire,
+        //which would skip a whole period: an hourly :30 fire caught up at 07:05 is followed by 07:30.
+        const Now local = now - duration_cast<system_clock::duration>(slot.splay);
+        const auto due = duration_cast<nanoseconds>(slot.task.nextFire().time_since_epoch()) + slot.splay;
+
+        if(shift == ZoneChange) slot.task.taskCalculate(local, steady, true);
+        else if(slot.task.nextFire() > local && (shift == ClockStep || slot.task.isSubDaily())) slot.task.taskCalculate(local, steady, true);
+        else if(shift == ClockStep && !slot.task.isSingle()){ slot.task.taskCalculate(local, steady, true); slot.overdue = true; }
+
+        calendar.push_back({(slot.overdue) ? due : duration_cast<nanoseconds>(slot.task.nextFire().time_since_epoch()) + slot.splay, i, slot.sequence});
+    }
+
+    std::make_heap(calendar.begin(), calendar.end(), later);
+}
+
+void TasksController::wake()
+{
+    if(signaled.exchange(true)) return;
+
+#ifdef __linux__
+    if(readyFd.load() >= 0)
+    {
+       armTimer(readyFd.load(), TimingWheel::Clock::time_point::min()); //readable at once, processDue() looks at the changes
+       if(!isrun.load()) return;
+    }
+
+    if(wakeFd >= 0)
+    {
+       eventfd_write(wakeFd, 1);
+       return;
+    }
+#endif
+
+    signal.release();
+}
+
+void TasksController::run()
+{
+    std::unique_lock<std::mutex>lock(mutex);
+
+    drain();
+
+    if(names.size() == 0 && wheel.empty()) return;
+
+    stopping.store(std::make_shared<std::stop_source>()); //a stop() from now on is kept
+    isrun = true;
+
+    loop(lock);
+
+    if(!lock.owns_lock()) lock.lock();
+    drain(); //commands posted while stopping
+}
+
+void TasksController::run(std::stop_token token)
+{
+    {
+      std::unique_lock<std::mutex>lock(mutex);
+
+      stopping.store(std::make_shared<std::stop_source>());
+      isrun = true;
+    }
+
+    serve(token);
+}
+
+void TasksController::serve(std::stop_token token)
+{
+    std::stop_callback callback(token, [this]{ stop(); }); //runs at once if the stop was requested before
+
+    std::unique_lock<std::mutex>lock(mutex);
+
+    drain();
+
+    if(isrun.load()) loop(lock); //false - stopped before the loop started
+
+    if(!lock.owns_lock()) lock.lock();
+    drain();
+}
+
+bool TasksController::Batch::empty() const
+{
+    return expired.empty() && due.empty() && waiters.empty();
+}
+
+void TasksController::Batch::clear()
+{
+    expired.clear();
+    due.clear();
+    waiters.clear();
+    fires = 0;
+}
+
+void TasksController::collect(const Now & now, TimingWheel::Clock::time_point steady, Batch & batch)
+{
+    batch.fires = 0; //a tick that fired only tasks without callbacks is not dispatched and cleared
+    wheel.advance(steady, batch.expired);
+
+    if(cancelled) batch.waiters.push_back(std::exchange(cancelled, nullptr)); //removed by commands drained in this tick
+
+    //jumped() runs on every tick, it also keeps the offset of the last tick
+    if(jumped(now - period.offset, steady) | clockChanged.exchange(false))
+    {
+       recalculate(now, steady, ClockStep);
+       if(measured.load(std::memory_order_relaxed)) stats.clockSteps.fetch_add(1, std::memory_order_relaxed);
+    }
+    else if(transition) recalculate(now, steady, Transition);
+
+
+    const std::shared_ptr<const Ownership> owner = (lease) ? ownership.load() : nullptr;
+
+    auto pop = [&](std::vector<Deadline> & heap, nanoseconds current)
+    {
+        while(!heap.empty() && heap.front().time < current)
+        {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Deadline deadline = heap.back();
+            heap.pop_back();
+
+            Slot & slot = slots[deadline.index];
+
+            if(slot.sequence != deadline.sequence) //removed or paused
+            {
+               stale--;
+               continue;
+            }
+
+            if(!std::exchange(slot.overdue, false) && !slot.task.taskCalculate(now - duration_cast<system_clock::duration>(slot.splay), steady - duration_cast<TimingWheel::Clock::duration>(slot.splay), false))
+            {
+               schedule(deadline.index, false);
+               continue;
+            }
+
+            if(owner && !owner->owns(*slot.name)) //fired by another replica, only the schedule moves on
+            {
+               if(measured.load(std::memory_order_relaxed)) stats.unowned.fetch_add(1, std::memory_order_relaxed);
+               if(journal) record(Fired, deadline.index);
+
+               if(slot.task.isSingle()) release(deadline.index);
+               else schedule(deadline.index, false);
+               continue;
+            }
+
+            batch.fires++;
+            if(slot.stats) slot.stats->fires.fetch_add(1, std::memory_order_relaxed);
+            if(slot.callbacks) batch.due.push_back({slot.callbacks, steady - duration_cast<TimingWheel::Clock::duration>(current - deadline.time), slot.stats, slot.runs, slot.priority});
+            if(journal) record(Fired, deadline.index);
+
+            if(slot.waiters) //reversed to the order of co_await
+            {
+               TaskAwaiter * waiters = nullptr;
+
+               while(slot.waiters)
+               {
+                   TaskAwaiter * waiter = slot.waiters;
+                   slot.waiters = waiter->next;
+                   waiter->fired = true;
+                   waiter->next = waiters;
+                   waiters = waiter;
+               }
+
+               batch.waiters.push_back(waiters);
+            }
+
+            if(slot.task.isSingle())
+            {
+               release(deadline.index);
+            }
+            else schedule(deadline.index, false);
+        }
+    };
+
+    pop(calendar, duration_cast<nanoseconds>(now.time_since_epoch()));
+    pop(intervals, duration_cast<nanoseconds>(steady.time_since_epoch()));
+}
+
+TimingWheel::Clock::duration TasksController::nextWait(const Now & now, TimingWheel::Clock::time_point steady) const
+{
+    auto wait = TimingWheel::Clock::duration::max();
+    if(!calendar.empty()) wait = duration_cast<TimingWheel::Clock::duration>(calendar.front().time - now.time_since_epoch());
+    if(!intervals.empty()) wait = std::min(wait, duration_cast<TimingWheel::Clock::duration>(intervals.front().time - steady.time_since_epoch()));
+    if(!wheel.empty()) wait = std::min(wait, wheel.nextExpiry() - steady);
+    if(lease) wait = std::min(wait, renewal - steady);
+    if(period.end != Now::max()) wait = std::min(wait, duration_cast<TimingWheel::Clock::duration>(period.end - (now - period.offset))); //the local deadlines move
+
+    return wait;
+}
+
+bool TasksController::dispatch(Batch & batch, std::unique_lock<std::mutex> & lock, bool stoppable)
+{
+    const bool measuring = measured.load(std::memory_order_relaxed);
+    const std::size_t cap = maxInFlight.load(std::memory_order_relaxed);
+
+    //The calendar deadlines are popped before the interval ones, the sort also puts them into one deadline order
+    if(!std::is_sorted(batch.due.begin(), batch.due.end(), earlier)) std::stable_sort(batch.due.begin(), batch.due.end(), earlier);
+
+    if(executor)
+    {
+       for(auto & func : batch.expired) executor->post(std::move(func));
+       for(auto & due : batch.due) submit((workers[due.priority]) ? *workers[due.priority] : *executor, due, measuring, cap, stoppable);
+       for(auto waiters : batch.waiters) executor->post([waiters]{ resume(waiters); });
+
+       batch.clear();
+       return true;
+    }
+
+    for(auto & due : batch.due) //the lanes with their own workers, the rest runs here
+    {
+        if(workers[due.priority])
+        {
+           submit(*workers[due.priority], due, measuring, cap, stoppable);
+           due.callbacks.reset();
+        }
+    }
+
+    lock.unlock();
+
+    auto call = [&]
+    {
+        for(auto & func : batch.expired)
+        {
+            func();
+            if(stoppable && !isrun.load()) return false;
+        }
+
+        for(auto & due : batch.due)
+        {
+            if(!due.callbacks) continue; //posted to its lane
+
+            const auto start = (measuring) ? TimingWheel::Clock::now() : TimingWheel::Clock::time_point();
+
+            for(const Callback * func = due.callbacks.get(); *func; func++)
+            {
+                (*func)();
+                if(stoppable && !isrun.load()) return false;
+            }
+
+            if(measuring) measure(due, start);
+        }
+
+        return true;
+    };
+
+    bool running = call();
+
+    for(auto waiters : batch.waiters) resume(waiters); //even after stop(), a coroutine left suspended would never finish
+
+    batch.clear();
+
+    if(!running) return false;
+
+    lock.lock();
+    return true;
+}
+
+bool TasksController::earlier(const Due & a, const Due & b)
+{
+    return (a.priority != b.priority) ? a.priority < b.priority : a.deadline < b.deadline;
+}
+
+void TasksController::submit(TaskExecutor & pool, Due & due, bool measuring, std::size_t cap, bool stoppable)
+{
+    if(cap > 0 && inFlight.load(std::memory_order_relaxed) >= cap)
+    {
+       if(measuring) stats.shed.fetch_add(1, std::memory_order_relaxed);
+       return;
+    }
+
+    if(due.runs)
+    {
+       const Runs::Admit admit = due.runs->admit();
+
+       if(admit == Runs::Rejected && measuring) stats.skipped.fetch_add(1, std::memory_order_relaxed);
+       if(admit != Runs::Start) return;
+    }
+
+    if(!measuring && cap == 0 && !due.runs)
+    {
+       if(!stoppable) pool.post([callbacks = std::move(due.callbacks)]{ for(const Callback * func = callbacks.get(); *func; func++) (*func)(); });
+       else pool.post([this, callbacks = std::move(due.callbacks)]{ for(const Callback * func = callbacks.get(); *func && isrun.load(std::memory_order_relaxed); func++) (*func)(); });
+       return;
+    }
+
+    if(cap > 0) inFlight.fetch_add(1, std::memory_order_relaxed);
+
+    pool.post([this, due = std::move(due), measuring, counted = cap > 0, stoppable]
+    {
+        bool first = true;
+
+        do //the runs left pending by Coalesce and Queue follow in the same job, after a stop they are dropped
+        {
+            const auto start = (measuring) ? TimingWheel::Clock::now() : TimingWheel::Clock::time_point();
+            for(const Callback * func = due.callbacks.get(); *func && (!stoppable || isrun.load(std::memory_order_relaxed)); func++) (*func)();
+            if(measuring) measure(due, start, std::exchange(first, false));
+        }
+        while(due.runs && due.runs->again());
+
+        if(counted) inFlight.fetch_sub(1, std::memory_order_relaxed);
+    });
+}
+
+bool TasksController::suspend(TaskAwaiter * awaiter)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(awaiter->handle);
+    if(!slot) return false; //not suspended, co_await returns false at once
+
+    awaiter->next = slot->waiters;
+    slot->waiters = awaiter;
+
+    return true;
+}
+
+void TasksController::resumeCancelled(std::unique_lock<std::mutex> & lock)
+{
+    TaskAwaiter * waiters = std::exchange(cancelled, nullptr);
+    lock.unlock();
+
+    resume(waiters);
+}
+
+void TasksController::resume(TaskAwaiter * waiters)
+{
+    while(waiters)
+    {
+        TaskAwaiter * next = waiters->next; //the awaiter is gone once its coroutine runs on
+        waiters->coroutine.resume();
+        waiters = next;
+    }
+}
+
+void TasksController::loop(std::unique_lock<std::mutex> & lock)
+{
+    Batch batch;
+
+    signaled = false; //left set by a wake() for processDue() before the loop, the wake() calls during the first sleep signal it
+
+    while(isrun.load())
+    {
+       if(lease && steadyNow() >= renewal) renew(lock); //before the tick, it releases the mutex
+
+       const auto start = (measured.load(std::memory_order_relaxed)) ? TimingWheel::Clock::now() : TimingWheel::Clock::time_point();
+
+       drain();
+
+       Now now = localNow();
+       TimingWheel::Clock::time_point steady = steadyNow();
+
+       collect(now, steady, batch);
+
+       if(start != TimingWheel::Clock::time_point()) measureTick(start, batch);
+
+       if(!batch.empty()) //the scheduler only decides what is due, callbacks run without the lock
+       {
+          if(!dispatch(batch, lock, true)) return;
+          continue; //callbacks took time, look at the clocks again
+       }
+
+       const auto wait = nextWait(now, steady);
+       const auto delay = milliseconds(precise.load() ? 0 : _accuracy.load());
+
+       auto until = (wait == TimingWheel::Clock::duration::max()) ? TimingWheel::Clock::time_point::max() : steady + wait + delay;
+       if(wakeFd < 0 && !calendar.empty()) until = std::min(until, steady + ::seconds(1)); //without the timerfd a change of the wall clock is seen on the next tick
+
+       lock.unlock();
+
+       sleepUntil(until);
+
+       lock.lock();
+       signaled = false; //set again by wake() calls after this point, drain() runs after it
+    }
+}
+
+void TasksController::sleepUntil(TimingWheel::Clock::time_point deadline)
+{
+#ifdef __linux__
+    //The timed waits of std::counting_semaphore back off with sleep_for and may overshoot by milliseconds,
+    //so the wait is a poll on the wake eventfd and a timerfd armed with the absolute deadline
+    if(wakeFd >= 0)
+    {
+       armTimer(timerFd, deadline);
+
+       pollfd fds[2] = {{wakeFd, POLLIN, 0}, {timerFd, POLLIN, 0}};
+       while(poll(fds, 2, -1) < 0 && errno == EINTR);
+
+       eventfd_t value;
+       if(fds[0].revents & POLLIN) eventfd_read(wakeFd, &value);
+       if((fds[1].revents & POLLIN) && !readTimer(timerFd)) clockChanged = true;
+       return;
+    }
+#endif
+
+    if(deadline == TimingWheel::Clock::time_point::max()) signal.acquire();
+    else signal.try_acquire_until(deadline);
+}
+
+int TasksController::fileDescriptor()
+{
+#ifdef __linux__
+    std::unique_lock<std::mutex>lock(acquire());
+
+    if(readyFd.load() < 0)
+    {
+       int fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+       if(fd < 0) return -1;
+
+       armTimer(fd, TimingWheel::Clock::time_point::min()); //the first processDue() arms the real deadline
+       readyFd = fd;
+    }
+
+    return readyFd.load();
+#else
+    return -1;
+#endif
+}
+
+std::size_t TasksController::processDue()
+{
+    Batch batch;
+
+    std::unique_lock<std::mutex>lock(mutex);
+
+    if(isrun.load()) return 0;
+
+#ifdef __linux__
+    const int fd = readyFd.load();
+
+    if(fd >= 0 && !readTimer(fd)) clockChanged = true; //clears the readability
+#endif
+
+    if(lease && steadyNow() >= renewal)
+    {
+       renew(lock);
+       if(isrun.load()) return 0; //started meanwhile
+    }
+
+    const auto start = (measured.load(std::memory_order_relaxed)) ? TimingWheel::Clock::now() : TimingWheel::Clock::time_point();
+
+    signaled = false; //later wake() calls arm the descriptor again
+    drain();
+
+    Now now = localNow();
+    TimingWheel::Clock::time_point steady = steadyNow();
+
+    collect(now, steady, batch);
+
+    if(start != TimingWheel::Clock::time_point()) measureTick(start, batch);
+
+#ifdef __linux__
+    if(fd >= 0) //armed before the callbacks run, a deadline that passes meanwhile leaves it readable
+    {
+       const auto wait = nextWait(now, steady);
+
+       if(wait == TimingWheel::Clock::duration::max()) armTimer(fd, TimingWheel::Clock::time_point::max());
+       else armTimer(fd, steady + wait + milliseconds(precise.load() ? 0 : _accuracy.load()));
+
+       if(signaled.load()) armTimer(fd, TimingWheel::Clock::time_point::min()); //a wake() raced with the arm above
+    }
+#endif
+
+    const std::size_t fired = batch.expired.size() + batch.due.size();
+
+    dispatch(batch, lock, false);
+
+    return fired;
+}
+
+//------------------overrun-------------------------
+
+TasksController::Runs::Admit TasksController::Runs::admit()
+{
+    std::uint32_t current = state.load(std::memory_order_relaxed);
+
+    while(true)
+    {
+        std::uint32_t next;
+        Admit result;
+
+        if(policy == Overlap || policy == Skip)
+        {
+           if(limit > 0 && current >= limit) return Rejected;
+           next = current + 1;
+           result = Start;
+        }
+        else if(current == 0)
+        {
+           next = 1;
+           result = Start;
+        }
+        else
+        {
+           if((policy == Coalesce) ? current >= 2 : (limit > 0 && current - 1 >= limit)) return Rejected;
+           next = current + 1;
+           result = Pending;
+        }
+
+        if(state.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_relaxed)) return result;
+    }
 }
 
-bool TasksController::addTask(const std::string & name, std::string_view value)
+bool TasksController::Runs::again()
 {
-    if(name.empty() || value.empty()) return false;
+    if(policy == Overlap || policy == Skip)
+    {
+       state.fetch_sub(1, std::memory_order_acq_rel);
+       return false;
+    }
 
-    Task task(value);
-    if(!task.isValid()) return false;
+    return state.fetch_sub(1, std::memory_order_acq_rel) > 1; //the run left 1 + waiting runs, one of them starts now
+}
 
-    std::pair<Task,std::vector<std::function<void()>>> pair;
-    pair.first = task;
+bool TasksController::applyOverrun(Slot & slot, Overrun policy, unsigned limit)
+{
+    if(policy > Queue) return false;
 
-    std::lock_guard<std::mutex>lock(mutex);
-    if(tasks.contains(name)) return false;
+    if(policy == Overlap && limit == 0)
+    {
+       slot.runs.reset();
+       return true;
+    }
 
-    tasks.insert({name, pair});
+    auto runs = std::make_shared<Runs>(); //a new block, the runs started under the old policy are not counted by it
+    runs->policy = policy;
+    runs->limit = (policy == Skip) ? 1 : limit;
+    slot.runs = std::move(runs);
 
     return true;
 }
 
-bool TasksController::addTask(const std::string & name, std::string_view value, const std::function<void()> & callback)
+bool TasksController::setOverrun(TaskHandle handle, Overrun policy, unsigned limit)
 {
-    if(name.empty() || value.empty() || !callback) return false;
+    std::unique_lock<std::mutex>lock(acquire());
 
-    Task task(value);
-    if(!task.isValid()) return false;
+    Slot * slot = slotOf(handle);
+    return slot && applyOverrun(*slot, policy, limit);
+}
 
-    std::pair<Task,std::vector<std::function<void()>>> pair;
-    pair.first = task;
-    pair.second.push_back(callback);
+bool TasksController::setOverrun(const std::string & name, Overrun policy, unsigned limit)
+{
+    std::unique_lock<std::mutex>lock(acquire());
 
-    std::lock_guard<std::mutex>lock(mutex);
-    if(tasks.contains(name)) return false;
+    Slot * slot = slotOf(name);
+    return slot && applyOverrun(*slot, policy, limit);
+}
 
-    tasks.insert({name, pair});
+bool TasksController::setPriority(TaskHandle handle, Priority priority)
+{
+    if(priority >= lanes) return false;
 
-    return true;
+    std::unique_lock<std::mutex>lock(acquire());
+
+    Slot * slot = slotOf(handle);
+    if(slot) slot->priority = priority;
+
+    return slot;
 }
 
-bool TasksController::addTask(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks)
+bool TasksController::setPriority(const std::string & name, Priority priority)
 {
-    if(name.empty() || value.empty() || callbacks.empty()) return false;
+    return setPriority(find(name), priority);
+}
 
-    Task task(value);
-    if(!task.isValid()) return false;
+bool TasksController::setLaneWorkers(Priority lane, unsigned threads)
+{
+    if(lane >= lanes) return false;
 
-    std::pair<Task,std::vector<std::function<void()>>> pair;
-    pair.first = task;
+    std::unique_ptr<TaskExecutor> pool = (threads > 0) ? std::make_unique<TaskExecutor>(threads) : nullptr;
 
-    for(auto & callback : callbacks)
     {
-        if(!callback) return false;
-        pair.second.push_back(callback);
+      std::unique_lock<std::mutex>lock(acquire());
+      workers[lane].swap(pool);
     }
 
-    std::lock_guard<std::mutex>lock(mutex);
-    if(tasks.contains(name)) return false;
+    return true; //the old workers are joined without the mutex, their jobs may call the controller
+}
+
+unsigned TasksController::laneWorkers(Priority lane)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    return (lane < lanes && workers[lane]) ? workers[lane]->size() : 0;
+}
 
-    tasks.insert({name, pair});
+static std::uint64_t hashOf(std::string_view name) //FNV-1a, stable across processes unlike std::hash
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for(unsigned char c : name) hash = (hash ^ c) * 1099511628211ull;
 
-    return true;
+    return hash;
 }
 
-bool TasksController::addTask(const std::string & name, const Task & task)
+static std::uint64_t mix(std::uint64_t value) //finalizer of splitmix64, spreads the hash of a short name over the ring
 {
-    if(name.empty() || !task.isValid()) return false;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
 
-    std::pair<Task,std::vector<std::function<void()>>> pair;
-    pair.first = task;
+nanoseconds TasksController::splayOf(const std::string & name, milliseconds window)
+{
+    if(window.count() <= 0) return nanoseconds(0);
+    return milliseconds(static_cast<milliseconds::rep>(hashOf(name) % static_cast<std::uint64_t>(window.count())));
+}
 
-    std::lock_guard<std::mutex>lock(mutex);
-    if(tasks.contains(name)) return false;
+void TasksController::resplay(std::uint32_t index, milliseconds window)
+{
+    Slot & slot = slots[index];
 
-    tasks.insert({name, pair});
+    const nanoseconds splay = splayOf(*slot.name, window);
+    if(splay == slot.splay) return;
+
+    slot.splay = splay;
+    if(slot.paused) return;
+
+    invalidate(index);
+    schedule(index);
+}
+
+bool TasksController::setSplay(milliseconds window)
+{
+    if(window.count() < 0) return false;
+
+    std::unique_lock<std::mutex>lock(acquire());
+
+    splayWindow = window;
+    for(std::uint32_t i = 0; i < slots.size(); i++){ if(slots[i].active && !slots[i].splayed) resplay(i, window); }
 
     return true;
 }
 
-bool TasksController::addTask(const std::string & name, const Task & task, const std::function<void()> & callback)
+bool TasksController::setSplay(TaskHandle handle, milliseconds window)
 {
-    if(name.empty() || !task.isValid() || !callback) return false;
+    if(window.count() < 0) return false;
 
-    std::pair<Task,std::vector<std::function<void()>>> pair;
-    pair.first = task;
-    pair.second.push_back(callback);
+    std::unique_lock<std::mutex>lock(acquire());
 
-    std::lock_guard<std::mutex>lock(mutex);
-    if(tasks.contains(name)) return false;
+    Slot * slot = slotOf(handle);
+    if(!slot) return false;
 
-    tasks.insert({name, pair});
+    slot->splayed = true;
+    resplay(handle.index, window);
 
     return true;
 }
 
-bool TasksController::addTask(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks)
+bool TasksController::setSplay(const std::string & name, milliseconds window)
 {
-    if(name.empty() || !task.isValid() || callbacks.empty()) return false;
+    return setSplay(find(name), window);
+}
+
+milliseconds TasksController::splay()
+{
+    std::unique_lock<std::mutex>lock(acquire());
+    return splayWindow;
+}
+
+void TasksController::renew(std::unique_lock<std::mutex> & lock)
+{
+    //The backend may wait (FileLease for the lock of its file), so it runs without the mutex.
+    //The members are published as a whole, a setLease() meanwhile makes them stale and they are dropped.
+    renewal = steadyNow() + lease->ttl() / 3;
+
+    const std::shared_ptr<TaskLease> current = lease;
+    const std::shared_ptr<const Ownership> before = ownership.load();
+    const Sharing mode = sharing;
+    const std::uint64_t generation = leases;
+
+    lock.unlock();
 
-    std::pair<Task,std::vector<std::function<void()>>> pair;
-    pair.first = task;
+    auto next = std::make_shared<Ownership>();
+    next->self = current->id();
+    next->sharing = mode;
 
-    for(auto & callback : callbacks)
+    if(!current->renew(next->members)) next->members.clear(); //nothing fires here until a renewal succeeds
+
+    const bool changed = !before || before->sharing != mode || before->members != next->members;
+
+    if(changed && next->sharing == HashRange)
     {
-        if(!callback) return false;
-        pair.second.push_back(callback);
+       constexpr unsigned points = 1024; //per replica, the share of each is within about 10% of an even split
+
+       next->ring.reserve(next->members.size() * points);
+       for(std::uint64_t member : next->members){ for(unsigned i = 0; i < points; i++) next->ring.emplace_back(mix(member + i * 0x9E3779B97F4A7C15ull), member); }
+
+       std::sort(next->ring.begin(), next->ring.end());
     }
 
-    std::lock_guard<std::mutex>lock(mutex);
-    if(tasks.contains(name)) return false;
+    lock.lock();
 
-    tasks.insert({name, pair});
+    if(changed && generation == leases) ownership.store(std::move(next));
+}
 
-    return true;
+bool TasksController::Ownership::owns(const std::string & name) const
+{
+    if(members.empty()) return false;
+    if(sharing == Leader) return members.front() == self;
+
+    auto it = std::lower_bound(ring.begin(), ring.end(), std::make_pair(mix(hashOf(name)), std::uint64_t(0)));
+    return ((it == ring.end()) ? ring.front() : *it).second == self; //the first point clockwise
 }
 
-bool TasksController::addCallback(const std::string & name, const std::function<void()> & callback)
+bool TasksController::setLease(std::shared_ptr<TaskLease> lease, Sharing sharing)
 {
-    if(name.empty() || !callback) return false;
+    if(sharing > HashRange) return false;
 
-    std::lock_guard<std::mutex>lock(mutex);
-    if(!tasks.contains(name)) return false;
+    std::unique_lock<std::mutex>lock(acquire());
+
+    this->lease = std::move(lease);
+    this->sharing = sharing;
+    leases++;
+
+    if(this->lease)
+    {
+       auto empty = std::make_shared<Ownership>(); //owns nothing until the renewal below
+       empty->self = this->lease->id();
+       empty->sharing = sharing;
+       ownership.store(std::move(empty));
+
+       renew(lock);
+    }
+    else ownership.store(nullptr);
 
-    tasks.at(name).second.push_back(callback);
+    wake();
 
     return true;
 }
 
-bool TasksController::addCallbacks(const std::string & name, const std::vector<std::function<void()>> & callbacks)
+bool TasksController::isOwner(const std::string & name)
 {
-    if(name.empty() || callbacks.empty()) return false;
-    for(auto & callback : callbacks){ if(!callback) return false; }
+    const std::shared_ptr<const Ownership> owner = ownership.load();
+    return !owner || owner->owns(name);
+}
+
+std::size_t TasksController::replicas()
+{
+    const std::shared_ptr<const Ownership> owner = ownership.load();
+    return (owner) ? owner->members.size() : 0;
+}
+
+std::size_t TasksController::maxCallbacksInFlight() const
+{
+    return maxInFlight.load();
+}
+
+void TasksController::setMaxCallbacksInFlight(std::size_t callbacks)
+{
+    maxInFlight = callbacks;
+}
+
+std::size_t TasksController::callbacksInFlight() const
+{
+    return inFlight.load();
+}
+
+//------------------metrics-------------------------
+
+std::unique_lock<std::mutex> TasksController::acquire()
+{
+    if(!measured.load(std::memory_order_relaxed)) return std::unique_lock<std::mutex>(mutex);
+
+    stats.locks.fetch_add(1, std::memory_order_relaxed);
+
+    std::unique_lock<std::mutex>lock(mutex, std::try_to_lock);
+    if(lock.owns_lock()) return lock;
+
+    const auto start = TimingWheel::Clock::now();
+    lock.lock();
+
+    stats.contended.fetch_add(1, std::memory_order_relaxed);
+    stats.lockWait.record(TimingWheel::Clock::now() - start);
+
+    return lock;
+}
+
+void TasksController::measure(const Due & due, TimingWheel::Clock::time_point start, bool late)
+{
+    const auto end = TimingWheel::Clock::now();
+    const auto lateness = (late) ? start - due.deadline : TimingWheel::Clock::duration(0); //a pending run has no deadline of its own
+
+    if(late) stats.lateness.record(lateness);
+    stats.callback.record(end - start);
+    if(due.stats) due.stats->record(lateness, end - start);
+}
+
+void TasksController::measureTick(TimingWheel::Clock::time_point start, const Batch & batch)
+{
+    stats.tick.record(TimingWheel::Clock::now() - start);
+    stats.ticks.fetch_add(1, std::memory_order_relaxed);
+    stats.tasks.store(names.size(), std::memory_order_relaxed);
+
+    if(batch.fires > 0) stats.fires.fetch_add(batch.fires, std::memory_order_relaxed);
+    if(!batch.expired.empty()) stats.timers.fetch_add(batch.expired.size(), std::memory_order_relaxed);
+}
 
+bool TasksController::isMeasured() const
+{
+    return measured.load();
+}
+
+bool TasksController::setMetrics(bool enabled, bool perTask)
+{
     std::lock_guard<std::mutex>lock(mutex);
-    if(!tasks.contains(name)) return false;
 
-    auto & v = tasks.at(name);
-    for(auto & callback : callbacks){ v.second.push_back(callback); }
+    measured = enabled;
+    this->perTask = enabled && perTask;
+
+    stats.clearTasks();
+
+    for(Slot & slot : slots)
+    {
+        if(slot.active && this->perTask) slot.stats = stats.add(*slot.name);
+        else slot.stats.reset();
+    }
 
     return true;
 }
 
-void TasksController::clearCallbacks(const std::string & name)
+TasksMetrics TasksController::metrics() const
 {
-    std::lock_guard<std::mutex>lock(mutex);
-    if(!tasks.contains(name)) return;
-    tasks.at(name).second.clear();
+    return stats.snapshot();
 }
 
-bool TasksController::isRun() const
+void TasksController::clearMetrics()
 {
-    return isrun.load();
+    stats.clear();
 }
 
-void TasksController::run()
+//------------------store---------------------------
+
+struct SnapshotHeader
 {
-    if(tasks.size() == 0) return;
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t record; //size of SnapshotRecord, changes with the layout of Task
+    std::uint64_t sequence; //of the last log record in the snapshot
+    std::uint64_t count;
+    std::uint64_t names; //bytes after the records
+};
+
+struct SnapshotRecord
+{
+    Task task;
+    std::uint32_t name; //offset in the names
+    std::uint32_t length;
+    std::uint32_t paused;
+    std::uint32_t expression; //length of the cron expression after the name, version 2
+};
 
-    isrun = true;
+static_assert(std::is_trivially_copyable_v<SnapshotRecord>, "records are copied straight out of the mapped snapshot");
 
-    do
-    {
-       std::this_thread::sleep_for(milliseconds(_accuracy.load()));
+static constexpr char snapshotMagic[8] = {'T', 'C', 'S', 'N', 'A', 'P', '\0', '\0'};
 
-       if(!isrun.load()) return;
+void TasksController::shiftInterval(Task & task, nanoseconds shift)
+{
+    if(task.pattern == Task::Period) task.finish += shift;
+}
+
+bool TasksController::internExpression(Task & task, std::string_view text)
+{
+    if(task.pattern != Task::Expression) return true;
+
+    task.expression = CronExpression::intern(CronExpression(text));
+    return task.expression != 0;
+}
 
-       Now now = GetFromNow();
+void TasksController::record(Change change, std::uint32_t index)
+{
+    const Slot & slot = slots[index];
+    const nanoseconds shift = (slot.task.pattern == Task::Period) ? utcNow().time_since_epoch() - steadyNow().time_since_epoch() : nanoseconds(0);
 
-       std::lock_guard<std::mutex>lock(mutex);
+    if(change == Added)
+    {
+       Task task = slot.task;
+       shiftInterval(task, shift);
 
-       for(auto begin = tasks.begin(); begin != tasks.end();)
+       if(const CronExpression * cron = (task.pattern == Task::Expression) ? CronExpression::find(task.expression) : nullptr)
        {
-           auto & task = begin->second;
-
-           if(task.first.taskCalculate(now, false)) //< --- when changing time, recalc - true
-           {
-              for(auto & func : task.second)
-              {
-                  func();
-                  if(!isrun.load()) return;
-              }
-
-              if(task.first.isSingle())
-              {
-                 begin = tasks.erase(begin);
-                 continue;
-              }
-           }
-
-           begin++;
+          const std::uint32_t length = static_cast<std::uint32_t>(cron->text().size());
+
+          std::string head(reinterpret_cast<const char*>(&task), sizeof(Task));
+          head.append(reinterpret_cast<const char*>(&length), sizeof(length)).append(cron->text());
+
+          journal->append(AddedCron, head, *slot.name);
+          return;
        }
+
+       journal->append(change, std::string_view(reinterpret_cast<const char*>(&task), sizeof(Task)), *slot.name);
+       return;
+    }
+
+    if(change == Fired || change == Resumed)
+    {
+       const std::int64_t finish = (slot.task.finish + shift).count();
+       journal->append(change, std::string_view(reinterpret_cast<const char*>(&finish), sizeof(finish)), *slot.name);
+       return;
     }
-    while(isrun.load());
+
+    journal->append(change, *slot.name);
+}
+
+void TasksController::replay(unsigned char change, std::string_view payload)
+{
+    const nanoseconds shift = steadyNow().time_since_epoch() - utcNow().time_since_epoch();
+
+    if(change == Cleared)
+    {
+       for(std::uint32_t i = 0; i < slots.size(); i++){ if(slots[i].active) release(i); }
+
+       names.clear();
+       calendar.clear();
+       intervals.clear();
+       stale = 0;
+       return;
+    }
+
+    if(change == Added)
+    {
+       if(payload.size() < sizeof(Task)) return;
+
+       Task task;
+       std::memcpy(static_cast<void*>(&task), payload.data(), sizeof(Task));
+       shiftInterval(task, shift);
+
+       insert(std::string(payload.substr(sizeof(Task))), task, {}, false);
+       return;
+    }
+
+    if(change == AddedCron)
+    {
+       std::uint32_t length;
+       if(payload.size() < sizeof(Task) + sizeof(length)) return;
+
+       Task task;
+       std::memcpy(static_cast<void*>(&task), payload.data(), sizeof(Task));
+       std::memcpy(&length, payload.data() + sizeof(Task), sizeof(length));
+       payload.remove_prefix(sizeof(Task) + sizeof(length));
+
+       if(payload.size() < length || !internExpression(task, payload.substr(0, length))) return;
+
+       insert(std::string(payload.substr(length)), task, {}, false);
+       return;
+    }
+
+    std::int64_t finish = 0;
+
+    if(change == Fired || change == Resumed)
+    {
+       if(payload.size() < sizeof(finish)) return;
+       std::memcpy(&finish, payload.data(), sizeof(finish));
+       payload.remove_prefix(sizeof(finish));
+    }
+
+    auto it = names.find(std::string(payload));
+    if(it == names.end()) return;
+
+    const std::uint32_t index = it->second;
+    Slot & slot = slots[index];
+
+    switch(change)
+    {
+       case Removed: erase(index); break;
+
+       case Paused:
+            if(!slot.paused){ invalidate(index); slot.paused = true; }
+            break;
+
+       case Fired:
+       case Resumed:
+            if(change == Fired && slot.task.isSingle()){ erase(index); break; }
+            if(!slot.paused) invalidate(index);
+            slot.paused = false;
+            slot.task.finish = nanoseconds(finish);
+            shiftInterval(slot.task, shift);
+            schedule(index, false);
+            break;
+    }
+}
+
+std::size_t TasksController::openStore(const std::string & path, std::vector<TaskLoadError> * errors)
+{
+    std::unique_lock<std::mutex>lock(acquire());
+
+    if(journal) return 0; //already open
+
+    std::size_t count = names.size();
+    std::uint64_t sequence = 0;
+    bool valid = true;
+
+    //----------------
+
+    mapFile(path + ".snapshot", [&](std::string_view data) //no snapshot - nothing was saved yet
+    {
+        SnapshotHeader header;
+
+        if(data.size() < sizeof(header)){ valid = false; return; }
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if(std::memcmp(header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || (header.version != 1 && header.version != 2) || header.record != sizeof(SnapshotRecord) ||
+           (data.size() - sizeof(header)) / sizeof(SnapshotRecord) < header.count || data.size() - sizeof(header) - header.count * sizeof(SnapshotRecord) < header.names)
+        {
+           valid = false;
+           return;
+        }
+
+        const char * records = data.data() + sizeof(header);
+        const std::string_view text(records + header.count * sizeof(SnapshotRecord), header.names);
+        const nanoseconds shift = steadyNow().time_since_epoch() - utcNow().time_since_epoch();
+
+        names.reserve(names.size() + header.count);
+        slots.reserve(slots.size() + header.count);
+
+        for(std::uint64_t i = 0; i < header.count; i++)
+        {
+            SnapshotRecord record;
+            std::memcpy(static_cast<void*>(&record), records + i * sizeof(SnapshotRecord), sizeof(SnapshotRecord));
+
+            if(header.version == 1) record.expression = 0;
+            if(record.name > text.size() || text.size() - record.name < std::size_t(record.length) + record.expression) continue;
+            if(!internExpression(record.task, text.substr(record.name + record.length, record.expression))) continue;
+
+            shiftInterval(record.task, shift);
+
+            TaskHandle handle = insert(std::string(text.substr(record.name, record.length)), record.task, {}, false); //no parsing, the deadline as it was saved
+            if(handle && record.paused){ invalidate(handle.index); slots[handle.index].paused = true; }
+        }
+
+        sequence = header.sequence;
+    });
+
+    if(!valid)
+    {
+       if(errors) errors->push_back({0, TaskLoadError::File});
+       return 0;
+    }
+
+    //----------------
+
+    auto log = std::make_unique<Journal>();
+
+    const bool opened = log->open(path + ".log", [this](std::uint64_t, unsigned char change, std::string_view payload){ replay(change, payload); }, sequence);
+
+    if(opened)
+    {
+       journal = std::move(log);
+       store = path;
+    }
+    else if(errors) errors->push_back({0, TaskLoadError::File});
+
+    count = names.size() - std::min(count, names.size());
+
+    wake();
+    resumeCancelled(lock);
+
+    return count;
+}
+
+bool TasksController::saveSnapshot()
+{
+    std::lock_guard<std::mutex>serial(saving); //an overlapping save would rotate over the .old of this one and race on the files
+
+    std::string data;
+    Journal * log;
+
+    {
+      std::unique_lock<std::mutex>lock(acquire());
+
+      if(!journal) return false;
+
+      const nanoseconds shift = utcNow().time_since_epoch() - steadyNow().time_since_epoch();
+
+      SnapshotHeader header;
+      std::memcpy(header.magic, snapshotMagic, sizeof(snapshotMagic));
+      header.version = 2;
+      header.record = sizeof(SnapshotRecord);
+      header.count = names.size();
+
+      data.resize(sizeof(header) + names.size() * sizeof(SnapshotRecord));
+
+      std::string text;
+      char * records = data.data() + sizeof(header);
+
+      for(const auto & [name, index] : names)
+      {
+          const Slot & slot = slots[index];
+          const CronExpression * cron = (slot.task.pattern == Task::Expression) ? CronExpression::find(slot.task.expression) : nullptr;
+
+          SnapshotRecord record;
+          record.task = slot.task;
+          record.name = static_cast<std::uint32_t>(text.size());
+          record.length = static_cast<std::uint32_t>(name.size());
+          record.paused = slot.paused;
+          record.expression = (cron) ? static_cast<std::uint32_t>(cron->text().size()) : 0;
+          shiftInterval(record.task, shift);
+
+          std::memcpy(records, static_cast<const void*>(&record), sizeof(record));
+          records += sizeof(record);
+          text += name;
+          if(cron) text += cron->text();
+      }
+
+      header.names = text.size();
+      header.sequence = journal->rotate(); //under the mutex, no change is logged between the copy and the rotation
+
+      std::memcpy(data.data(), &header, sizeof(header));
+      data += text;
+
+      log = journal.get();
+    }
+
+    if(!Journal::writeFile(store + ".snapshot", data)) return false; //the rotated log is still replayed on the old snapshot
+
+    log->dropRotated();
+
+    return true;
+}
+
+bool TasksController::syncStore()
+{
+    Journal * log;
+
+    {
+      std::unique_lock<std::mutex>lock(acquire());
+      log = journal.get();
+    }
+
+    return log && log->sync();
 }
 
 void TasksController::stop()
 {
+    //Without the mutex: the source of a run is replaced, never changed, so a stop() racing with start() requests
+    //either the old run or the new one, and run() and start() set isrun after the new source is published
+    stopping.load()->request_stop();
     isrun = false;
+
+    wake();
+}
+
+bool TasksController::start()
+{
+    if(scheduler.joinable())
+    {
+       if(finished.wait_for(nanoseconds(0)) != std::future_status::ready) return false;
+       scheduler.join();
+    }
+
+    {
+      std::unique_lock<std::mutex>lock(mutex);
+
+      if(isrun.load()) return false; //run() on another thread
+
+      stopping.store(std::make_shared<std::stop_source>()); //set before the thread exists, a stop() right after start() is kept
+      isrun = true;
+    }
+
+    std::promise<void> done;
+    finished = done.get_future();
+
+    scheduler = std::jthread([this, done = std::move(done)](std::stop_token token) mutable
+    {
+        serve(token);
+        done.set_value();
+    });
+
+    return true;
+}
+
+bool TasksController::stopAndJoin(milliseconds timeout)
+{
+    const auto deadline = steady_clock::now() + timeout;
+
+    std::vector<TaskExecutor*> pools;
+
+    {
+      std::unique_lock<std::mutex>lock(acquire());
+
+      if(executor) pools.push_back(executor.get());
+      for(auto & lane : workers){ if(lane) pools.push_back(lane.get()); }
+    }
+
+    if((scheduler.joinable() && scheduler.get_id() == std::this_thread::get_id()) ||
+       std::any_of(pools.begin(), pools.end(), [](TaskExecutor * pool){ return pool->isWorker(); }))
+    {
+       stop(); //from a callback, it would wait for itself
+       return false;
+    }
+
+    if(scheduler.joinable())
+    {
+       scheduler.request_stop(); //stop() through the stop_callback of run()
+       if(finished.wait_until(deadline) != std::future_status::ready) return false;
+       scheduler.join();
+    }
+    else if(isrun.load())
+    {
+       stop(); //run() on a thread of the caller, it is not joined here
+       return false;
+    }
+
+    for(TaskExecutor * pool : pools){ if(!pool->waitUntil(deadline)) return false; }
+
+    return true;
+}
+
+std::stop_token TasksController::stopToken()
+{
+    return stopping.load()->get_token();
 }
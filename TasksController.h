@@ -1,12 +1,33 @@
 #ifndef TASKSCONTROLLER_H
 #define TASKSCONTROLLER_H
 
+#include <string>
 #include <string_view>
 #include <chrono>
 #include <functional>
-#include <map>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <semaphore>
+#include <future>
+#include <thread>
 #include <atomic>
+#include <coroutine>
+#include <stop_token>
+#include <ranges>
+
+#include "TimingWheel.h"
+#include "TimeZone.h"
+#include "TaskExecutor.h"
+#include "MpscQueue.h"
+#include "Journal.h"
+#include "Metrics.h"
+#include "InplaceFunction.h"
+#include "CronExpression.h"
+#include "TaskClock.h"
+#include "TaskLease.h"
 
 /* Task example
 
@@ -73,7 +94,7 @@
 
      description:
 
-     I - interval
+     I - interval, counted on the monotonic clock, wall clock changes do not move it
 
      DDDDD - days, 00005, range[0,65535]
      hh - hours: 15, range[0,23]
@@ -100,31 +121,74 @@
 
      n. ....
 
-  6. SI DDDDD hh:mm:ss - single interval, same as interval, only fires once
+     I DDDDD hh:mm:ss.mmm - interval with milliseconds, mmm range[0,999]
+
+     example:
+
+     0. every milliseconds(250):I 00000 00:00:00.250
+
+     1. every seconds(1) + milliseconds(500):I 00000 00:00:01.500
+
+  6. SI DDDDD hh:mm:ss - single interval, same as interval, only fires once, also with .mmm
+
+  7. C ss mm hh DD MM W
+
+     description:
+
+     C - cron expression, see CronExpression.h
+
+     ss - seconds, mm - minutes, hh - hours, DD - day, MM - month, W - weekday, each a value, a range, a step or a list of them
+
+     reuslt:C 0 0-59/5 9-17 * * MON-FRI
+
+     example:
+
+     0. every 5 minutes from 09:00 to 17:55 on working days:C 0 0-59/5 9-17 * * 1-5
+
+     1. at 00:00:00 and 12:00:00 on the 1st and the 15th:C 0 0 0,12 1,15 * *
+
+     2. every 10 seconds:C 0-59/10 * * * * *
+
+     3. without the seconds, at 08:30:00 on Sundays in December:C 30 8 * DEC SUN
+
+  8. SC ss mm hh DD MM W - single cron expression, same as cron expression, only fires once
 
 */
 
 class Task final
 {
-    using Now = std::chrono::system_clock::time_point;
+    friend class TasksController;
+    friend class TaskOccurrences;
+
 public:
 
+    using Now = std::chrono::system_clock::time_point;
+    using Steady = std::chrono::steady_clock::time_point;
+
     enum Type : unsigned char
     {
          None = 0,
          Point,
          SinglePoint,
          Interval,
-         SingleInterval
+         SingleInterval,
+         Cron,
+         SingleCron
     };
 
     explicit Task();
     explicit Task(std::string_view value);
 
     bool isValid() const;
+    //recalc - the next fire from now, after a wall clock change or a pause, intervals keep their cadence on steady_clock
     bool taskCalculate(const Now & now, bool recalc) const;
+    bool taskCalculate(const Now & now, const Steady & steady, bool recalc) const;
+    Now nextFire() const; //Local time of the next fire, valid only if isValid()
+    Steady nextSteadyFire() const; //exact for intervals, calendar fires are projected from now
     Type taskType() const;
     bool isSingle() const;
+    bool isCalendar() const; //follows the wall clock, false for intervals
+    std::vector<Now> nextOccurrences(std::size_t n) const; //nextFire() and the fires after it, see TaskOccurrences
 
     bool pointDayTaskInit(const unsigned char seconds,
                           const unsigned char minutes = 0,
@@ -151,55 +215,619 @@ public:
     bool intervalTaskInit(const unsigned char seconds,
                           const unsigned char minutes = 0,
                           const unsigned char hours = 0,
-                          const unsigned short days = 0);
+                          const unsigned short days = 0,
+                          const unsigned short milliseconds = 0);
 
     bool singleIntervalTaskInit(const unsigned char seconds,
                                 const unsigned char minutes = 0,
                                 const unsigned char hours = 0,
-                                const unsigned short days = 0);
+                                const unsigned short days = 0,
+                                const unsigned short milliseconds = 0);
+
+    bool cronTaskInit(std::string_view expression);
+    bool singleCronTaskInit(std::string_view expression);
 
     bool parseFromString(std::string_view value);
 
 private:
+
+    enum Pattern : unsigned char
+    {
+         Empty = 0,
+         Day,
+         DayMonth,
+         Weekday,
+         Month,
+         Hours,
+         Minutes,
+         Seconds,
+         Period,
+         Expression
+    };
+
+    //Trivially copyable, 24 bytes, evaluated by a switch in taskCalculate()
+    mutable std::chrono::nanoseconds finish = std::chrono::nanoseconds(0); //since the epoch of system_clock, of steady_clock for Period
+    std::chrono::milliseconds sum = std::chrono::milliseconds(0); //time of the day/hour/minute, or the interval
     Type type = None;
-    std::function<bool(const Now &, bool)> calculate = nullptr;
+    Pattern pattern = Empty;
+    unsigned char day = 0; //day of the month, or weekday[0,6] for Weekday
+    unsigned char month = 0;
+    std::uint32_t expression = 0; //id of the interned CronExpression for Expression
+
+    void reset();
+    void setFinish(const Now & time) const;
+    bool isSubDaily() const; //repeats every hour or minute, a cron expression more than once a day
+    bool onlyTimeInit(const unsigned char seconds,
+                      const unsigned char minutes,
+                      const unsigned char hours,
+                      const Now & now,
+                      bool isZeroHour,
+                      bool isZeroMinute,
+                      bool isZeroSecond);
 };
 
-class TasksController final //Time change detection is not support
+class TaskOccurrences final //the fires of a task from its next one on, each calculated from the one before on a copy of the task
 {
+public:
+
+    explicit TaskOccurrences(const Task & task); //intervals are projected to local time from the current clock
+    explicit TaskOccurrences(const Task & task, const Task::Now & now, const Task::Steady & steady); //local time and steady_clock now
+
+    bool next(Task::Now & fire); //local time, false - no fire left
+    void skipTo(const Task::Now & from); //the next fire is the first at or after from, one calculation instead of a walk
+
+private:
+
+    Task task;
+    std::chrono::nanoseconds shift; //local time - steady_clock, for intervals
+    bool started = false;
+    bool done;
+};
+
+class TaskHandle final //index + generation in the slot table of a TasksController
+{
+    friend class TasksController;
+
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+
+    explicit TaskHandle(std::uint32_t index, std::uint32_t generation);
+
+public:
+
+    TaskHandle();
+
+    bool isValid() const;
+    explicit operator bool() const;
+    bool operator==(const TaskHandle & other) const = default;
+};
+
+struct TaskLoadError
+{
+    enum Reason : unsigned char
+    {
+         File = 0, //line is 0
+         Format,   //no name<TAB>schedule
+         Schedule, //the schedule is not valid
+         Duplicate
+    };
+
+    std::size_t line; //1-based
+    Reason reason;
+};
+
+class TasksController;
+
+class TaskAwaiter final //co_await TasksController::nextFire(), lives in the coroutine frame, linked into the slot of the task while suspended
+{
+    friend class TasksController;
+
+    TasksController * controller;
+    TaskHandle handle;
+    std::coroutine_handle<> coroutine;
+    TaskAwaiter * next = nullptr;
+    bool fired = false;
+
+    explicit TaskAwaiter(TasksController * controller, TaskHandle handle);
+
+public:
+
+    bool await_ready() const noexcept;
+    bool await_suspend(std::coroutine_handle<> coroutine);
+    bool await_resume() const noexcept; //true - the task fired, false - it was removed or the handle is not valid
+};
+
+class TasksController final //Wall clock changes and UTC offset changes of the time zone are detected, intervals run on steady_clock
+{
+    friend class TaskAwaiter;
+
+public:
+
+    enum Overrun : unsigned char //what a fire does while the callbacks of the previous ones still run on the pool
+    {
+         Overlap = 0, //runs next to them, up to limit runs (0 - unlimited)
+         Skip,        //dropped
+         Coalesce,    //one run follows the current one, the fires meanwhile are merged into it
+         Queue        //runs after them one by one, up to limit waiting runs (0 - unlimited)
+    };
+
+    enum Priority : unsigned char //dispatch lane of a task
+    {
+         Critical = 0,
+         High,
+         Normal, //by default
+         Low
+    };
+
+    static constexpr unsigned lanes = Low + 1;
+
+    enum Sharing : unsigned char //which tasks fire on this replica, setLease()
+    {
+         Leader = 0, //all of them on the replica that joined first, none on the others
+         HashRange   //those whose names fall into the ranges of this replica on a consistent-hash ring
+    };
+
+    using Callback = InplaceFunction<void()>; //stored in place, std::function fits too
+
+    struct Entry //addTasks()
+    {
+        std::string name;
+        Task task = Task();
+        std::vector<Callback> callbacks;
+    };
+
+    struct Occurrence //firesInWindow()
+    {
+        std::string name;
+        TaskHandle handle;
+        Task::Now time; //local time
+    };
+
+private:
+
+    using Callbacks = std::vector<Callback>;
+    using CallbackList = std::shared_ptr<const Callback[]>; //ends with an empty Callback, nullptr - no callbacks
+
+    struct Runs //overrun state of a task, shared by its slot and the jobs on the pool
+    {
+        enum Admit : unsigned char
+        {
+             Start = 0, //post a job
+             Pending,   //the running job runs it
+             Rejected
+        };
+
+        std::atomic<std::uint32_t> state = 0; //Overlap, Skip - running jobs, Coalesce, Queue - 1 + waiting runs while one runs
+        Overrun policy = Overlap;
+        std::uint32_t limit = 0;
+
+        Admit admit();
+        bool again(); //at the end of a run, true - run once more
+    };
+
+    struct Slot
+    {
+        Task task;
+        CallbackList callbacks; //copy-on-write, a fire holds them without the lock
+        const std::string * name = nullptr; //the key in names
+        TaskAwaiter * waiters = nullptr; //suspended nextFire() coroutines, resumed together on the next fire
+        std::shared_ptr<Metrics::Task> stats; //setMetrics() with perTask
+        std::shared_ptr<Runs> runs; //setOverrun(), nullptr - overlapping runs are not limited
+        std::uint32_t generation = 1;
+        Priority priority = Normal;
+        std::chrono::nanoseconds splay = std::chrono::nanoseconds(0); //added to the deadline in the heap, setSplay()
+        std::uint32_t sequence = 0; //changed when the heap entry of the slot becomes stale
+        bool active = false;
+        bool paused = false;
+        bool splayed = false; //a window of its own, the window of the controller does not apply
+        bool overdue = false; //stepped over by the clock, fires once with its next fire calculated already
+    };
+
+    struct Deadline
+    {
+        std::chrono::nanoseconds time; //since the epoch of the clock of its heap
+        std::uint32_t index;
+        std::uint32_t sequence;
+    };
+
+    struct Command
+    {
+        enum Kind : unsigned char
+        {
+             AddTask = 0,
+             AddCallbacks,
+             ClearCallbacks,
+             RemoveTask
+        };
+
+        Kind kind = AddTask;
+        std::string name;
+        Task task;
+        Callbacks callbacks;
+        std::promise<bool> result;
+        std::promise<TaskHandle> handle; //AddTask
+    };
+
+    enum Shift : unsigned char //why the calendar heap is rebuilt
+    {
+         ClockStep = 0,
+         Transition, //of the UTC offset of the time zone
+         ZoneChange
+    };
+
+    enum Change : unsigned char //records of the log of openStore()
+    {
+         Added = 0,   //Task + name
+         Removed,     //name
+         Fired,       //next fire + name, a single task is gone
+         Paused,      //name
+         Resumed,     //next fire + name
+         Cleared,
+         AddedCron    //Task + length of the expression (uint32) + expression + name
+    };
+
+    struct Due
+    {
+        CallbackList callbacks;
+        TimingWheel::Clock::time_point deadline; //on steady_clock, the lateness of the callbacks is measured from it
+        std::shared_ptr<Metrics::Task> stats;
+        std::shared_ptr<Runs> runs;
+        Priority priority;
+    };
+
+    struct Batch //what one tick fires
+    {
+        std::vector<std::function<void()>> expired;
+        std::vector<Due> due;
+        std::vector<TaskAwaiter*> waiters; //one list per fired task, the lists of removed tasks are resumed with false
+        std::size_t fires = 0; //also the tasks without callbacks
+
+        bool empty() const;
+        void clear();
+    };
+
+    struct Ownership //the members of the lease at a renewal, replaced as a whole and read without the mutex
+    {
+        std::uint64_t self = 0; //id of the lease
+        Sharing sharing = Leader;
+        std::vector<std::uint64_t> members; //live replicas in the order they joined, empty - the renewal failed
+        std::vector<std::pair<std::uint64_t, std::uint64_t>> ring; //HashRange: points of the members and their ids, sorted
+
+        bool owns(const std::string & name) const;
+    };
+
     std::atomic_bool isrun = false;
     std::atomic_ushort _accuracy = 10;
+    std::atomic_bool precise = false;
+    int wakeFd = -1; //Linux: eventfd for wake(), realtime timerfd armed with the absolute deadline, cancelled by clock changes
+    int timerFd = -1;
+    std::atomic_int readyFd = -1; //fileDescriptor(), readable when processDue() has work
+    std::atomic_bool signaled = false;
+    std::atomic_bool clockChanged = false; //set by a cancelled timerfd
+    std::atomic_bool measured = false; //setMetrics()
+    std::atomic_size_t maxInFlight = 0; //0 - no cap
+    std::atomic_size_t inFlight = 0; //task jobs posted to the pool and not finished, counted while capped
+    bool perTask = false;
+    std::counting_semaphore<> signal{0}; //wakes run() without the descriptors, released without the mutex so producers never block on it
     std::mutex mutex;
-    std::map<std::string, std::pair<Task,std::vector<std::function<void()>>>> tasks;
+    std::vector<Slot> slots;
+    std::vector<std::uint32_t> freeSlots;
+    std::unordered_map<std::string, std::uint32_t> names; //secondary index of the slot table
+    std::vector<Deadline> calendar; //min-heaps by next fire, local time of the wall clock and steady_clock,
+    std::vector<Deadline> intervals; //entries of removed and paused tasks are skipped lazily
+    std::chrono::nanoseconds offset = std::chrono::nanoseconds(0); //wall clock - steady_clock at the last tick, 0 - not measured
+    TimeZone zone = TimeZone::local(); //local time of the calendar tasks
+    TimeZone::Period period; //of zone, looked up again when the wall clock leaves it
+    std::shared_ptr<TaskClock> clock; //setClock(), nullptr - TaskClock::current()
+    std::chrono::milliseconds splayWindow = std::chrono::milliseconds(0); //setSplay() of the controller
+    std::shared_ptr<TaskLease> lease; //setLease(), nullptr - every task fires here
+    Sharing sharing = Leader;
+    std::atomic<std::shared_ptr<const Ownership>> ownership; //published by renew(), nullptr - no lease
+    std::uint64_t leases = 0; //setLease() calls, a renewal started before the last one is dropped
+    TimingWheel::Clock::time_point renewal; //of the lease, on the clock of the controller
+    bool transition = false; //the UTC offset changed, collect() recalculates
+    TaskAwaiter * cancelled = nullptr; //waiters of removed tasks, resumed once the mutex is released
+    std::size_t stale = 0;
+    TimingWheel wheel; //one-shot delay timers
+    MpscQueue<Command> commands; //drained by run() at the start of every tick
+    Metrics stats; //declared before the executor, its jobs record into it until they are joined
+    std::unique_ptr<TaskExecutor> executor; //nullptr - callbacks run on the thread of run()
+    std::unique_ptr<TaskExecutor> workers[lanes]; //setLaneWorkers(), nullptr - the lane shares the executor
+    std::unique_ptr<Journal> journal; //openStore(), nullptr - the changes are not logged
+    std::string store;
+    std::mutex saving; //saveSnapshot() from the rotation of the log to dropRotated(), taken before the mutex
+    std::atomic<std::shared_ptr<std::stop_source>> stopping{std::make_shared<std::stop_source>()}; //of the current run, replaced by run() and start()
+    std::future<void> finished; //ready when the thread of start() leaves run()
+    std::jthread scheduler; //start()
+
+    static bool later(const Deadline & a, const Deadline & b);
+    Slot * slotOf(TaskHandle handle);
+    Slot * slotOf(const std::string & name);
+    TaskHandle insert(std::string && name, const Task & task, CallbackList && callbacks, bool calculate = true);
+    static CallbackList share(Callbacks && callbacks, const CallbackList & before = {}); //before + callbacks in one allocation
+    static bool isValid(const Callbacks & callbacks);
+    bool appendCallbacks(const std::string & name, Callbacks && callbacks);
+    void erase(std::uint32_t index);
+    void release(std::uint32_t index);
+    void schedule(std::uint32_t index, bool notify = true);
+    void invalidate(std::uint32_t index);
+    bool jumped(const Task::Now & utc, TimingWheel::Clock::time_point steady);
+    void recalculate(const Task::Now & now, TimingWheel::Clock::time_point steady, Shift shift);
+    Task::Now localNow();
+    Task::Now utcNow() const;
+    TimingWheel::Clock::time_point steadyNow() const;
+    std::unique_lock<std::mutex> acquire(); //the mutex for a caller, the wait is measured when it is contended
+    void measure(const Due & due, TimingWheel::Clock::time_point start, bool late = true);
+    static bool applyOverrun(Slot & slot, Overrun policy, unsigned limit);
+    static bool earlier(const Due & a, const Due & b); //lane, then deadline
+    void submit(TaskExecutor & pool, Due & due, bool measuring, std::size_t cap, bool stoppable);
+    static std::chrono::nanoseconds splayOf(const std::string & name, std::chrono::milliseconds window); //[0, window), by the name
+    void resplay(std::uint32_t index, std::chrono::milliseconds window);
+    void renew(std::unique_lock<std::mutex> & lock); //unlocks it while the backend renews
+    void measureTick(TimingWheel::Clock::time_point start, const Batch & batch);
+    void wake();
+    void sleepUntil(TimingWheel::Clock::time_point deadline);
+    void apply(Command & command);
+    void drain();
+    std::future<bool> post(Command && command);
+    void collect(const Task::Now & now, TimingWheel::Clock::time_point steady, Batch & batch);
+    TimingWheel::Clock::duration nextWait(const Task::Now & now, TimingWheel::Clock::time_point steady) const;
+    bool dispatch(Batch & batch, std::unique_lock<std::mutex> & lock, bool stoppable);
+    bool suspend(TaskAwaiter * awaiter);
+    void resumeCancelled(std::unique_lock<std::mutex> & lock);
+    static void resume(TaskAwaiter * waiters);
+    void loop(std::unique_lock<std::mutex> & lock);
+    void serve(std::stop_token token); //the loop of run(token) and of the thread of start(), they set isrun
+    void record(Change change, std::uint32_t index);
+    void replay(unsigned char change, std::string_view payload);
+    static void shiftInterval(Task & task, std::chrono::nanoseconds shift); //intervals are stored with the deadline in UTC
+    static bool internExpression(Task & task, std::string_view text); //cron ids are per process, the text is stored
 
 public:
 
     explicit TasksController();
     explicit TasksController(unsigned short accuracy);
+    explicit TasksController(unsigned short accuracy, unsigned threads); //threads > 0 - callbacks run on a work-stealing pool
+    ~TasksController();
+
+    unsigned threads() const;
 
     bool clearTasks();
     int countTasks();
 
+    //Wake-up delay after the earliest deadline, deadlines within it are fired in one wake-up
     unsigned short accuracy() const;
     bool setAccuracy(unsigned short ms = 10);
 
+    //Precision mode, the wake-up delay is not used and run() sleeps to the exact deadline
+    //(an absolute timerfd on Linux), so millisecond intervals fire sub-millisecond late.
+    bool isPrecise() const;
+    bool setPrecise(bool enabled);
+
+    //Time zone of the calendar tasks (P, SP, W, SW, C, SC), the zone of the system by default, see TimeZone for the names.
+    //The UTC offset is cached until its next change, then the hourly and minutely schedules are calculated again.
+    //Changing the zone calculates every calendar task from now in the new local time.
+    std::string timeZone();
+    bool setTimeZone(std::string_view name);
+
+    //Clock of the controller, TaskClock::current() by default, set only while it has no tasks and no timers.
+    //advanceClock() moves a ManualClock by step from one deadline to the next and fires what is due at each
+    //as processDue() would, on the calling thread or the pool, without sleeping. Returns the number of fired
+    //tasks and timers, 0 without a ManualClock or while run() is active. Lateness in the metrics is meaningless
+    //under a ManualClock, the tick cost stays real.
+    bool setClock(std::shared_ptr<TaskClock> clock);
+    std::size_t advanceClock(std::chrono::nanoseconds step);
+
     bool contains(const std::string & name);
+    bool contains(TaskHandle handle);
+    TaskHandle find(const std::string & name);
+
+    TaskHandle addTask(const std::string & name, std::string_view value);
+    TaskHandle addTask(const std::string & name, std::string_view value, const std::function<void()> & callback);
+    TaskHandle addTask(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks);
+
+    TaskHandle addTask(const std::string & name, const Task & task);
+    TaskHandle addTask(const std::string & name, const Task & task, const std::function<void()> & callback);
+    TaskHandle addTask(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks);
+
+    //Registration without copies: the name is moved into the index and the callables are constructed in the one array
+    //of the callbacks of the task, a task costs the node of the index and that array (none without callbacks).
+    //A callable must fit in Callback, the templates are constrained on Callback::fits<F>, the overloads above take std::function of any size.
+    template<typename... Functions> requires (Callback::fits<Functions> && ...)
+    TaskHandle emplaceTask(std::string && name, const Task & task, Functions &&... callbacks)
+    {
+        if(name.empty() || !task.isValid()) return {};
+
+        CallbackList list;
+
+        if constexpr(sizeof...(Functions) > 0)
+        {
+           auto array = std::make_shared<Callback[]>(sizeof...(Functions) + 1);
+           std::size_t i = 0;
+
+           ((array[i++] = Callback(std::forward<Functions>(callbacks))), ...);
+           for(i = 0; i < sizeof...(Functions); i++){ if(!array[i]) return {}; }
 
-    bool addTask(const std::string & name, std::string_view value);
-    bool addTask(const std::string & name, std::string_view value, const std::function<void()> & callback);
-    bool addTask(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks);
+           list = std::move(array);
+        }
 
-    bool addTask(const std::string & name, const Task & task);
-    bool addTask(const std::string & name, const Task & task, const std::function<void()> & callback);
-    bool addTask(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks);
+        std::unique_lock<std::mutex>lock(acquire());
+        return insert(std::move(name), task, std::move(list));
+    }
+
+    template<typename... Functions> requires (Callback::fits<Functions> && ...)
+    TaskHandle emplaceTask(std::string && name, std::string_view value, Functions &&... callbacks)
+    {
+        if(value.empty()) return {};
+        return emplaceTask(std::move(name), Task(value), std::forward<Functions>(callbacks)...);
+    }
+
+    //Adds the entries under one lock, a range of rvalues gives up its names and callbacks. Returns the number of added
+    //tasks, an entry with an empty name, an invalid task, an empty callback or a name in use is skipped.
+    template<std::ranges::input_range Range> requires std::is_same_v<std::remove_cvref_t<std::ranges::range_reference_t<Range>>, Entry>
+    std::size_t addTasks(Range && entries)
+    {
+        constexpr bool movable = !std::is_lvalue_reference_v<Range> && !std::is_const_v<std::remove_reference_t<std::ranges::range_reference_t<Range>>>;
+
+        std::size_t added = 0;
+
+        std::unique_lock<std::mutex>lock(acquire());
+
+        if constexpr(std::ranges::sized_range<Range>)
+        {
+           names.reserve(names.size() + std::ranges::size(entries));
+           slots.reserve(slots.size() + std::ranges::size(entries));
+        }
+
+        for(auto && entry : entries)
+        {
+            if(entry.name.empty() || !entry.task.isValid() || !isValid(entry.callbacks)) continue;
+
+            if constexpr(movable) added += insert(std::move(entry.name), entry.task, share(std::move(entry.callbacks))).isValid();
+            else added += insert(std::string(entry.name), entry.task, share(Callbacks(entry.callbacks))).isValid();
+        }
+
+        return added;
+    }
+
+    //Bulk loader of "name<TAB>schedule" lines, empty lines and lines starting with '#' are skipped.
+    //Schedules are parsed on threads (0 - hardware concurrency) and inserted under one lock,
+    //returns the number of added tasks, the rejected lines go to errors.
+    std::size_t loadTasks(std::string_view lines, std::vector<TaskLoadError> * errors = nullptr, unsigned threads = 0);
+    std::size_t loadTasksFromFile(const std::string & path, std::vector<TaskLoadError> * errors = nullptr, unsigned threads = 0);
+
+    //Persistence of the tasks and their next fires, not of the callbacks and the timers. openStore() maps the snapshot
+    //path + ".snapshot", replays the log path + ".log" written after it and then logs every add, remove, pause, resume
+    //and fire, a background thread writes the log in groups with one sync each. Restored tasks have no callbacks,
+    //addCallback() attaches them by name, and a deadline that passed while the process was down fires once.
+    //saveSnapshot() writes every task and starts an empty log, syncStore() waits until the logged changes are on disk.
+    std::size_t openStore(const std::string & path, std::vector<TaskLoadError> * errors = nullptr);
+    bool saveSnapshot();
+    bool syncStore();
+
+    //Runtime metrics, off by default: tick cost, fire lateness, callback duration and the wait of callers for the mutex,
+    //see Metrics.h. Recorded with relaxed atomics, metrics() reads them without the mutex, toPrometheus()/toJson() export them.
+    //perTask also keeps fires, lateness and callback time of every task, its name is a label of the export.
+    bool isMeasured() const;
+    bool setMetrics(bool enabled, bool perTask = false);
+    TasksMetrics metrics() const;
+    void clearMetrics();
+
+    //Overrun policy of a task, Overlap without a limit by default. The policy applies to the runs on the pool,
+    //callbacks on the thread of run() never overlap. Kept until the task is removed, not stored by openStore().
+    bool setOverrun(TaskHandle handle, Overrun policy, unsigned limit = 0);
+    bool setOverrun(const std::string & name, Overrun policy, unsigned limit = 0);
+
+    //Cap on the task runs posted to the pool and not finished (0 - none). A fire over the cap is shed before
+    //its policy is applied, the timers are not counted. Shed and skipped fires are counted by the metrics.
+    std::size_t maxCallbacksInFlight() const;
+    void setMaxCallbacksInFlight(std::size_t callbacks);
+    std::size_t callbacksInFlight() const; //counted while a cap is set
+
+    //Priority lanes, Normal by default. The tasks due in one tick run in lane order, then by deadline, after the expired timers.
+    //A lane with its own workers (setLaneWorkers(), 0 - none) posts its fires to them before the other lanes run, so a critical
+    //task never waits behind bulk callbacks on the shared pool or on the thread of run(). Replaced workers finish their queued
+    //jobs first. Kept until the task is removed, not stored by openStore().
+    bool setPriority(TaskHandle handle, Priority priority);
+    bool setPriority(const std::string & name, Priority priority);
+    bool setLaneWorkers(Priority lane, unsigned threads);
+    unsigned laneWorkers(Priority lane);
+
+    //Splay of the fires against thundering herds, 0 - none. A task fires at its calculated time + an offset in [0, window)
+    //derived from its name (FNV-1a), the same in every process, so the tasks of one schedule are spread evenly over the window
+    //and each of them keeps its period: the next fire is calculated on the time of the task, the clock - its offset.
+    //The window of the controller applies to the tasks without one of their own (a task window, 0 too, replaces it).
+    //Changing a window moves the scheduled fires. The previews include the offsets, the store keeps the fires without them.
+    //fireDensity() - the fires of every second of [from, to), index i - the second from + i, see firesInWindow().
+    bool setSplay(std::chrono::milliseconds window);
+    bool setSplay(TaskHandle handle, std::chrono::milliseconds window);
+    bool setSplay(const std::string & name, std::chrono::milliseconds window);
+    std::chrono::milliseconds splay();
+    std::vector<std::size_t> fireDensity(const Task::Now & from, const Task::Now & to);
+
+    //Replicas with the same tasks share them through a lease, see TaskLease.h (FileLease - one host), nullptr - all fire here.
+    //Leader - the replica that joined first fires every task. HashRange - each live replica fires the tasks whose names fall
+    //into its ranges of a ring of 1024 points per replica, a large task set is spread and a replica that joins or leaves moves
+    //only the tasks of its ranges. The scheduler renews the lease every ttl / 3, a dead replica is dropped by the others ttl
+    //after its last renewal: with ttl + ttl / 3 shorter than the period of a task its next fire is taken over, the fires in
+    //between are lost. A fire owned by another replica moves the schedule on without the callbacks and the waiters and is
+    //counted as unowned, after a failed renewal no task fires here. isOwner() - the task of the name fires here.
+    //The backend is called without the mutex, the members it gives are published at once for the next ticks and for
+    //isOwner() and replicas(), which read them without the mutex too.
+    bool setLease(std::shared_ptr<TaskLease> lease, Sharing sharing = Leader);
+    bool isOwner(const std::string & name);
+    std::size_t replicas(); //live at the last renewal, 0 - no lease or a failed renewal
+
+    //O(1), safe while run() is active, a paused task keeps its handle and name, resume() calculates its next fire from now
+    bool remove(TaskHandle handle);
+    bool remove(const std::string & name);
+    bool pause(TaskHandle handle);
+    bool resume(TaskHandle handle);
+    bool isPaused(TaskHandle handle);
+
+    //One-shot delay timers, O(1) add/cancel, they have no name and are not counted by countTasks()
+    TimingWheel::Timer addAfter(std::chrono::milliseconds delay, const std::function<void()> & callback);
+    bool cancel(TimingWheel::Timer timer);
+    int countTimers();
+    void clearTimers();
+
+    //Non-blocking versions, queued without the mutex and applied by run() at the start of the next tick,
+    //or at once if it is not running. The future reports the same result as the blocking call.
+    std::future<TaskHandle> addTaskAsync(const std::string & name, std::string_view value, const std::vector<std::function<void()>> & callbacks = {});
+    std::future<TaskHandle> addTaskAsync(const std::string & name, const Task & task, const std::vector<std::function<void()>> & callbacks = {});
+    std::future<bool> addCallbacksAsync(const std::string & name, const std::vector<std::function<void()>> & callbacks);
+    std::future<bool> clearCallbacksAsync(const std::string & name);
+    std::future<bool> removeTaskAsync(const std::string & name);
+
+    //co_await controller.nextFire(handle) - suspends the coroutine until the next fire of the task, without a thread or an allocation.
+    //Every coroutine waiting for a task is resumed in one pass after its callbacks, on the thread that runs them, and resumed
+    //with false when the task is removed. A suspended coroutine must not be destroyed before it is resumed.
+    TaskAwaiter nextFire(TaskHandle handle);
+    TaskAwaiter nextFire(const std::string & name);
+
+    //Preview of the fires in local time, nothing is fired. nextOccurrences() - the next n fires of a task, none while it is paused.
+    //firesInWindow() - the fires of all tasks in [from, to) ordered by time, up to limit. The tasks are found in the deadline heaps,
+    //only subtrees with a deadline before to are visited, and their fires are merged lazily one calculation per fire.
+    std::vector<Task::Now> nextOccurrences(TaskHandle handle, std::size_t n);
+    std::vector<Task::Now> nextOccurrences(const std::string & name, std::size_t n);
+    std::vector<Occurrence> firesInWindow(const Task::Now & from, const Task::Now & to, std::size_t limit = 1000000);
 
     bool addCallback(const std::string & name, const std::function<void()> & callback);
     bool addCallbacks(const std::string & name, const std::vector<std::function<void()>> & callbacks);
     void clearCallbacks(const std::string & name);
 
+    template<typename... Functions> requires (Callback::fits<Functions> && ...)
+    bool emplaceCallbacks(const std::string & name, Functions &&... callbacks) //constructed in place, see emplaceTask()
+    {
+        Callbacks list;
+        list.reserve(sizeof...(Functions));
+        (list.emplace_back(std::forward<Functions>(callbacks)), ...);
+
+        return appendCallbacks(name, std::move(list));
+    }
+
     bool isRun() const;
     void run();
+    void run(std::stop_token token); //until stop() or a stop request on the token, also while there are no tasks
     void stop();
+
+    //Managed scheduler thread. start() runs run() on a std::jthread until a stop, false - it is running already.
+    //stop() wakes the scheduler at once: a callback in progress finishes, the callbacks of the tick that have not started
+    //are dropped, on the thread of run() and on the pools alike. A long callback polls stopToken() to return early.
+    //stopAndJoin() stops, joins the thread of start() and waits for the callbacks left on the pools, false - the timeout
+    //passed first, it can be called again. From a callback, on the thread of run() or on a pool, stopAndJoin() only stops
+    //and returns false at once, the callback cannot wait for itself. A run() on a thread of the caller is stopped too,
+    //stopAndJoin() returns false without waiting for it, its owner joins that thread.
+    //stop() takes no lock: it requests the token of the current run, clears the run flag and writes the wake-up eventfd.
+    bool start();
+    bool stopAndJoin(std::chrono::milliseconds timeout);
+    std::stop_token stopToken(); //of the current run, requested by stop()
+
+    //Integration with an external event loop instead of run(). The descriptor (a timerfd, Linux only, -1 elsewhere)
+    //becomes readable when a task or a timer is due or the controller was changed, processDue() fires everything
+    //that is due without blocking and re-arms it. Returns the number of fired tasks and timers, 0 while run() is active.
+    int fileDescriptor();
+    std::size_t processDue();
 };
 
 #endif // TASKSCONTROLLER_H
@@ -0,0 +1,371 @@
+#include "TimeZone.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+
+#if __cpp_lib_chrono < 201907L && defined(WIN32)
+#include <Windows.h>
+#endif
+
+using namespace std::chrono;
+
+static constexpr std::int64_t limit = duration_cast<seconds>(system_clock::duration::max()).count() - 1;
+
+static system_clock::time_point toPoint(std::int64_t utc) //the big bang entries of TZif files do not fit in system_clock
+{
+    if(utc <= -limit) return system_clock::time_point::min();
+    if(utc >= limit) return system_clock::time_point::max();
+    return system_clock::time_point(seconds(utc));
+}
+
+static std::uint32_t be32(const char * p)
+{
+    const unsigned char * u = reinterpret_cast<const unsigned char*>(p);
+    return (std::uint32_t(u[0]) << 24) | (std::uint32_t(u[1]) << 16) | (std::uint32_t(u[2]) << 8) | std::uint32_t(u[3]);
+}
+
+static std::int64_t be64(const char * p)
+{
+    return static_cast<std::int64_t>((std::uint64_t(be32(p)) << 32) | be32(p + 4));
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+TimeZone::TimeZone() : zone("UTC"), valid(true){}
+
+TimeZone::TimeZone(std::string_view name){ load(name); }
+
+bool TimeZone::isValid() const
+{
+    return valid;
+}
+
+const std::string & TimeZone::name() const
+{
+    return zone;
+}
+
+const TimeZone & TimeZone::local()
+{
+    static const TimeZone zone{std::string_view()}; //not valid - UTC
+    return zone;
+}
+
+bool TimeZone::load(std::string_view name)
+{
+    zone = name;
+    valid = false;
+    times.clear();
+    offsets.clear();
+    initial = 0;
+    rule = Rule();
+    hasRule = false;
+
+#if __cpp_lib_chrono >= 201907L
+    tz = nullptr;
+#endif
+
+    if(name == "UTC") return valid = true;
+
+    if(name.find("..") != std::string_view::npos) return false; //only names inside the database
+
+#if __cpp_lib_chrono >= 201907L
+    try
+    {
+      tz = (name.empty()) ? current_zone() : locate_zone(name);
+      return valid = true;
+    }
+    catch(const std::runtime_error &){}
+#elif defined(WIN32)
+    if(name.empty()) return valid = true; //period() asks the system
+#else
+    if(name.empty())
+    {
+       const char * env = std::getenv("TZ");
+       name = (env && *env) ? env : ":/etc/localtime";
+       if(name.front() == ':') name.remove_prefix(1);
+    }
+
+    if(!name.empty() && name.front() == '/')
+    {
+       if(loadFile(std::string(name))) return valid = true;
+    }
+    else if(!name.empty())
+    {
+       const char * dir = std::getenv("TZDIR");
+       if(loadFile(std::string((dir && *dir) ? dir : "/usr/share/zoneinfo") + "/" + std::string(name))) return valid = true;
+    }
+#endif
+
+    if(!parseRule(name, rule)) return false;
+
+    initial = rule.standard;
+    hasRule = true;
+
+    return valid = true;
+}
+
+bool TimeZone::loadFile(const std::string & path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file) return false;
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    return parseFile(data);
+}
+
+bool TimeZone::parseFile(std::string_view data) //RFC 8536
+{
+    if(data.size() < 44 || data.substr(0, 4) != "TZif") return false;
+
+    const bool v2 = data[4] >= '2';
+
+    std::uint32_t counts[6]; //isutcnt, isstdcnt, leapcnt, timecnt, typecnt, charcnt
+    auto header = [&](std::size_t at){ for(int i = 0; i < 6; i++) counts[i] = be32(data.data() + at + 20 + i * 4); };
+    auto block = [&](std::size_t timeSize){ return counts[3] * timeSize + counts[3] + counts[4] * 6 + counts[5] + counts[2] * (timeSize + 4) + counts[1] + counts[0]; };
+
+    header(0);
+
+    std::size_t at = 44;
+    std::size_t timeSize = 4;
+
+    if(v2) //the 64-bit block follows the 32-bit one
+    {
+       at += block(4);
+       if(data.size() < at + 44 || data.substr(at, 4) != "TZif") return false;
+
+       header(at);
+       at += 44;
+       timeSize = 8;
+    }
+
+    const std::uint32_t timecnt = counts[3];
+    const std::uint32_t typecnt = counts[4];
+
+    if(typecnt == 0 || data.size() < at + block(timeSize)) return false;
+
+    const char * transitions = data.data() + at;
+    const char * indexes = transitions + timecnt * timeSize;
+    const char * types = indexes + timecnt;
+
+    times.reserve(timecnt);
+    offsets.reserve(timecnt);
+
+    for(std::uint32_t i = 0; i < timecnt; i++)
+    {
+        const unsigned char type = static_cast<unsigned char>(indexes[i]);
+        if(type >= typecnt) return false;
+
+        times.push_back((timeSize == 8) ? be64(transitions + i * 8) : static_cast<std::int32_t>(be32(transitions + i * 4)));
+        offsets.push_back(static_cast<std::int32_t>(be32(types + type * 6)));
+    }
+
+    initial = static_cast<std::int32_t>(be32(types));
+
+    //----------------
+
+    if(v2) //footer, the rule for the instants after the last transition
+    {
+       const std::size_t footer = at + block(timeSize);
+
+       if(footer < data.size() && data[footer] == '\n')
+       {
+          const std::size_t close = data.find('\n', footer + 1);
+          if(close != std::string_view::npos && close > footer + 1) hasRule = parseRule(data.substr(footer + 1, close - footer - 1), rule);
+       }
+    }
+
+    return true;
+}
+
+bool TimeZone::parseRule(std::string_view value, Rule & rule)
+{
+    std::size_t at = 0;
+
+    auto digit = [&]{ return at < value.size() && value[at] >= '0' && value[at] <= '9'; };
+
+    auto number = [&](int & out)
+    {
+        if(!digit()) return false;
+        for(out = 0; digit(); at++) out = out * 10 + (value[at] - '0');
+        return true;
+    };
+
+    auto name = [&]
+    {
+        if(at < value.size() && value[at] == '<') //<+03>
+        {
+           const std::size_t close = value.find('>', at);
+           if(close == std::string_view::npos) return false;
+           at = close + 1;
+           return true;
+        }
+
+        const std::size_t from = at;
+        while(at < value.size() && ((value[at] >= 'A' && value[at] <= 'Z') || (value[at] >= 'a' && value[at] <= 'z'))) at++;
+        return at - from >= 3;
+    };
+
+    auto time = [&](std::int32_t & out) //[+-]hh[:mm[:ss]]
+    {
+        int sign = 1;
+        if(at < value.size() && (value[at] == '+' || value[at] == '-')) sign = (value[at++] == '-') ? -1 : 1;
+
+        int h, m = 0, s = 0;
+        if(!number(h)) return false;
+        if(at < value.size() && value[at] == ':'){ at++; if(!number(m)) return false; }
+        if(at < value.size() && value[at] == ':'){ at++; if(!number(s)) return false; }
+
+        out = sign * (h * 3600 + m * 60 + s);
+        return true;
+    };
+
+    auto date = [&](Rule::Date & out)
+    {
+        int a, b, c;
+
+        if(at < value.size() && value[at] == 'M') //Mm.w.d
+        {
+           at++;
+           if(!number(a) || at >= value.size() || value[at++] != '.' || !number(b) || at >= value.size() || value[at++] != '.' || !number(c)) return false;
+           if(a < 1 || a > 12 || b < 1 || b > 5 || c > 6) return false;
+
+           out.kind = 'M';
+           out.month = static_cast<unsigned char>(a);
+           out.week = static_cast<unsigned char>(b);
+           out.day = static_cast<unsigned short>(c);
+        }
+        else
+        {
+           out.kind = 0;
+           if(at < value.size() && value[at] == 'J'){ out.kind = 'J'; at++; }
+           if(!number(a) || a > 365 || (out.kind == 'J' && a < 1)) return false;
+           out.day = static_cast<unsigned short>(a);
+        }
+
+        if(at < value.size() && value[at] == '/'){ at++; return time(out.time); }
+        return true;
+    };
+
+    //----------------
+
+    std::int32_t offset;
+
+    if(!name() || !time(offset)) return false;
+
+    rule = Rule();
+    rule.standard = -offset; //POSIX offsets are west of Greenwich
+
+    if(at == value.size()) return true;
+
+    if(!name()) return false;
+
+    rule.dst = true;
+    rule.daylight = rule.standard + 3600;
+
+    if(at < value.size() && value[at] != ',')
+    {
+       if(!time(offset)) return false;
+       rule.daylight = -offset;
+    }
+
+    if(at == value.size()) //the rule of the US, as glibc does
+    {
+       rule.start = {'M', 3, 2, 0, 7200};
+       rule.end = {'M', 11, 1, 0, 7200};
+       return true;
+    }
+
+    if(value[at++] != ',' || !date(rule.start)) return false;
+    if(at >= value.size() || value[at++] != ',' || !date(rule.end)) return false;
+
+    return at == value.size();
+}
+
+std::int64_t TimeZone::changeOf(const Rule::Date & date, int year, std::int32_t offset)
+{
+    sys_days day;
+
+    if(date.kind == 'M')
+    {
+       if(date.week == 5) day = year_month_weekday_last(::year(year), ::month(date.month), weekday_last(weekday(date.day)));
+       else day = year_month_weekday(::year(year), ::month(date.month), weekday(date.day)[date.week]);
+    }
+    else if(date.kind == 'J') day = sys_days(::year(year) / January / 1) + days(date.day - 1 + ((date.day >= 60 && ::year(year).is_leap()) ? 1 : 0));
+    else day = sys_days(::year(year) / January / 1) + days(date.day);
+
+    return duration_cast<seconds>(day.time_since_epoch()).count() + date.time - offset; //the change is given in the local time before it
+}
+
+TimeZone::Period TimeZone::rulePeriod(std::int64_t utc) const
+{
+    const std::int64_t last = (times.empty()) ? -limit : times.back();
+
+    if(!rule.dst) return {toPoint(last), system_clock::time_point::max(), seconds(rule.standard)};
+
+    struct Change
+    {
+        std::int64_t time;
+        std::int32_t offset;
+    };
+
+    Change changes[6];
+
+    const int year = static_cast<int>(year_month_day(floor<days>(sys_seconds(seconds(utc + rule.standard)))).year());
+
+    for(int i = 0; i < 3; i++)
+    {
+        changes[i * 2] = {changeOf(rule.start, year - 1 + i, rule.standard), rule.daylight};
+        changes[i * 2 + 1] = {changeOf(rule.end, year - 1 + i, rule.daylight), rule.standard};
+    }
+
+    std::sort(std::begin(changes), std::end(changes), [](const Change & a, const Change & b){ return a.time < b.time; });
+
+    std::size_t i = 0;
+    while(i < 6 && changes[i].time <= utc) i++;
+
+    Period period;
+    period.begin = toPoint(std::max(last, (i > 0) ? changes[i - 1].time : -limit));
+    period.end = (i < 6) ? toPoint(changes[i].time) : system_clock::time_point::max();
+    period.offset = seconds((i > 0) ? changes[i - 1].offset : changes[5].offset); //the year before covers the instant, i > 0
+
+    return period;
+}
+
+TimeZone::Period TimeZone::period(system_clock::time_point utc) const
+{
+#if __cpp_lib_chrono >= 201907L
+    if(tz)
+    {
+       const sys_info info = tz->get_info(utc);
+       return {toPoint(info.begin.time_since_epoch().count()), toPoint(info.end.time_since_epoch().count()), info.offset};
+    }
+#elif defined(WIN32)
+    if(valid && zone.empty()) //the rules of the system are not read, the period is a quarter of an hour
+    {
+       TIME_ZONE_INFORMATION info;
+       const DWORD id = GetTimeZoneInformation(&info);
+       if(id == TIME_ZONE_ID_INVALID) return {system_clock::time_point::min(), system_clock::time_point::max(), seconds(0)};
+
+       const LONG bias = info.Bias + ((id == TIME_ZONE_ID_DAYLIGHT) ? info.DaylightBias : 0);
+       const auto begin = floor<minutes>(utc) - floor<minutes>(utc).time_since_epoch() % minutes(15);
+
+       return {begin, begin + minutes(15), minutes(-bias)};
+    }
+#endif
+
+    const std::int64_t time = floor<seconds>(utc).time_since_epoch().count();
+    const std::size_t i = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+
+    if(i == times.size() && hasRule) return rulePeriod(time);
+
+    Period period;
+    period.begin = (i > 0) ? toPoint(times[i - 1]) : system_clock::time_point::min();
+    period.end = (i < times.size()) ? toPoint(times[i]) : system_clock::time_point::max();
+    period.offset = seconds((i > 0) ? offsets[i - 1] : initial);
+
+    return period;
+}
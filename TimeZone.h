@@ -0,0 +1,83 @@
+#ifndef TIMEZONE_H
+#define TIMEZONE_H
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+/* Time zone, the UTC offset at an instant and the instants between which it holds
+
+   C++20 tzdb (locate_zone) where the standard library has it, otherwise the TZif files of the
+   IANA database ($TZDIR or /usr/share/zoneinfo) with the POSIX TZ rule of their footer for the
+   years after the last transition. Windows without tzdb only knows the zone of the system.
+
+   name: "Europe/Berlin", "UTC", a POSIX TZ rule ("CET-1CEST,M3.5.0,M10.5.0/3"), "" - zone of the system ($TZ, /etc/localtime)
+
+   A loaded zone does not change, period() may be called from any thread.
+   The callers keep the last Period and look the zone up again only when the instant leaves it.
+*/
+
+class TimeZone final
+{
+public:
+
+    struct Period
+    {
+        std::chrono::system_clock::time_point begin; //UTC, the offset holds in [begin, end)
+        std::chrono::system_clock::time_point end;   //max() - no later change
+        std::chrono::seconds offset; //local time = UTC + offset
+    };
+
+    explicit TimeZone(); //UTC
+    explicit TimeZone(std::string_view name);
+
+    bool isValid() const;
+    const std::string & name() const;
+    bool load(std::string_view name);
+
+    Period period(std::chrono::system_clock::time_point utc) const;
+
+    static const TimeZone & local(); //zone of the system, loaded once
+
+private:
+
+    struct Rule //POSIX TZ rule: std offset[dst[offset][,start[/time],end[/time]]]
+    {
+        struct Date
+        {
+            unsigned char kind = 0; //'J' - Julian day without Feb 29, 'M' - month.week.weekday, 0 - zero-based day of the year
+            unsigned char month = 0;
+            unsigned char week = 0; //5 - the last one
+            unsigned short day = 0; //weekday for 'M'
+            std::int32_t time = 7200; //local time of the change, seconds
+        };
+
+        std::int32_t standard = 0; //UTC offset
+        std::int32_t daylight = 0;
+        bool dst = false;
+        Date start, end;
+    };
+
+    std::string zone;
+    bool valid = false;
+
+#if __cpp_lib_chrono >= 201907L
+    const std::chrono::time_zone * tz = nullptr;
+#endif
+
+    std::vector<std::int64_t> times; //UTC of the transitions, ascending
+    std::vector<std::int32_t> offsets; //offset from times[i]
+    std::int32_t initial = 0; //before the first transition
+    Rule rule;
+    bool hasRule = false; //after the last transition, otherwise its offset stays
+
+    bool loadFile(const std::string & path);
+    bool parseFile(std::string_view data);
+    static bool parseRule(std::string_view value, Rule & rule);
+    static std::int64_t changeOf(const Rule::Date & date, int year, std::int32_t offset);
+    Period rulePeriod(std::int64_t utc) const;
+};
+
+#endif // TIMEZONE_H
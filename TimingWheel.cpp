@@ -0,0 +1,262 @@
+#include "TimingWheel.h"
+
+#include <bit>
+
+TimingWheel::TimingWheel(std::chrono::milliseconds resolution) : origin(Clock::now()),
+                                                                 resolution((resolution.count() > 0) ? resolution : std::chrono::milliseconds(1))
+{
+    heads.fill(npos);
+    for(auto & level : occupied) level.fill(0);
+}
+
+TimingWheel::Timer TimingWheel::add(Clock::duration delay, std::function<void()> callback)
+{
+    return add(Clock::now(), delay, std::move(callback));
+}
+
+TimingWheel::Timer TimingWheel::add(Clock::time_point now, Clock::duration delay, std::function<void()> callback)
+{
+    if(!callback) return 0;
+
+    std::uint64_t expires = current + 1;
+
+    {
+      auto duration = now + delay - origin;
+      if(duration.count() > 0)
+      {
+         std::uint64_t ticks = (duration.count() + resolution.count() - 1) / resolution.count(); //never fires early
+         if(ticks > expires) expires = ticks;
+      }
+    }
+
+    std::uint32_t index;
+
+    if(freeNodes != npos)
+    {
+       index = freeNodes;
+       freeNodes = nodes[index].next;
+    }
+    else
+    {
+       index = static_cast<std::uint32_t>(nodes.size());
+       nodes.emplace_back();
+    }
+
+    Node & node = nodes[index];
+    node.expires = expires;
+    node.active = true;
+    node.callback = std::move(callback);
+
+    link(index);
+    count++;
+
+    return (static_cast<std::uint64_t>(node.generation) << 32) | index;
+}
+
+bool TimingWheel::cancel(Timer timer)
+{
+    if(!contains(timer)) return false;
+
+    std::uint32_t index = static_cast<std::uint32_t>(timer);
+    unlink(index);
+    release(index);
+    count--;
+
+    return true;
+}
+
+bool TimingWheel::contains(Timer timer) const
+{
+    std::uint32_t index = static_cast<std::uint32_t>(timer);
+    if(timer == 0 || index >= nodes.size()) return false;
+
+    const Node & node = nodes[index];
+    return node.active && node.generation == static_cast<std::uint32_t>(timer >> 32);
+}
+
+void TimingWheel::clear()
+{
+    nodes.clear();
+    freeNodes = npos;
+    heads.fill(npos);
+    for(auto & level : occupied) level.fill(0);
+    count = 0;
+}
+
+std::size_t TimingWheel::size() const
+{
+    return count;
+}
+
+bool TimingWheel::empty() const
+{
+    return count == 0;
+}
+
+TimingWheel::Clock::time_point TimingWheel::nextExpiry() const
+{
+    if(count == 0) return Clock::time_point::max();
+
+    std::uint64_t next = current + 1;
+
+    if(next & (slots - 1))
+    {
+       int index = nextOccupied(0, next & (slots - 1));
+       next = (index < 0) ? ((next | (slots - 1)) + 1) : ((next & ~std::uint64_t(slots - 1)) + index);
+    }
+
+    return origin + resolution * next;
+}
+
+std::size_t TimingWheel::advance(Clock::time_point now, std::vector<std::function<void()>> & expired)
+{
+    const std::uint64_t target = tickOf(now);
+    const std::size_t before = expired.size();
+
+    while(current < target)
+    {
+       if(count == 0)
+       {
+          current = target;
+          break;
+       }
+
+       std::uint64_t next = current + 1;
+
+       if(next & (slots - 1)) //skip empty slots up to the next occupied one or the next cascade
+       {
+          int index = nextOccupied(0, next & (slots - 1));
+          next = (index < 0) ? ((next | (slots - 1)) + 1) : ((next & ~std::uint64_t(slots - 1)) + index);
+
+          if(next > target)
+          {
+             current = target;
+             break;
+          }
+       }
+
+       current = next;
+
+       if((current & (slots - 1)) == 0)
+       {
+          for(unsigned level = 1; level < levels; level++)
+          {
+              cascade(level);
+              if(((current >> (bits * level)) & (slots - 1)) != 0) break;
+          }
+       }
+
+       expire(expired);
+    }
+
+    return expired.size() - before;
+}
+
+void TimingWheel::link(std::uint32_t index)
+{
+    Node & node = nodes[index];
+
+    std::uint64_t expires = node.expires;
+    std::uint64_t diff = expires - current;
+    unsigned level = 0;
+
+    if(diff >= (std::uint64_t(1) << (bits * levels))) //longer than one rotation of the top level
+    {
+       expires = current + (std::uint64_t(1) << (bits * levels)) - 1;
+       level = levels - 1;
+    }
+    else while(diff >= (std::uint64_t(1) << (bits * (level + 1)))) level++;
+
+    unsigned slot = static_cast<unsigned>((expires >> (bits * level)) & (slots - 1));
+
+    node.slot = static_cast<std::uint16_t>(level * slots + slot);
+    node.prev = npos;
+    node.next = heads[node.slot];
+
+    if(node.next != npos) nodes[node.next].prev = index;
+    heads[node.slot] = index;
+
+    occupied[level][slot / 64] |= std::uint64_t(1) << (slot % 64);
+}
+
+void TimingWheel::unlink(std::uint32_t index)
+{
+    Node & node = nodes[index];
+
+    if(node.prev != npos) nodes[node.prev].next = node.next;
+    else heads[node.slot] = node.next;
+
+    if(node.next != npos) nodes[node.next].prev = node.prev;
+
+    if(heads[node.slot] == npos)
+    {
+       unsigned level = node.slot / slots, slot = node.slot % slots;
+       occupied[level][slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+    }
+}
+
+void TimingWheel::release(std::uint32_t index)
+{
+    Node & node = nodes[index];
+
+    node.callback = nullptr;
+    node.active = false;
+    if(++node.generation == 0) node.generation = 1;
+
+    node.next = freeNodes;
+    freeNodes = index;
+}
+
+void TimingWheel::cascade(unsigned level)
+{
+    unsigned slot = static_cast<unsigned>((current >> (bits * level)) & (slots - 1));
+    std::uint32_t index = heads[level * slots + slot];
+
+    heads[level * slots + slot] = npos;
+    occupied[level][slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+
+    while(index != npos)
+    {
+        std::uint32_t next = nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+void TimingWheel::expire(std::vector<std::function<void()>> & expired)
+{
+    unsigned slot = static_cast<unsigned>(current & (slots - 1));
+    std::uint32_t index = heads[slot];
+
+    heads[slot] = npos;
+    occupied[0][slot / 64] &= ~(std::uint64_t(1) << (slot % 64));
+
+    while(index != npos)
+    {
+        std::uint32_t next = nodes[index].next;
+
+        expired.push_back(std::move(nodes[index].callback));
+        release(index);
+        count--;
+
+        index = next;
+    }
+}
+
+int TimingWheel::nextOccupied(unsigned level, unsigned from) const
+{
+    for(unsigned word = from / 64; word < slots / 64; word++)
+    {
+        std::uint64_t mask = occupied[level][word];
+        if(word == from / 64) mask &= ~std::uint64_t(0) << (from % 64);
+        if(mask) return static_cast<int>(word * 64 + std::countr_zero(mask));
+    }
+
+    return -1;
+}
+
+std::uint64_t TimingWheel::tickOf(Clock::time_point time) const
+{
+    if(time <= origin) return 0;
+    return static_cast<std::uint64_t>((time - origin) / resolution);
+}
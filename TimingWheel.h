@@ -0,0 +1,81 @@
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+/* Hierarchical timing wheel
+
+   4 levels x 256 slots, level 0 has the resolution given to the constructor (1 ms by default),
+   so one rotation of the top level covers 2^32 ticks (~49 days at 1 ms), longer delays are
+   parked in the top level and cascaded again.
+
+   add/cancel - O(1), timers are nodes of intrusive lists inside one pool, the pool grows and is reused
+   advance    - O(expired + cascaded), empty slots are skipped through occupancy bitmaps
+
+   Not thread safe, TasksController protects it with its own mutex.
+*/
+
+class TimingWheel final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Timer = std::uint64_t; //0 - invalid timer
+
+    explicit TimingWheel(std::chrono::milliseconds resolution = std::chrono::milliseconds(1));
+
+    Timer add(Clock::duration delay, std::function<void()> callback);
+    Timer add(Clock::time_point now, Clock::duration delay, std::function<void()> callback);
+    bool cancel(Timer timer);
+    bool contains(Timer timer) const;
+    void clear();
+
+    std::size_t size() const;
+    bool empty() const;
+
+    //Time point at which advance() may have work, Clock::time_point::max() if the wheel is empty
+    Clock::time_point nextExpiry() const;
+
+    //Moves the wheel to now and appends callbacks of the expired timers
+    std::size_t advance(Clock::time_point now, std::vector<std::function<void()>> & expired);
+
+private:
+    static constexpr unsigned levels = 4;
+    static constexpr unsigned bits = 8;
+    static constexpr unsigned slots = 1u << bits;
+    static constexpr std::uint32_t npos = 0xFFFFFFFF;
+
+    struct Node
+    {
+        std::uint64_t expires = 0;
+        std::uint32_t prev = npos;
+        std::uint32_t next = npos;
+        std::uint32_t generation = 1;
+        std::uint16_t slot = 0; //level * slots + index
+        bool active = false;
+        std::function<void()> callback;
+    };
+
+    Clock::time_point origin;
+    Clock::duration resolution;
+    std::uint64_t current = 0;
+    std::size_t count = 0;
+
+    std::vector<Node> nodes;
+    std::uint32_t freeNodes = npos;
+    std::array<std::uint32_t, levels * slots> heads;
+    std::array<std::array<std::uint64_t, slots / 64>, levels> occupied;
+
+    void link(std::uint32_t index);
+    void unlink(std::uint32_t index);
+    void release(std::uint32_t index);
+    void cascade(unsigned level);
+    void expire(std::vector<std::function<void()>> & expired);
+    int nextOccupied(unsigned level, unsigned from) const;
+    std::uint64_t tickOf(Clock::time_point time) const;
+};
+
+#endif // TIMINGWHEEL_H
@@ -0,0 +1,388 @@
+/* Task footprint and taskCalculate() cost, compared with the previous closure representation, and the next fire
+   of a cron expression against the weekday points it replaces, one JSON object per line on stdout
+
+   The closure layout is the Task before the compact record: its type, the deadline and a
+   std::function<bool(const Now &, Now &, bool)> built by the pattern functions below, kept as they were.
+
+   footprint - bytes of a schedule and heap allocations per copy of 1M schedules of 8 patterns
+   evaluate  - taskCalculate() per check of the same schedules
+   cron      - next fire of C 0 0-59/5 9-17 * * MON-FRI against a check of the 540 W points of the same schedule
+
+   target: TaskBenchmark (CMake option TASKSCONTROLLER_BENCHMARKS)
+*/
+
+#include "TasksController.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace std::chrono;
+using Now = system_clock::time_point;
+using Calculate = std::function<bool(const Now &, Now &, bool)>;
+
+static std::size_t allocations = 0;
+static volatile std::size_t sink = 0; //the fire counts are stored, the checks are not optimized away
+
+void * operator new(std::size_t size)
+{
+    allocations++;
+    if(void * p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size){ return ::operator new(size); }
+
+//Out of line: inlined into a caller, GCC pairs the free() with the operator new call and warns (-Wmismatched-new-delete)
+[[gnu::noinline]] void operator delete(void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { ::operator delete(p); }
+void operator delete[](void * p) noexcept { ::operator delete(p); }
+void operator delete[](void * p, std::size_t) noexcept { ::operator delete(p); }
+
+//------------------Previous layout-------------------
+
+struct ClosureTask
+{
+    Task::Type type = Task::Point;
+    Now finish;
+    Calculate calculate = nullptr;
+
+    bool taskCalculate(const Now & now, bool recalc){ return calculate(now, finish, recalc); }
+};
+
+static inline system_clock::time_point GetFromDate(const unsigned char day, const unsigned char month, const unsigned int year)
+{
+    return system_clock::time_point{sys_days{year_month_day{::year(year), ::month(month), ::day(day)}}.time_since_epoch()};
+}
+
+static inline system_clock::time_point GetFromWeekDate(const unsigned char index, const unsigned char weekday, const month month, const year year)
+{
+    return {sys_days{year_month_weekday{year, month, weekday_indexed(::weekday(weekday), index)}}};
+}
+
+static inline system_clock::time_point GetOnlyDateFromPoint(const Now & now)
+{
+    return system_clock::time_point{sys_days{year_month_day{floor<days>(now)}}.time_since_epoch()};
+}
+
+static void dayPattern(Calculate & calculate, Now & finish, const unsigned char day, const system_clock::time_point & now, const seconds & sum)
+{
+    int year;
+    unsigned char month;
+
+    {
+      year_month_day ymd(floor<days>(now));
+      year = static_cast<int>(ymd.year());
+      month = static_cast<unsigned>(ymd.month());
+    }
+
+    while(!month_day(::month(month), ::day(day)).ok()) month++;
+    finish = GetFromDate(day, month, year) + sum;
+
+    if(now > finish)
+    {
+       month++;
+       if(month <= 12)
+       {
+          while(!month_day(::month(month), ::day(day)).ok()) month++;
+          finish = GetFromDate(day, month, year) + sum;
+       }
+       else finish = GetFromDate(day, 1, year + 1) + sum;
+    }
+
+    calculate = [day, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          int year;
+          unsigned char month;
+
+          {
+            year_month_day ymd(floor<days>(now));
+            year = static_cast<int>(ymd.year());
+            month = static_cast<unsigned>(ymd.month()) + 1;
+          }
+
+          if(month <= 12)
+          {
+             while(!month_day(::month(month), ::day(day)).ok()) month++;
+             finish = GetFromDate(day, month, year) + sum;
+          }
+          else finish = GetFromDate(day, 1, year + 1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void dayMonthPattern(Calculate & calculate, Now & finish, const unsigned char day, const unsigned char month, const system_clock::time_point & now, const seconds & sum)
+{
+    int year = static_cast<int>(year_month_day(floor<days>(now)).year());
+    while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
+    finish = GetFromDate(day, month, year) + sum;
+
+    if(now > finish)
+    {
+       year++;
+       while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
+       finish = GetFromDate(day, month, year) + sum;
+    }
+
+    calculate = [day, month, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          int year = static_cast<int>(year_month_day(floor<days>(now)).year()) + 1;
+          while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
+          finish = GetFromDate(day, month, year) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void weekdayPattern(Calculate & calculate, Now & finish, const unsigned char weekday, const system_clock::time_point & now, const seconds & sum)
+{
+    const unsigned char c_weekday = (weekday == 7) ? 0 : weekday;
+    year_month_weekday cw{floor<days>(now)};
+    finish = GetFromWeekDate(cw.weekday_indexed().index(), c_weekday, cw.month(), cw.year()) + sum;
+
+    if(now > finish) finish = GetFromWeekDate(cw.weekday_indexed().index() + 1, c_weekday, cw.month(), cw.year()) + sum;
+
+    calculate = [c_weekday, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          year_month_weekday cw{floor<days>(now)};
+          finish = GetFromWeekDate(cw.weekday_indexed().index(), c_weekday, cw.month(), cw.year()) + sum;
+          if(now > finish) finish = GetFromWeekDate(cw.weekday_indexed().index() + 1, c_weekday, cw.month(), cw.year()) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void monthPattern(Calculate & calculate, Now & finish, const unsigned char month, const system_clock::time_point & now, const seconds & sum)
+{
+    year_month_day ymd(floor<days>(now));
+    finish = GetFromDate(1, month, static_cast<int>(ymd.year())) + sum;
+
+    if(now > finish) finish = GetFromDate(1, month, static_cast<int>(ymd.year()) + 1) + sum;
+
+    calculate = [month, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          year_month_day ymd(floor<days>(now));
+          finish = GetFromDate(1, month, static_cast<int>(ymd.year()) + 1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void hoursPattern(Calculate & calculate, Now & finish, const system_clock::time_point & now, const seconds & sum)
+{
+    finish = GetOnlyDateFromPoint(now) + sum;
+
+    if(now > finish) finish += days(1);
+
+    calculate = [sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          finish = GetOnlyDateFromPoint(now) + days(1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void minutesPattern(Calculate & calculate, Now & finish, const system_clock::time_point & now, const seconds & sum)
+{
+    auto onlyDate = GetOnlyDateFromPoint(now);
+    hh_mm_ss time(now - onlyDate);
+    finish = onlyDate + time.hours() + sum;
+
+    if(now > finish) finish += ::hours(1);
+
+    calculate = [sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          system_clock::time_point date = GetOnlyDateFromPoint(now);
+          hh_mm_ss time(now - date);
+          finish = date + time.hours() + ::hours(1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void secondsPattern(Calculate & calculate, Now & finish, const system_clock::time_point & now, const seconds & s_seconds) //the seconds branch of onlyTimePattern()
+{
+    auto onlyDate = GetOnlyDateFromPoint(now);
+    hh_mm_ss time(now - onlyDate);
+    finish = onlyDate + time.hours() + time.minutes() + s_seconds;
+
+    if(now > finish) finish += ::minutes(1);
+
+    calculate = [s_seconds](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          system_clock::time_point date = GetOnlyDateFromPoint(now);
+          hh_mm_ss time(now - date);
+          finish = date + time.hours() + time.minutes() + ::minutes(1) + s_seconds;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void intervalPattern(Calculate & calculate, Now & finish, const system_clock::time_point & now, const seconds & interval) //intervalTaskInit()
+{
+    finish = now + interval;
+
+    calculate = [interval](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          finish = now + interval;
+
+          return !recalc;
+       }
+       else return false;
+    };
+}
+
+static ClosureTask closureTask(std::size_t format, const Now & now) //the schedule of formats[format]
+{
+    ClosureTask task;
+
+    switch(format)
+    {
+       case 0: dayMonthPattern(task.calculate, task.finish, 14, 11, now, hours(15) + minutes(44) + seconds(32)); break;
+       case 1: dayPattern(task.calculate, task.finish, 5, now, hours(15) + minutes(35) + seconds(1)); break;
+       case 2: monthPattern(task.calculate, task.finish, 11, now, seconds(0)); break;
+       case 3: weekdayPattern(task.calculate, task.finish, 2, now, hours(15) + minutes(44) + seconds(32)); break;
+       case 4: hoursPattern(task.calculate, task.finish, now, hours(15)); break;
+       case 5: minutesPattern(task.calculate, task.finish, now, minutes(35) + seconds(15)); break;
+       case 6: secondsPattern(task.calculate, task.finish, now, seconds(35)); break;
+       default: intervalPattern(task.calculate, task.finish, now, days(1)); break;
+    }
+
+    return task;
+}
+
+int main()
+{
+    constexpr std::size_t count = 1000000;
+    const char * formats[] = {"P 14/11 15:44:32", "P 05/00 15:35:01", "P 00/11 00:00:00", "W 2 15:44:32",
+                              "P 00/00 15:00:00", "P 00/00 00:35:15", "P 00/00 00:00:35", "I 00001 00:00:00"};
+
+    //------------------Footprint-------------------------
+
+    const Now local = system_clock::now();
+
+    std::vector<Task> tasks;
+    std::vector<ClosureTask> closures;
+
+    for(std::size_t i = 0; i < count; i++)
+    {
+        tasks.emplace_back(formats[i % std::size(formats)]);
+        closures.push_back(closureTask(i % std::size(formats), local));
+    }
+
+    std::size_t before = allocations;
+    std::vector<Task> taskCopies(tasks);
+    std::size_t taskAllocations = allocations - before;
+
+    before = allocations;
+    std::vector<ClosureTask> closureCopies(closures);
+    std::size_t closureAllocations = allocations - before;
+
+    std::printf("{\"benchmark\":\"footprint\",\"layout\":\"task\",\"bytes\":%zu,\"allocations_per_copy\":%.2f}\n",
+                sizeof(Task), double(taskAllocations - 1) / count);
+    std::printf("{\"benchmark\":\"footprint\",\"layout\":\"closure\",\"bytes\":%zu,\"allocations_per_copy\":%.2f}\n",
+                sizeof(ClosureTask), double(closureAllocations - 1) / count);
+
+    taskCopies = {};
+    closureCopies = {};
+
+    //------------------Evaluation------------------------
+
+    //the clock the scheduler passes, the overload without it reads TaskClock::current() per call
+    Now now = local;
+    Task::Steady steady = steady_clock::now();
+    std::size_t fired = 0;
+
+    auto start = steady_clock::now();
+    for(int round = 0; round < 10; round++)
+    {
+        now += seconds(1);
+        steady += seconds(1);
+        for(auto & t : tasks) fired += t.taskCalculate(now, steady, false);
+    }
+    double taskNs = duration<double, std::nano>(steady_clock::now() - start).count() / (10.0 * count);
+
+    now = local;
+    start = steady_clock::now();
+    for(int round = 0; round < 10; round++)
+    {
+        now += seconds(1);
+        for(auto & c : closures) fired += c.taskCalculate(now, false);
+    }
+    double closureNs = duration<double, std::nano>(steady_clock::now() - start).count() / (10.0 * count);
+
+    std::printf("{\"benchmark\":\"evaluate\",\"layout\":\"task\",\"schedules\":%zu,\"check_ns\":%.2f}\n", count, taskNs);
+    std::printf("{\"benchmark\":\"evaluate\",\"layout\":\"closure\",\"schedules\":%zu,\"check_ns\":%.2f}\n", count, closureNs);
+
+    //------------------Cron expression-------------------
+
+    //every 5 minutes from 09:00 to 17:55 on working days: one cron task or 540 weekday points
+    Task cron("C 0 0-59/5 9-17 * * MON-FRI");
+
+    tasks.clear();
+    for(int weekday = 1; weekday <= 5; weekday++)
+        for(int hour = 9; hour <= 17; hour++)
+            for(int minute = 0; minute < 60; minute += 5)
+            {
+                char format[16];
+                std::snprintf(format, sizeof(format), "W %d %02d:%02d:00", weekday, hour, minute);
+                tasks.emplace_back(format);
+            }
+
+    now = system_clock::now();
+    start = steady_clock::now();
+    for(std::size_t i = 0; i < count; i++)
+    {
+        now += minutes(7);
+        steady += minutes(7);
+        fired += cron.taskCalculate(now, steady, true);
+    }
+    double cronNs = duration<double, std::nano>(steady_clock::now() - start).count() / count;
+
+    now = system_clock::now();
+    start = steady_clock::now();
+    for(int round = 0; round < 100; round++)
+    {
+        now += seconds(1);
+        steady += seconds(1);
+        for(auto & t : tasks) fired += t.taskCalculate(now, steady, false);
+    }
+    double pointsNs = duration<double, std::nano>(steady_clock::now() - start).count() / 100;
+
+    std::printf("{\"benchmark\":\"cron\",\"next_ns\":%.2f,\"points\":%zu,\"points_check_ns\":%.2f}\n", cronNs, tasks.size(), pointsNs);
+
+    sink = fired;
+
+    return 0;
+}
@@ -0,0 +1,707 @@
+/* Benchmark suite, one JSON object per line on stdout
+
+   parse     - Task::parseFromString throughput per format
+   calculate - Task::taskCalculate cost per pattern, the not-due check and the next-fire recalculation
+   tick      - CPU time of the run() thread per tick with 1k/100k/1M registered tasks
+   latency   - fire lateness (actual - scheduled) under callback load, inline and on a pool
+   precision - fire lateness distribution of millisecond schedules, default and precision mode
+   await     - resumption of 10k coroutines suspended on nextFire() of one task
+   shards    - time to fire 100k tasks due in the same second with 1 to 16 shards
+   store     - 100k tasks: logged bulk add, snapshot, restart from the snapshot against parsing the schedules again
+   metrics   - overhead of setMetrics(): tasks due in the same second fired with the metrics off, on and per task
+   register  - 100k tasks with a capturing callback: addTask() with std::function, emplaceTask(), addTasks() of one range
+   replay    - 100k daily, weekly, monthly and cron schedules fired through 30 days of a ManualClock with advanceClock()
+   preview   - the same 100k tasks: nextOccurrences() of one task, firesInWindow() over an hour and over a day
+   lanes     - lateness of one heartbeat due with 2000 bulk callbacks: same lane, Critical lane, Critical lane with its own worker
+   splay     - 100k hourly tasks created together, peak fires per second in fireDensity() and fired through 2 hours, windows 0/60/600 s
+   shutdown  - stopAndJoin() of a started controller in the middle of 2000 callbacks of 200 us, inline and on a pool
+   lease     - 3 replicas with the same 30k tasks on one FileLease: fires of each through a minute with HashRange, cost of renew()
+
+   target: TasksControllerBenchmark (CMake option TASKSCONTROLLER_BENCHMARKS)
+   usage:  TasksControllerBenchmark [--quick]   (--quick skips the 1M tick run and fires 20k tasks in shards)
+*/
+
+#include "TasksController.h"
+#include "ShardedTasksController.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <filesystem>
+#include <thread>
+
+#ifndef WIN32
+#include <time.h>
+#endif
+
+using namespace std::chrono;
+
+static double secondsFrom(steady_clock::time_point start)
+{
+    return duration<double>(steady_clock::now() - start).count();
+}
+
+static double threadCpuSeconds()
+{
+#ifndef WIN32
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#else
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static double percentile(std::vector<double> & values, double p)
+{
+    if(values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[static_cast<std::size_t>(p * (values.size() - 1))];
+}
+
+//------------------parse-----------------------------
+
+static void benchmarkParse()
+{
+    const char * formats[][2] = {{"P", "P 14/11 15:44:32"}, {"SP", "SP 05/11 15:35:01"}, {"W", "W 2 15:44:32"},
+                                 {"SW", "SW 7 23:59:59"}, {"I", "I 00003 15:23:05"}, {"SI", "SI 00000 00:00:30"}};
+
+    constexpr int count = 200000;
+    Task task;
+
+    for(auto & format : formats)
+    {
+        auto start = steady_clock::now();
+        for(int i = 0; i < count; i++) task.parseFromString(format[1]);
+        double seconds = secondsFrom(start);
+
+        std::printf("{\"benchmark\":\"parse\",\"format\":\"%s\",\"ops_per_s\":%.0f,\"ns_per_op\":%.1f}\n",
+                    format[0], count / seconds, seconds * 1e9 / count);
+    }
+}
+
+//------------------calculate-------------------------
+
+static void benchmarkCalculate()
+{
+    const char * patterns[][2] = {{"day", "P 05/00 15:35:01"}, {"day_month", "P 14/11 15:44:32"}, {"weekday", "W 2 15:44:32"},
+                                  {"month", "P 00/11 00:00:00"}, {"hours", "P 00/00 15:00:00"}, {"minutes", "P 00/00 00:35:15"},
+                                  {"seconds", "P 00/00 00:00:35"}, {"interval", "I 00001 00:00:00"}};
+
+    constexpr int count = 1000000;
+    std::vector<Task> tasks;
+
+    for(auto & pattern : patterns)
+    {
+        tasks.assign(1000, Task(pattern[1]));
+        Task::Now now = system_clock::now();
+        std::size_t fired = 0;
+
+        auto start = steady_clock::now();
+        for(int i = 0; i < count; i++) fired += tasks[i % tasks.size()].taskCalculate(now, false);
+        double check = secondsFrom(start);
+
+        start = steady_clock::now();
+        for(int i = 0; i < count; i++) tasks[i % tasks.size()].taskCalculate(now, true);
+        double recalc = secondsFrom(start);
+
+        std::printf("{\"benchmark\":\"calculate\",\"pattern\":\"%s\",\"check_ns\":%.2f,\"recalc_ns\":%.2f,\"fired\":%zu}\n",
+                    pattern[0], check * 1e9 / count, recalc * 1e9 / count, fired);
+    }
+}
+
+//------------------tick------------------------------
+
+static void benchmarkTick(std::size_t count)
+{
+    TasksController controller;
+
+    std::string lines;
+    lines.reserve(count * 24);
+    for(std::size_t i = 0; i < count; i++) lines += "idle" + std::to_string(i) + "\tI 65535 00:00:00\n"; //registered, never due
+
+    auto start = steady_clock::now();
+    controller.loadTasks(lines);
+    double load = secondsFrom(start);
+
+    constexpr int ticks = 4;
+    std::vector<double> cpu;
+    std::atomic_int fired = 0;
+
+    controller.addTask("probe", "I 00000 00:00:01", [&]
+    {
+        cpu.push_back(threadCpuSeconds()); //inline callback - runs on the thread of run()
+        if(++fired > ticks) controller.stop();
+    });
+
+    controller.run();
+
+    std::vector<double> perTick;
+    for(std::size_t i = 1; i < cpu.size(); i++) perTick.push_back((cpu[i] - cpu[i - 1]) * 1e6);
+
+    std::printf("{\"benchmark\":\"tick\",\"tasks\":%zu,\"load_ms\":%.1f,\"cpu_us_per_tick\":%.2f}\n",
+                count, load * 1e3, percentile(perTick, 0.5));
+}
+
+//------------------latency---------------------------
+
+static void benchmarkLatency(unsigned threads)
+{
+    constexpr int tasks = 2000;
+    constexpr auto work = microseconds(200); //callback load
+
+    TasksController controller(10, threads);
+
+    std::vector<double> lateness;
+    std::mutex mutex;
+    std::atomic_int done = 0;
+
+    for(int i = 0; i < tasks; i++)
+    {
+        const auto scheduled = system_clock::now() + seconds(1);
+
+        controller.addTask("task" + std::to_string(i), "SI 00000 00:00:01", [&, scheduled]
+        {
+            double late = duration<double, std::micro>(system_clock::now() - scheduled).count();
+
+            for(auto start = steady_clock::now(); steady_clock::now() - start < work;);
+
+            std::lock_guard<std::mutex>lock(mutex);
+            lateness.push_back(late);
+            if(++done == tasks) controller.stop();
+        });
+    }
+
+    controller.run();
+
+    std::lock_guard<std::mutex>lock(mutex);
+    std::printf("{\"benchmark\":\"latency\",\"threads\":%u,\"fires\":%zu,\"callback_us\":%lld,\"p50_us\":%.0f,\"p99_us\":%.0f,\"max_us\":%.0f}\n",
+                threads, lateness.size(), static_cast<long long>(work.count()),
+                percentile(lateness, 0.5), percentile(lateness, 0.99), percentile(lateness, 1.0));
+}
+
+//------------------precision-------------------------
+
+static void benchmarkPrecision(bool precise)
+{
+    constexpr int tasks = 200;
+    constexpr int step = 7; //ms between the deadlines, so every fire is a separate wake-up
+
+    TasksController controller;
+    if(precise && !controller.setPrecise(true)) return;
+
+    std::vector<double> lateness;
+    lateness.reserve(tasks);
+    std::atomic_int done = 0;
+
+    for(int i = 0; i < tasks; i++)
+    {
+        const int delay = 20 + i * step;
+
+        char value[32];
+        std::snprintf(value, sizeof(value), "SI 00000 00:00:%02d.%03d", delay / 1000, delay % 1000);
+
+        const auto scheduled = system_clock::now() + milliseconds(delay);
+
+        controller.addTask("task" + std::to_string(i), value, [&, scheduled]
+        {
+            lateness.push_back(duration<double, std::micro>(system_clock::now() - scheduled).count()); //inline, no lock needed
+            if(++done == tasks) controller.stop();
+        });
+    }
+
+    controller.run();
+
+    std::printf("{\"benchmark\":\"precision\",\"mode\":\"%s\",\"fires\":%zu,\"p50_us\":%.0f,\"p90_us\":%.0f,\"p99_us\":%.0f,\"max_us\":%.0f}\n",
+                precise ? "precise" : "default", lateness.size(), percentile(lateness, 0.5),
+                percentile(lateness, 0.9), percentile(lateness, 0.99), percentile(lateness, 1.0));
+}
+
+//------------------await-----------------------------
+
+struct Detached //fire-and-forget coroutine
+{
+    struct promise_type
+    {
+        Detached get_return_object(){ return {}; }
+        std::suspend_never initial_suspend(){ return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void(){}
+        void unhandled_exception(){ std::terminate(); }
+    };
+};
+
+static Detached awaitFire(TasksController & controller, TaskHandle handle, steady_clock::time_point & last, std::atomic_int & resumed)
+{
+    bool fired = co_await controller.nextFire(handle);
+    if(!fired) co_return;
+
+    last = steady_clock::now();
+    resumed++;
+}
+
+static void benchmarkAwait()
+{
+    constexpr int waiters = 10000;
+
+    TasksController controller;
+
+    steady_clock::time_point first, last;
+    std::atomic_int resumed = 0;
+
+    TaskHandle handle = controller.addTask("fire", "SI 00000 00:00:00.100", [&]{ first = steady_clock::now(); });
+
+    auto start = steady_clock::now();
+    for(int i = 0; i < waiters; i++) awaitFire(controller, handle, last, resumed);
+    double suspend = secondsFrom(start);
+
+    controller.addTask("stop", "SI 00000 00:00:00.300", [&]{ controller.stop(); });
+    controller.run();
+
+    std::printf("{\"benchmark\":\"await\",\"waiters\":%d,\"resumed\":%d,\"suspend_ns\":%.0f,\"resume_ns\":%.0f}\n",
+                waiters, resumed.load(), suspend * 1e9 / waiters, duration<double, std::nano>(last - first).count() / waiters);
+}
+
+//------------------shards----------------------------
+
+static void benchmarkShards(unsigned shards, int tasks)
+{
+    ShardedTasksController controller(shards, 10, true);
+    controller.setPrecise(true);
+
+    const auto due = ceil<seconds>(system_clock::now()) + seconds(3); //all tasks fire in the same wake-up of their shard
+    const hh_mm_ss time(due - floor<days>(due));
+
+    char value[32];
+    std::snprintf(value, sizeof(value), "SP 00/00 %02d:%02d:%02d", static_cast<int>(time.hours().count()),
+                  static_cast<int>(time.minutes().count()), static_cast<int>(time.seconds().count()));
+
+    std::atomic_int fired = 0;
+    system_clock::time_point last;
+
+    const Task task(value);
+
+    for(int i = 0; i < tasks; i++)
+    {
+        controller.addTask("task" + std::to_string(i), task, [&]
+        {
+            if(++fired == tasks)
+            {
+               last = system_clock::now();
+               controller.stop();
+            }
+        });
+    }
+
+    controller.run();
+
+    double span = duration<double, std::milli>(last - due).count();
+
+    std::printf("{\"benchmark\":\"shards\",\"shards\":%u,\"tasks\":%d,\"fired\":%d,\"fire_ms\":%.1f,\"fires_per_s\":%.0f}\n",
+                shards, tasks, fired.load(), span, fired.load() / (span / 1e3));
+}
+
+//------------------metrics---------------------------
+
+static void benchmarkMetrics(int tasks, bool enabled, bool perTask)
+{
+    TasksController controller;
+    controller.setPrecise(true);
+    controller.setMetrics(enabled, perTask);
+
+    const auto due = ceil<seconds>(system_clock::now()) + seconds(2);
+    const hh_mm_ss time(due - floor<days>(due));
+
+    char value[32];
+    std::snprintf(value, sizeof(value), "SP 00/00 %02d:%02d:%02d", static_cast<int>(time.hours().count()),
+                  static_cast<int>(time.minutes().count()), static_cast<int>(time.seconds().count()));
+
+    const Task task(value);
+    std::atomic_int fired = 0;
+    system_clock::time_point last;
+
+    auto start = steady_clock::now();
+
+    for(int i = 0; i < tasks; i++)
+    {
+        controller.addTask("task" + std::to_string(i), task, [&]
+        {
+            if(++fired == tasks)
+            {
+               last = system_clock::now();
+               controller.stop();
+            }
+        });
+    }
+
+    double add = secondsFrom(start);
+
+    controller.run();
+
+    const TasksMetrics metrics = controller.metrics();
+
+    std::printf("{\"benchmark\":\"metrics\",\"enabled\":%s,\"per_task\":%s,\"tasks\":%d,\"add_ms\":%.1f,\"fire_ms\":%.1f,"
+                "\"fires\":%llu,\"lateness_p99_us\":%.0f,\"tick_p99_us\":%.0f}\n",
+                enabled ? "true" : "false", perTask ? "true" : "false", tasks, add * 1e3, duration<double, std::milli>(last - due).count(),
+                static_cast<unsigned long long>(metrics.fires), metrics.lateness.percentile(0.99) / 1e3, metrics.tick.percentile(0.99) / 1e3);
+}
+
+//------------------register--------------------------
+
+static void benchmarkRegister(int tasks)
+{
+    const Task task("I 00001 00:00:00");
+    std::atomic_int fired = 0;
+    std::string payload(24, 'x'); //a capture past the small buffer of std::function
+
+    auto measure = [&](const char * api, auto && add)
+    {
+        TasksController controller;
+
+        auto start = steady_clock::now();
+        add(controller);
+        double spent = secondsFrom(start);
+
+        std::printf("{\"benchmark\":\"register\",\"api\":\"%s\",\"tasks\":%d,\"ms\":%.1f,\"ns_per_task\":%.0f}\n",
+                    api, controller.countTasks(), spent * 1e3, spent * 1e9 / tasks);
+    };
+
+    measure("addTask", [&](TasksController & controller)
+    {
+        for(int i = 0; i < tasks; i++) controller.addTask("task" + std::to_string(i), task, [&fired, payload]{ fired += payload.size(); });
+    });
+
+    measure("emplaceTask", [&](TasksController & controller)
+    {
+        for(int i = 0; i < tasks; i++) controller.emplaceTask("task" + std::to_string(i), task, [&fired, payload]{ fired += payload.size(); });
+    });
+
+    measure("addTasks", [&](TasksController & controller)
+    {
+        std::vector<TasksController::Entry> entries(tasks);
+
+        for(int i = 0; i < tasks; i++)
+        {
+            entries[i].name = "task" + std::to_string(i);
+            entries[i].task = task;
+            entries[i].callbacks.emplace_back([&fired, payload]{ fired += payload.size(); });
+        }
+
+        controller.addTasks(std::move(entries));
+    });
+}
+
+//------------------store-----------------------------
+
+static void benchmarkStore(int tasks)
+{
+    const auto directory = std::filesystem::temp_directory_path() / "TasksControllerBenchmark";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+
+    const std::string path = (directory / "tasks").string();
+
+    std::string lines;
+    for(int i = 0; i < tasks; i++) lines += "task" + std::to_string(i) + ((i % 2) ? "\tI 00000 01:00:00\n" : "\tP 00/00 15:35:01\n");
+
+    double log, snapshot, parse, restore;
+    std::size_t restored;
+
+    {
+      TasksController controller;
+      controller.openStore(path);
+
+      auto start = steady_clock::now();
+      controller.loadTasks(lines);
+      controller.syncStore();
+      log = secondsFrom(start);
+
+      start = steady_clock::now();
+      controller.saveSnapshot();
+      snapshot = secondsFrom(start);
+    }
+
+    {
+      TasksController controller;
+      auto start = steady_clock::now();
+      controller.loadTasks(lines);
+      parse = secondsFrom(start);
+    }
+
+    {
+      TasksController controller;
+      auto start = steady_clock::now();
+      restored = controller.openStore(path);
+      restore = secondsFrom(start);
+    }
+
+    std::filesystem::remove_all(directory);
+
+    std::printf("{\"benchmark\":\"store\",\"tasks\":%d,\"logged_load_ms\":%.1f,\"snapshot_ms\":%.1f,\"parse_load_ms\":%.1f,\"restore_ms\":%.1f,\"restored\":%zu}\n",
+                tasks, log * 1e3, snapshot * 1e3, parse * 1e3, restore * 1e3, restored);
+}
+
+//------------------replay----------------------------
+
+static void addSchedules(TasksController & controller, int tasks, std::size_t & fired)
+{
+
+    const char * formats[] = {"P 00/00 %02d:%02d:%02d", "W 3 %02d:%02d:%02d", "P 12/00 %02d:%02d:%02d"};
+
+    for(int i = 0; i < tasks; i++)
+    {
+        const int hours = 1 + i % 23, minutes = (i / 23) % 60, seconds = (i / 1380) % 60;
+
+        char value[32];
+        if(i % 4 == 3) std::snprintf(value, sizeof(value), "C %d %d %d * * MON-FRI", seconds, minutes, hours);
+        else std::snprintf(value, sizeof(value), formats[i % 4], hours, minutes, seconds);
+
+        controller.addTask("task" + std::to_string(i), value, [&fired]{ fired++; });
+    }
+}
+
+static void benchmarkReplay(int tasks, int days)
+{
+    TasksController controller;
+    controller.setTimeZone("UTC");
+
+    auto clock = std::make_shared<ManualClock>(sys_days(2025y/1/1));
+    controller.setClock(clock);
+
+    std::size_t fired = 0;
+    addSchedules(controller, tasks, fired);
+
+    const auto start = steady_clock::now();
+    const std::size_t count = controller.advanceClock(::days(days));
+    const double spent = secondsFrom(start);
+
+    std::printf("{\"benchmark\":\"replay\",\"tasks\":%d,\"days\":%d,\"fires\":%zu,\"callbacks\":%zu,\"ms\":%.1f,\"ns_per_fire\":%.0f}\n",
+                tasks, days, count, fired, spent * 1e3, spent * 1e9 / std::max<std::size_t>(count, 1));
+}
+
+//------------------preview---------------------------
+
+static void benchmarkPreview(int tasks)
+{
+    TasksController controller;
+    controller.setTimeZone("UTC");
+
+    const auto now = sys_days(2025y/1/1);
+    controller.setClock(std::make_shared<ManualClock>(now));
+
+    std::size_t fired = 0;
+    addSchedules(controller, tasks, fired);
+
+    auto start = steady_clock::now();
+    const auto next = controller.nextOccurrences("task7", 100);
+    const double occurrences = secondsFrom(start);
+
+    start = steady_clock::now();
+    const auto hour = controller.firesInWindow(now + hours(26), now + hours(27));
+    const double hourWindow = secondsFrom(start);
+
+    start = steady_clock::now();
+    const auto day = controller.firesInWindow(now + days(1), now + days(2));
+    const double dayWindow = secondsFrom(start);
+
+    std::printf("{\"benchmark\":\"preview\",\"tasks\":%d,\"next\":%zu,\"next_us\":%.1f,\"hour_fires\":%zu,\"hour_ms\":%.2f,\"day_fires\":%zu,\"day_ms\":%.2f}\n",
+                tasks, next.size(), occurrences * 1e6, hour.size(), hourWindow * 1e3, day.size(), dayWindow * 1e3);
+}
+
+//------------------lanes-------------------------
+
+//mode 0 - same lane as the bulk, 1 - Critical, 2 - Critical with a dedicated worker
+static void benchmarkLanes(unsigned threads, int mode)
+{
+    constexpr int tasks = 2000;
+    constexpr auto work = microseconds(200);
+
+    TasksController controller(10, threads);
+
+    std::atomic_int done = 0;
+    double late = 0;
+
+    for(int i = 0; i < tasks; i++)
+    {
+        controller.addTask("bulk" + std::to_string(i), "SI 00000 00:00:01", [&]
+        {
+            for(auto start = steady_clock::now(); steady_clock::now() - start < work;);
+            if(++done == tasks + 1) controller.stop();
+        });
+    }
+
+    const auto scheduled = system_clock::now() + seconds(1);
+
+    controller.addTask("heartbeat", "SI 00000 00:00:01", [&]
+    {
+        late = duration<double, std::micro>(system_clock::now() - scheduled).count();
+        if(++done == tasks + 1) controller.stop();
+    });
+
+    if(mode > 0) controller.setPriority("heartbeat", TasksController::Critical);
+    if(mode > 1) controller.setLaneWorkers(TasksController::Critical, 1);
+
+    controller.run();
+    while(done < tasks + 1) std::this_thread::yield();
+
+    static constexpr const char * modes[] = {"same", "critical", "dedicated"};
+    std::printf("{\"benchmark\":\"lanes\",\"threads\":%u,\"mode\":\"%s\",\"bulk\":%d,\"callback_us\":%lld,\"heartbeat_late_us\":%.0f}\n",
+                threads, modes[mode], tasks, static_cast<long long>(work.count()), late);
+}
+
+//------------------splay-------------------------
+
+static void benchmarkSplay(int tasks, seconds window)
+{
+    TasksController controller;
+    controller.setTimeZone("UTC");
+
+    const auto start = sys_days(2025y/1/1);
+    auto clock = std::make_shared<ManualClock>(start);
+    controller.setClock(clock);
+    controller.setSplay(window);
+
+    std::vector<std::size_t> fired(2 * 3600 + 1); //fires of every second of the clock
+
+    for(int i = 0; i < tasks; i++)
+    {
+        controller.addTask("task" + std::to_string(i), (i % 2) ? "I 00000 01:00:00" : "P 00/00 00:30:00", [&]
+        {
+            fired[floor<seconds>(clock->utc() - start).count()]++;
+        });
+    }
+
+    const auto density = controller.fireDensity(start, start + hours(2));
+    const std::size_t busy = std::count_if(density.begin(), density.end(), [](std::size_t fires){ return fires > 0; });
+
+    controller.advanceClock(hours(2));
+
+    std::printf("{\"benchmark\":\"splay\",\"tasks\":%d,\"window_s\":%lld,\"busy_seconds\":%zu,\"peak_per_s\":%zu,\"fired_peak_per_s\":%zu}\n",
+                tasks, static_cast<long long>(window.count()), busy, *std::max_element(density.begin(), density.end()),
+                *std::max_element(fired.begin(), fired.end()));
+}
+
+//------------------shutdown----------------------
+
+static void benchmarkShutdown(unsigned threads)
+{
+    constexpr int tasks = 2000;
+    constexpr auto work = microseconds(200);
+
+    TasksController controller(10, threads);
+    std::atomic_int done = 0;
+
+    for(int i = 0; i < tasks; i++)
+    {
+        controller.addTask("task" + std::to_string(i), "SI 00000 00:00:00.100", [&]
+        {
+            for(auto start = steady_clock::now(); steady_clock::now() - start < work;);
+            done++;
+        });
+    }
+
+    controller.start();
+    while(done < tasks / 4) std::this_thread::yield();
+
+    const auto start = steady_clock::now();
+    const bool joined = controller.stopAndJoin(seconds(5));
+    const double spent = secondsFrom(start);
+
+    std::printf("{\"benchmark\":\"shutdown\",\"threads\":%u,\"callbacks\":%d,\"callback_us\":%lld,\"joined\":%s,\"ran\":%d,\"stop_ms\":%.2f}\n",
+                threads, tasks, static_cast<long long>(work.count()), joined ? "true" : "false", done.load(), spent * 1e3);
+}
+
+//------------------lease-------------------------
+
+static void benchmarkLease(int tasks)
+{
+    constexpr int replicas = 3;
+
+    const std::string path = (std::filesystem::temp_directory_path() / "TasksControllerBenchmark.lease").string();
+    std::filesystem::remove(path);
+
+    auto clock = std::make_shared<ManualClock>();
+    std::vector<std::unique_ptr<TasksController>> controllers;
+    std::vector<std::shared_ptr<FileLease>> leases;
+    std::vector<std::size_t> fired(replicas);
+
+    for(int r = 0; r < replicas; r++)
+    {
+        controllers.push_back(std::make_unique<TasksController>());
+        controllers[r]->setClock(clock);
+        leases.push_back(std::make_shared<FileLease>(path));
+
+        for(int i = 0; i < tasks; i++) controllers[r]->addTask("task" + std::to_string(i), "I 00000 00:00:10", [&fired, r]{ fired[r]++; });
+    }
+
+    for(int r = 0; r < replicas; r++) controllers[r]->setLease(leases[r], TasksController::HashRange);
+    for(int r = 0; r < replicas; r++) controllers[r]->setLease(leases[r], TasksController::HashRange); //the first ones see the later ones
+
+    for(int step = 0; step <= 60; step++) //a fire needs the clock past its deadline
+    {
+        clock->advance(seconds(1));
+        for(auto & controller : controllers) controller->processDue();
+    }
+
+    std::vector<std::uint64_t> members;
+    const auto start = steady_clock::now();
+    for(int i = 0; i < 1000; i++) leases[0]->renew(members);
+    const double renew = secondsFrom(start) / 1000;
+
+    controllers.clear();
+    leases.clear();
+    std::filesystem::remove(path);
+
+    std::printf("{\"benchmark\":\"lease\",\"replicas\":%d,\"tasks\":%d,\"fires\":[%zu,%zu,%zu],\"total\":%zu,\"expected\":%d,\"renew_us\":%.1f}\n",
+                replicas, tasks, fired[0], fired[1], fired[2], fired[0] + fired[1] + fired[2], tasks * 6, renew * 1e6);
+}
+
+int main(int argc, char * argv[])
+{
+    bool quick = argc > 1 && std::strcmp(argv[1], "--quick") == 0;
+
+    benchmarkParse();
+    benchmarkCalculate();
+
+    benchmarkTick(1000);
+    benchmarkTick(100000);
+    if(!quick) benchmarkTick(1000000);
+
+    benchmarkLatency(0);
+    benchmarkLatency(4);
+
+    benchmarkPrecision(false);
+    benchmarkPrecision(true);
+
+    benchmarkAwait();
+
+    for(unsigned shards : {1u, 2u, 4u, 8u, 16u}) benchmarkShards(shards, quick ? 20000 : 100000);
+
+    benchmarkStore(100000);
+
+    benchmarkMetrics(quick ? 20000 : 100000, false, false);
+    benchmarkMetrics(quick ? 20000 : 100000, true, false);
+    benchmarkMetrics(quick ? 20000 : 100000, true, true);
+
+    benchmarkRegister(100000);
+
+    benchmarkReplay(100000, quick ? 7 : 30);
+    benchmarkPreview(100000);
+
+    for(int mode : {0, 1, 2}) benchmarkLanes(0, mode);
+    for(int mode : {0, 1, 2}) benchmarkLanes(4, mode);
+
+    for(int window : {0, 60, 600}) benchmarkSplay(100000, seconds(window));
+
+    benchmarkShutdown(0);
+    benchmarkShutdown(4);
+
+    benchmarkLease(30000);
+
+    return 0;
+}
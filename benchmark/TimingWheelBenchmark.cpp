@@ -0,0 +1,86 @@
+/* TimingWheel insert/cancel/expire throughput with 1M live timers against the std::map storage of TasksController,
+   one JSON object per line on stdout
+
+   target: TimingWheelBenchmark (CMake option TASKSCONTROLLER_BENCHMARKS)
+*/
+
+#include "TimingWheel.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <map>
+
+using namespace std::chrono;
+
+static double millisecondsFrom(steady_clock::time_point start)
+{
+    return duration<double, std::milli>(steady_clock::now() - start).count();
+}
+
+static void report(const char * storage, const char * operation, std::size_t operations, double ms)
+{
+    std::printf("{\"benchmark\":\"timers\",\"storage\":\"%s\",\"op\":\"%s\",\"ops\":%zu,\"ms\":%.2f,\"ops_per_s\":%.0f}\n",
+                storage, operation, operations, ms, operations / (ms / 1000.0));
+}
+
+int main()
+{
+    constexpr std::size_t count = 1000000;
+
+    std::mt19937_64 random(42);
+    std::uniform_int_distribution<int> delays(1000, 60000); //1s..60s, retry/timeout style
+
+    std::vector<milliseconds> delay(count);
+    for(auto & d : delay) d = milliseconds(delays(random));
+
+    std::size_t fired = 0;
+    auto callback = [&fired]{ fired++; };
+
+    //------------------TimingWheel----------------------
+
+    TimingWheel wheel;
+    const auto now = TimingWheel::Clock::now();
+    std::vector<TimingWheel::Timer> timers(count);
+
+    auto start = steady_clock::now();
+    for(std::size_t i = 0; i < count; i++) timers[i] = wheel.add(now, delay[i], callback);
+    report("wheel", "insert", count, millisecondsFrom(start));
+
+    start = steady_clock::now();
+    for(std::size_t i = 0; i < count; i += 2) wheel.cancel(timers[i]);
+    report("wheel", "cancel", count / 2, millisecondsFrom(start));
+
+    start = steady_clock::now();
+    for(std::size_t i = 0; i < count; i += 2) timers[i] = wheel.add(now, delay[i], callback);
+    report("wheel", "reinsert", count / 2, millisecondsFrom(start));
+
+    std::vector<std::function<void()>> expired;
+    expired.reserve(count);
+
+    start = steady_clock::now();
+    for(auto time = now; !wheel.empty(); time += milliseconds(10)) wheel.advance(time, expired); //10 ms ticks
+    for(auto & func : expired) func();
+    report("wheel", "expire", fired, millisecondsFrom(start));
+
+    //------------------std::map baseline (TasksController storage)------------------
+
+    std::map<std::string, std::pair<steady_clock::time_point, std::function<void()>>> tasks;
+    std::vector<std::string> names(count);
+    for(std::size_t i = 0; i < count; i++) names[i] = "timer_" + std::to_string(i);
+
+    start = steady_clock::now();
+    for(std::size_t i = 0; i < count; i++) tasks.insert({names[i], {now + delay[i], callback}});
+    report("map", "insert", count, millisecondsFrom(start));
+
+    start = steady_clock::now();
+    for(std::size_t i = 0; i < count; i += 2) tasks.erase(names[i]);
+    report("map", "cancel", count / 2, millisecondsFrom(start));
+
+    start = steady_clock::now();
+    std::size_t due = 0;
+    for(auto & task : tasks) if(task.second.first < now + seconds(30)) due++; //one linear scan of run()
+    report("map", "scan", tasks.size(), millisecondsFrom(start));
+
+    return (fired == count && due > 0) ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+#include <string>
+
+/* Assertions of the tests in tests/, one executable per module registered with ctest (CMake option TASKSCONTROLLER_TESTS)
+
+   CHECK() reports a false condition with its file and line and the test goes on, main() returns checkResult(),
+   not 0 when a check failed. Independent of NDEBUG, the tests run in the Release build too.
+*/
+
+inline unsigned & checkFailures()
+{
+    static unsigned failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do { if(!(condition)){ std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); checkFailures()++; } } while(false)
+
+inline int checkResult()
+{
+    if(checkFailures() == 0){ std::puts("ok"); return 0; }
+
+    std::fprintf(stderr, "%u checks failed\n", checkFailures());
+    return 1;
+}
+
+inline std::string nameOf(const char * prefix, int i) //appended: "t" + std::to_string(i) trips a false -Wrestrict of GCC 12
+{
+    std::string name = prefix;
+    name += std::to_string(i);
+    return name;
+}
+
+#endif // CHECK_H
@@ -0,0 +1,228 @@
+/* CronExpression parsing and next() against a brute-force matcher, and cron tasks fired by a ManualClock
+
+   parse  - accepted and rejected expressions, names, the text of an expression, interning
+   next   - fixed cases of steps, ranges, Feb 29 and the DD-or-W rule, then 5000 random expressions whose
+            next() must be the first second a plain day-by-day scan of their value sets matches
+   tasks  - C/SC schedules fired through a week by advanceClock()
+*/
+
+#include "Check.h"
+
+#include "TasksController.h"
+
+#include <random>
+#include <set>
+#include <string>
+
+using namespace std::chrono;
+
+static std::int64_t secondsOf(sys_days day)
+{
+    return day.time_since_epoch().count() * 86400LL;
+}
+
+//------------------parse-----------------------------
+
+static void checkParse()
+{
+    CHECK(CronExpression("0 0-59/5 9-17 * * MON-FRI").isValid());
+    CHECK(CronExpression("30 8 * dec sun").isValid()); //without the seconds
+    CHECK(CronExpression("30 8 * dec sun").text() == "30 8 * dec sun");
+    CHECK(CronExpression("0 0 0 29 2 *").isValid());
+    CHECK(CronExpression("0 0 0 * * 7").isValid());
+
+    CHECK(!CronExpression("0 0 0 30 2 *").isValid()); //no date matches
+    CHECK(!CronExpression("60 * * * * *").isValid());
+    CHECK(!CronExpression("* * 24 * * *").isValid());
+    CHECK(!CronExpression("* * * 0 * *").isValid());
+    CHECK(!CronExpression("* * * * 13 *").isValid());
+    CHECK(!CronExpression("* * * * * 8").isValid());
+    CHECK(!CronExpression("* * * * *  * *").isValid());
+    CHECK(!CronExpression("* * 5-3 * * *").isValid());
+    CHECK(!CronExpression("*/0 * * * * *").isValid());
+    CHECK(!CronExpression("* * * * FOO *").isValid());
+    CHECK(!CronExpression("1,,2 * * * * *").isValid());
+    CHECK(!CronExpression("").isValid());
+    CHECK(CronExpression("").next(0) == -1);
+
+    CHECK(CronExpression::intern(CronExpression("0 0 * * *")) == CronExpression::intern(CronExpression("0   0 * *   *")));
+    CHECK(CronExpression::intern(CronExpression("0 0 * * *")) != CronExpression::intern(CronExpression("0 1 * * *")));
+    CHECK(CronExpression::intern(CronExpression("bad")) == 0);
+
+    const std::uint32_t id = CronExpression::intern(CronExpression("0 30 8 * * MON"));
+    CHECK(CronExpression::find(id) && CronExpression::find(id)->text() == "0 30 8 * * MON");
+}
+
+//------------------next------------------------------
+
+struct Fields //the values each field matches, as a brute-force matcher reads them
+{
+    std::set<int> seconds, minutes, hours, days, months, weekdays;
+    bool anyDay = false;
+    bool anyWeekday = false;
+};
+
+static bool matchesDay(const Fields & fields, const year_month_day & date)
+{
+    const bool dayMatches = fields.days.count(static_cast<int>(unsigned(date.day())));
+    const bool weekdayMatches = fields.weekdays.count(static_cast<int>(weekday(sys_days(date)).c_encoding()));
+
+    if(fields.anyDay || fields.anyWeekday) return dayMatches && weekdayMatches;
+    return dayMatches || weekdayMatches;
+}
+
+static std::int64_t bruteNext(const Fields & fields, std::int64_t from)
+{
+    sys_days day = floor<days>(sys_seconds(seconds(from)));
+
+    for(int i = 0; i < 366 * 30; i++, day += days(1))
+    {
+        const year_month_day date(day);
+        if(!fields.months.count(static_cast<int>(unsigned(date.month()))) || !matchesDay(fields, date)) continue;
+
+        for(int hour : fields.hours)
+            for(int minute : fields.minutes)
+                for(int second : fields.seconds)
+                {
+                    const std::int64_t time = secondsOf(day) + hour * 3600 + minute * 60 + second;
+                    if(time >= from) return time;
+                }
+    }
+
+    return -1;
+}
+
+static std::string randomField(std::mt19937 & random, int low, int high, std::set<int> & values, bool & any)
+{
+    any = false;
+
+    if(random() % 4 == 0) //* or */s
+    {
+       any = true;
+       const int step = (random() % 2) ? 1 : 1 + static_cast<int>(random() % 7);
+       for(int v = low; v <= high; v += step) values.insert(v);
+       return (step == 1) ? "*" : "*/" + std::to_string(step);
+    }
+
+    std::string field;
+
+    for(unsigned parts = 1 + random() % 3; parts > 0; parts--)
+    {
+        if(!field.empty()) field += ',';
+
+        int a = low + static_cast<int>(random() % (high - low + 1));
+        int b = low + static_cast<int>(random() % (high - low + 1));
+        if(a > b) std::swap(a, b);
+
+        switch(random() % 3)
+        {
+           case 0: values.insert(a); field += std::to_string(a); break;
+           case 1: for(int v = a; v <= b; v++) values.insert(v); field += std::to_string(a) + "-" + std::to_string(b); break;
+           default:
+           {
+              const int step = 1 + static_cast<int>(random() % 10);
+              for(int v = a; v <= b; v += step) values.insert(v);
+              field += std::to_string(a) + "-" + std::to_string(b) + "/" + std::to_string(step);
+           }
+        }
+    }
+
+    return field;
+}
+
+static void checkNext()
+{
+    const std::int64_t base = secondsOf(sys_days(2024y/1/1)); //a Monday
+
+    CronExpression quarter("0 0-59/15 10 1 1 *");
+    CHECK(quarter.next(base) == base + 36000);
+    CHECK(quarter.next(base + 36001) == base + 36000 + 900);
+    CHECK(quarter.next(base + 36000 + 2701) == secondsOf(sys_days(2025y/1/1)) + 36000);
+
+    CronExpression leap("0 0 0 29 2 *");
+    CHECK(leap.next(base) == secondsOf(sys_days(2024y/2/29)));
+    CHECK(leap.next(base + 86400 * 70) == secondsOf(sys_days(2028y/2/29)));
+
+    CHECK(CronExpression("0 0 0 13 * 5").next(base) == secondsOf(sys_days(2024y/1/5))); //the 13th or a Friday
+    CHECK(CronExpression("0 0 0 13 * 5").next(secondsOf(sys_days(2024y/1/12)) + 1) == secondsOf(sys_days(2024y/1/13)));
+    CHECK(CronExpression("0 0 0 */2 * 5").next(base + 1) == secondsOf(sys_days(2024y/1/5))); //*/2 and a Friday
+    CHECK(CronExpression("0 0 0 * * 7").next(base) == secondsOf(sys_days(2024y/1/7)));
+    CHECK(CronExpression("0 0 0 * * 0").next(base) == secondsOf(sys_days(2024y/1/7)));
+    CHECK(CronExpression("59 59 23 31 12 *").next(base) == secondsOf(sys_days(2024y/12/31)) + 86399);
+    CHECK(CronExpression("0 0 * * *").next(base + 1) == base + 86400);
+
+    std::mt19937 random(7);
+    std::size_t checked = 0;
+    std::size_t mismatches = 0;
+
+    for(int i = 0; i < 5000; i++)
+    {
+        Fields fields;
+        bool any;
+
+        std::string text = randomField(random, 0, 59, fields.seconds, any);
+        text += ' '; text += randomField(random, 0, 59, fields.minutes, any);
+        text += ' '; text += randomField(random, 0, 23, fields.hours, any);
+        text += ' '; text += randomField(random, 1, 31, fields.days, fields.anyDay);
+        text += ' '; text += randomField(random, 1, 12, fields.months, any);
+        text += ' '; text += randomField(random, 0, 6, fields.weekdays, fields.anyWeekday);
+
+        const CronExpression expression(text);
+        const std::int64_t from = 1600000000LL + random() % 400000000u;
+        const std::int64_t expected = bruteNext(fields, from);
+
+        if(!expression.isValid())
+        {
+           CHECK(expected == -1); //only an expression no date can match is rejected
+           continue;
+        }
+
+        const std::int64_t next = expression.next(from);
+
+        if(next != expected && mismatches++ < 5) std::fprintf(stderr, "%s from %lld: %lld, brute force %lld\n", text.c_str(),
+                                                              static_cast<long long>(from), static_cast<long long>(next), static_cast<long long>(expected));
+        checked++;
+    }
+
+    CHECK(mismatches == 0);
+    CHECK(checked > 4000);
+}
+
+//------------------tasks-----------------------------
+
+static void checkTasks()
+{
+    CHECK(Task("C 0-59/2 * * * * *").taskType() == Task::Cron);
+    CHECK(Task("SC 0 0 0 1 1 *").isSingle() && Task("SC 0 0 0 1 1 *").taskType() == Task::SingleCron);
+    CHECK(!Task("C 0 0 0 31 2 *").isValid());
+    CHECK(!Task("C").isValid());
+
+    auto clock = std::make_shared<ManualClock>(sys_days(2025y/1/6)); //a Monday
+
+    TasksController controller;
+    CHECK(controller.setTimeZone("UTC"));
+    CHECK(controller.setClock(clock));
+
+    int working = 0;
+    int weekend = 0;
+    int single = 0;
+
+    controller.addTask("working", "C 0 0-59/5 9-17 * * MON-FRI", [&]{ working++; });
+    controller.addTask("weekend", "C 0 0 12 * * SAT,SUN", [&]{ weekend++; });
+    controller.addTask("single", "SC 30 0 0 * * *", [&]{ single++; });
+
+    controller.advanceClock(days(7));
+
+    CHECK(working == 5 * 9 * 12);
+    CHECK(weekend == 2);
+    CHECK(single == 1 && !controller.contains("single"));
+}
+
+int main()
+{
+    checkParse();
+    checkNext();
+    checkTasks();
+
+    return checkResult();
+}
@@ -0,0 +1,216 @@
+/* Journal replay and rotation, and the store of TasksController on top of it
+
+   replay - the records come back in order, a torn tail is dropped and cut off, appends go on after it,
+            a damaged record ends the replay, the records a snapshot covers are skipped
+   rotate - the rotated log is replayed before the new one, a second rotation appends to an .old
+            a snapshot has not dropped yet
+   store  - tasks restored from the log with a torn tail, from a failed snapshot, after concurrent snapshots
+*/
+
+#include "Check.h"
+
+#include "TasksController.h"
+#include "Journal.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Record
+{
+    std::uint64_t sequence;
+    unsigned char kind;
+    std::string payload;
+};
+
+static std::vector<Record> replay(Journal & journal, const std::string & path, std::uint64_t after = 0)
+{
+    std::vector<Record> records;
+    CHECK(journal.open(path, [&](std::uint64_t sequence, unsigned char kind, std::string_view payload){ records.push_back({sequence, kind, std::string(payload)}); }, after));
+    return records;
+}
+
+static std::string payloadOf(int i)
+{
+    return "record " + std::to_string(i) + std::string(i % 7, '.');
+}
+
+//------------------replay----------------------------
+
+static void checkReplay(const fs::path & dir)
+{
+    const std::string path = (dir / "journal").string();
+
+    {
+        Journal journal;
+        CHECK(replay(journal, path).empty());
+        for(int i = 1; i <= 100; i++) CHECK(journal.append(static_cast<unsigned char>(i % 3), payloadOf(i)) == std::uint64_t(i));
+        CHECK(journal.sync());
+    }
+
+    Journal journal;
+    std::vector<Record> records = replay(journal, path);
+
+    CHECK(records.size() == 100);
+    for(std::size_t i = 0; i < records.size(); i++)
+    {
+        CHECK(records[i].sequence == i + 1 && records[i].kind == (i + 1) % 3 && records[i].payload == payloadOf(static_cast<int>(i + 1)));
+    }
+    journal.close();
+
+    //a crash during the last write: the record is dropped and the file cut to the records before it
+    const std::uintmax_t size = fs::file_size(path);
+    fs::resize_file(path, size - 5);
+
+    records = replay(journal, path);
+    CHECK(records.size() == 99 && records.back().sequence == 99);
+    CHECK(fs::file_size(path) == size - (17 + payloadOf(100).size()));
+
+    CHECK(journal.append(1, "after the tear") == 100);
+    journal.close();
+
+    records = replay(journal, path);
+    CHECK(records.size() == 100 && records.back().payload == "after the tear");
+    journal.close();
+
+    //a damaged byte in record 50: the replay ends before it
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        std::size_t offset = 0;
+        for(int i = 1; i < 50; i++) offset += 17 + payloadOf(i).size();
+        file.seekp(static_cast<std::streamoff>(offset + 17));
+        file.put('#');
+    }
+
+    records = replay(journal, path);
+    CHECK(records.size() == 49 && records.back().sequence == 49);
+    journal.close();
+
+    records = replay(journal, path, 40); //40 and before are in a snapshot
+    CHECK(records.size() == 9 && records.front().sequence == 41);
+    CHECK(journal.append(0, "next") == 50);
+    journal.close();
+}
+
+//------------------rotate----------------------------
+
+static void checkRotate(const fs::path & dir)
+{
+    const std::string path = (dir / "rotated").string();
+
+    Journal journal;
+    replay(journal, path);
+
+    for(int i = 1; i <= 10; i++) journal.append(0, payloadOf(i));
+    CHECK(journal.rotate() == 10);
+    CHECK(fs::exists(path + ".old"));
+
+    for(int i = 11; i <= 15; i++) journal.append(0, payloadOf(i));
+    CHECK(journal.rotate() == 15); //no snapshot dropped the first .old, the log is appended to it
+    for(int i = 16; i <= 20; i++) journal.append(0, payloadOf(i));
+    journal.close();
+
+    std::vector<Record> records = replay(journal, path); //a crash before dropRotated()
+    CHECK(records.size() == 20);
+    for(std::size_t i = 0; i < records.size(); i++) CHECK(records[i].sequence == i + 1);
+
+    CHECK(journal.rotate() == 20);
+    journal.dropRotated();
+    CHECK(!fs::exists(path + ".old"));
+    CHECK(journal.append(0, "after") == 21);
+    journal.close();
+
+    records = replay(journal, path, 20);
+    CHECK(records.size() == 1 && records[0].sequence == 21);
+}
+
+//------------------store-----------------------------
+
+static void checkStore(const fs::path & dir)
+{
+    const std::string store = (dir / "tasks").string();
+
+    {
+        TasksController controller;
+        controller.openStore(store);
+        for(int i = 0; i < 20; i++) controller.addTask(nameOf("t", i), "P 00/00 00:30:00");
+        CHECK(controller.syncStore());
+    }
+
+    fs::resize_file(store + ".log", fs::file_size(store + ".log") - 3); //the add of t19 is torn
+
+    {
+        TasksController controller;
+        CHECK(controller.openStore(store) == 19);
+        CHECK(controller.contains("t18") && !controller.contains("t19"));
+        controller.addTask("t19", "P 00/00 00:30:00");
+        CHECK(controller.syncStore());
+    }
+
+    {
+        TasksController controller;
+        CHECK(controller.openStore(store) == 20);
+
+        fs::create_directories(store + ".snapshot/block"); //the snapshot cannot replace a directory that is not empty
+        CHECK(!controller.saveSnapshot());
+        controller.addTask("a", "W 2 10:00:00");
+        CHECK(!controller.saveSnapshot());
+        controller.addTask("b", "C 0 0 9 * * MON-FRI");
+        CHECK(controller.syncStore());
+    }
+
+    {
+        TasksController controller;
+        CHECK(controller.openStore(store) == 22); //the records of the failed snapshots are still in the logs
+        CHECK(controller.contains("a") && controller.contains("b") && controller.contains("t0"));
+    }
+
+    fs::remove_all(store + ".snapshot");
+
+    {
+        TasksController controller;
+        controller.openStore(store);
+
+        std::atomic_int failed = 0;
+        std::vector<std::jthread> savers;
+
+        for(int s = 0; s < 4; s++)
+        {
+            savers.emplace_back([&, s]
+            {
+                for(int i = 0; i < 25; i++)
+                {
+                    controller.addTask(nameOf("s", s * 100 + i), "P 00/00 00:30:00");
+                    if(!controller.saveSnapshot()) failed++;
+                }
+            });
+        }
+
+        savers.clear();
+        CHECK(failed == 0);
+        CHECK(controller.syncStore());
+    }
+
+    TasksController controller;
+    CHECK(controller.openStore(store) == 122);
+    CHECK(!fs::exists(store + ".log.old"));
+}
+
+int main()
+{
+    const fs::path dir = fs::temp_directory_path() / "JournalTest";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+
+    checkReplay(dir);
+    checkRotate(dir);
+    checkStore(dir);
+
+    fs::remove_all(dir);
+
+    return checkResult();
+}
@@ -0,0 +1,191 @@
+/* Metrics histograms and the Prometheus and JSON exports
+
+   histogram  - values land in their power-of-two buckets, the percentiles are the bucket bounds
+   prometheus - every sample belongs to a family declared by HELP and TYPE, counters end in _total,
+                histogram buckets are cumulative up to +Inf, task names are escaped in the labels
+   json       - task names with quotes, backslashes, newlines and control bytes are escaped
+   controller - the per-task stats of fired tasks reach both exports
+*/
+
+#include "Check.h"
+
+#include "TasksController.h"
+
+#include <map>
+#include <sstream>
+#include <string>
+
+using namespace std::chrono;
+
+static bool contains(const std::string & text, const std::string & part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+//------------------histogram-------------------------
+
+static void checkHistogram()
+{
+    Histogram histogram;
+
+    histogram.record(nanoseconds(0));
+    histogram.record(nanoseconds(-5)); //counted as zero
+    histogram.record(nanoseconds(1));
+    histogram.record(nanoseconds(1000)); //[512, 1024)
+    histogram.record(hours(100)); //past the last bound
+
+    const Histogram::Snapshot snapshot = histogram.snapshot();
+
+    CHECK(snapshot.count == 5);
+    CHECK(snapshot.sum == 1001 + std::uint64_t(duration_cast<nanoseconds>(hours(100)).count()));
+    CHECK(snapshot.counts[0] == 2 && snapshot.counts[1] == 1 && snapshot.counts[10] == 1 && snapshot.counts[Histogram::buckets - 1] == 1);
+
+    CHECK(snapshot.percentile(0.4) == 0);
+    CHECK(snapshot.percentile(0.6) == 2);
+    CHECK(snapshot.percentile(0.8) == 1024);
+    CHECK(snapshot.percentile(1.0) == Histogram::Snapshot::upperBound(Histogram::buckets - 1));
+
+    histogram.clear();
+    CHECK(histogram.snapshot().count == 0 && histogram.snapshot().percentile(0.5) == 0);
+}
+
+//------------------prometheus------------------------
+
+static TasksMetrics sample()
+{
+    TasksMetrics metrics;
+    metrics.ticks = 7;
+    metrics.fires = 5;
+    metrics.tasks = 2;
+
+    for(std::uint64_t ns : {100ULL, 3000ULL, 3000ULL, 2000000000ULL})
+    {
+        metrics.callback.counts[std::bit_width(ns)]++;
+        metrics.callback.count++;
+        metrics.callback.sum += ns;
+    }
+
+    metrics.perTask.push_back({"plain", 3, 1500000000, 1000000000, 2000, 1000});
+    metrics.perTask.push_back({"a\"b\\c\nd", 2, 500, 400, 0, 0});
+
+    return metrics;
+}
+
+static void checkPrometheus()
+{
+    const std::string text = sample().toPrometheus("tc");
+
+    std::map<std::string, std::string> types; //family - type
+    std::map<std::string, bool> helped;
+    std::size_t samples = 0, orphans = 0, badCounters = 0;
+
+    std::istringstream lines(text);
+    std::string line;
+
+    while(std::getline(lines, line))
+    {
+        std::istringstream words(line);
+        std::string first, family, type;
+        words >> first;
+
+        if(first == "#")
+        {
+           words >> type >> family;
+           if(type == "HELP") helped[family] = true;
+           else if(type == "TYPE"){ words >> types[family]; badCounters += types[family] == "counter" && !family.ends_with("_total"); }
+           continue;
+        }
+
+        samples++;
+        const std::string metric = first.substr(0, first.find('{'));
+
+        bool declared = types.contains(metric) && helped[metric];
+        for(const char * suffix : {"_bucket", "_sum", "_count"})
+        {
+            if(metric.ends_with(suffix))
+            {
+               const std::string base = metric.substr(0, metric.size() - std::char_traits<char>::length(suffix));
+               declared = declared || (types[base] == "histogram" && helped[base]);
+            }
+        }
+
+        orphans += !declared;
+    }
+
+    CHECK(samples > 0 && orphans == 0 && badCounters == 0);
+    CHECK(types["tc_task_callback_seconds_total"] == "counter" && types["tc_task_lateness_seconds_total"] == "counter");
+    CHECK(types["tc_task_callback_seconds_max"] == "gauge" && types["tc_tasks"] == "gauge");
+    CHECK(!contains(text, "tc_task_callback_seconds_sum") && !contains(text, "tc_task_lateness_seconds_sum"));
+
+    CHECK(contains(text, "\ntc_ticks_total 7\n") && contains(text, "\ntc_fires_total 5\n") && contains(text, "\ntc_tasks 2\n"));
+
+    //cumulative buckets: 100 ns in [64, 128), 3000 ns in [2048, 4096), 2 s in [2^30, 2^31)
+    CHECK(contains(text, "tc_callback_seconds_bucket{le=\"6.4e-08\"} 0\n"));
+    CHECK(contains(text, "tc_callback_seconds_bucket{le=\"1.28e-07\"} 1\n"));
+    CHECK(contains(text, "tc_callback_seconds_bucket{le=\"4.096e-06\"} 3\n"));
+    CHECK(contains(text, "tc_callback_seconds_bucket{le=\"+Inf\"} 4\n"));
+    CHECK(contains(text, "tc_callback_seconds_sum 2.000006100\ntc_callback_seconds_count 4\n"));
+
+    CHECK(contains(text, "tc_task_fires_total{task=\"plain\"} 3\n"));
+    CHECK(contains(text, "tc_task_callback_seconds_total{task=\"plain\"} 1.500000000\n"));
+    CHECK(contains(text, "tc_task_lateness_seconds_max{task=\"plain\"} 0.000001000\n"));
+    CHECK(contains(text, "tc_task_fires_total{task=\"a\\\"b\\\\c\\nd\"} 2\n")); //the three escapes of the text format
+
+    CHECK(!contains(TasksMetrics().toPrometheus(), "task=")); //no per-task families without per-task stats
+}
+
+//------------------json------------------------------
+
+static void checkJson()
+{
+    TasksMetrics metrics = sample();
+    metrics.perTask.push_back({std::string("tab\tbell\x07"), 1, 0, 0, 0, 0});
+
+    const std::string json = metrics.toJson();
+
+    CHECK(json.starts_with("{\"ticks\":7,\"fires\":5,") && json.ends_with("]}"));
+    CHECK(contains(json, "\"callback\":{\"count\":4,\"sum_ns\":2000006100,\"p50_ns\":4096,"));
+    CHECK(contains(json, "{\"name\":\"plain\",\"fires\":3,\"callback_sum_ns\":1500000000,\"callback_max_ns\":1000000000,"));
+    CHECK(contains(json, "{\"name\":\"a\\\"b\\\\c\\nd\",\"fires\":2,"));
+    CHECK(contains(json, "{\"name\":\"tab\\u0009bell\\u0007\",\"fires\":1,"));
+}
+
+//------------------controller------------------------
+
+static void checkController()
+{
+    auto clock = std::make_shared<ManualClock>(sys_days(2025y/1/1));
+
+    TasksController controller;
+    controller.setTimeZone("UTC");
+    controller.setClock(clock);
+    CHECK(controller.setMetrics(true, true));
+
+    controller.addTask("every \"10\" minutes", "I 00000 00:10:00");
+    controller.addTask("hourly", "P 00/00 00:30:00");
+
+    controller.advanceClock(hours(3) + minutes(5));
+
+    const TasksMetrics metrics = controller.metrics();
+    CHECK(metrics.fires == 21 && metrics.tasks == 2 && metrics.perTask.size() == 2); //the ticks of tasks without callbacks counted once
+
+    const std::string text = metrics.toPrometheus();
+    CHECK(contains(text, "taskscontroller_task_fires_total{task=\"every \\\"10\\\" minutes\"} 18\n"));
+    CHECK(contains(text, "taskscontroller_task_fires_total{task=\"hourly\"} 3\n"));
+    CHECK(contains(text, "taskscontroller_fires_total 21\n"));
+
+    CHECK(contains(metrics.toJson(), "{\"name\":\"every \\\"10\\\" minutes\",\"fires\":18,"));
+
+    controller.clearMetrics();
+    CHECK(controller.metrics().fires == 0);
+}
+
+int main()
+{
+    checkHistogram();
+    checkPrometheus();
+    checkJson();
+    checkController();
+
+    return checkResult();
+}
@@ -0,0 +1,674 @@
+#ifndef REFERENCETASK_H
+#define REFERENCETASK_H
+
+#include <chrono>
+#include <charconv>
+#include <cctype>
+#include <functional>
+#include <string_view>
+
+/* The Task before the compact record and the fixed-width parser, the oracle of the tests
+
+   One std::function per task built by the pattern functions below and the parsers with their callbacks, kept
+   as they were. The time of the first deadline is given instead of read from the system clock, and a day count
+   above 65535 is rejected instead of left uninitialized, the one change of the new parser too.
+*/
+
+class ReferenceTask final
+{
+public:
+    using Now = std::chrono::system_clock::time_point;
+
+    enum Type : unsigned char
+    {
+         None = 0,
+         Point,
+         SinglePoint,
+         Interval,
+         SingleInterval
+    };
+
+    explicit ReferenceTask(std::string_view value, const Now & now); //now - local time
+
+    bool isValid() const;
+    bool taskCalculate(const Now & now, bool recalc) const;
+    Now nextFire() const;
+    Type taskType() const;
+    bool isSingle() const;
+
+private:
+    Type type = None;
+    Now origin;
+    mutable Now finish;
+    std::function<bool(const Now &, Now &, bool)> calculate = nullptr;
+
+    bool pointDayTaskInit(const unsigned char seconds, const unsigned char minutes, const unsigned char hours, const unsigned char day, const unsigned char month);
+    bool singlePointDayTaskInit(const unsigned char seconds, const unsigned char minutes, const unsigned char hours, const unsigned char day, const unsigned char month);
+    bool pointWeekTaskInit(const unsigned char seconds, const unsigned char minutes, const unsigned char hours, const unsigned char weekday);
+    bool singlePointWeekTaskInit(const unsigned char seconds, const unsigned char minutes, const unsigned char hours, const unsigned char weekday);
+    bool intervalTaskInit(const unsigned char seconds, const unsigned char minutes, const unsigned char hours, const unsigned short days);
+    bool singleIntervalTaskInit(const unsigned char seconds, const unsigned char minutes, const unsigned char hours, const unsigned short days);
+    bool parseFromString(std::string_view value);
+};
+
+using Now = std::chrono::system_clock::time_point;
+using Calculate = std::function<bool(const Now &, Now &, bool)>;
+using namespace std::chrono;
+
+static inline system_clock::time_point GetFromDate(const unsigned char day, const unsigned char month, const unsigned int year)
+{
+    return system_clock::time_point{sys_days{year_month_day{::year(year), ::month(month), ::day(day)}}.time_since_epoch()};
+}
+
+static inline system_clock::time_point GetFromWeekDate(const unsigned char index, const unsigned char weekday, const month month, const year year)
+{
+    return {sys_days{year_month_weekday{year, month, weekday_indexed(::weekday(weekday), index)}}};
+}
+
+static inline system_clock::time_point GetOnlyDateFromPoint(const Now & now)
+{
+    return system_clock::time_point{sys_days{year_month_day{floor<days>(now)}}.time_since_epoch()};
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+//------------------Day------------------------------
+
+static void dayPattern(Calculate & calculate, Now & finish, const unsigned char day, const system_clock::time_point & now, const seconds & sum)
+{
+    int year;
+    unsigned char month;
+
+    {
+      year_month_day ymd(floor<days>(now));
+      year = static_cast<int>(ymd.year());
+      month = static_cast<unsigned>(ymd.month());
+    }
+
+    while(!month_day(::month(month), ::day(day)).ok()) month++;
+    finish = GetFromDate(day, month, year) + sum;
+
+    if(now > finish)
+    {
+       month++;
+       if(month <= 12)
+       {
+          while(!month_day(::month(month), ::day(day)).ok()) month++;
+          finish = GetFromDate(day, month, year) + sum;
+       }
+       else finish = GetFromDate(day, 1, year + 1) + sum;
+    }
+
+    calculate = [day, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {          
+          int year;
+          unsigned char month;
+
+          {
+            year_month_day ymd(floor<days>(now));
+            year = static_cast<int>(ymd.year());
+            month = static_cast<unsigned>(ymd.month()) + 1;
+          }
+
+          if(month <= 12)
+          {
+             while(!month_day(::month(month), ::day(day)).ok()) month++;
+             finish = GetFromDate(day, month, year) + sum;
+          }
+          else finish = GetFromDate(day, 1, year + 1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void dayMonthPattern(Calculate & calculate, Now & finish, const unsigned char day, const unsigned char month, const system_clock::time_point & now, const seconds & sum)
+{
+    int year = static_cast<int>(year_month_day(floor<days>(now)).year());
+    while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
+    finish = GetFromDate(day, month, year) + sum;
+
+    if(now > finish)
+    {
+       year++;
+       while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
+       finish = GetFromDate(day, month, year) + sum;
+    }
+
+    calculate = [day, month, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          int year = static_cast<int>(year_month_day(floor<days>(now)).year()) + 1;
+          while(!year_month_day{::year(year), ::month(month), ::day(day)}.ok()) year++;
+          finish = GetFromDate(day, month, year) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+//------------------Only Weekday--------------------------
+
+static void weekdayPattern(Calculate & calculate, Now & finish, const unsigned char weekday, const system_clock::time_point & now, const seconds & sum)
+{
+    const unsigned char c_weekday = (weekday == 7) ? 0 : weekday;
+    year_month_weekday cw{floor<days>(now)};
+    finish = GetFromWeekDate(cw.weekday_indexed().index(), c_weekday, cw.month(), cw.year()) + sum;
+
+    if(now > finish) finish = GetFromWeekDate(cw.weekday_indexed().index() + 1, c_weekday, cw.month(), cw.year()) + sum;
+
+    calculate = [c_weekday, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          year_month_weekday cw{floor<days>(now)};
+          finish = GetFromWeekDate(cw.weekday_indexed().index(), c_weekday, cw.month(), cw.year()) + sum;
+          if(now > finish) finish = GetFromWeekDate(cw.weekday_indexed().index() + 1, c_weekday, cw.month(), cw.year()) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+//------------------Only Month----------------------------
+
+static void monthPattern(Calculate & calculate, Now & finish, const unsigned char month, const system_clock::time_point & now, const seconds & sum)
+{
+    year_month_day ymd(floor<days>(now));
+    finish = GetFromDate(1, month, static_cast<int>(ymd.year())) + sum;
+
+    if(now > finish) finish = GetFromDate(1, month, static_cast<int>(ymd.year()) + 1) + sum;
+
+    calculate = [month, sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          year_month_day ymd(floor<days>(now));
+          finish = GetFromDate(1, month, static_cast<int>(ymd.year()) + 1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+//------------------Only Time-----------------------------
+
+static void hoursPattern(Calculate & calculate, Now & finish, const system_clock::time_point & now, const seconds & sum)
+{
+    finish = GetOnlyDateFromPoint(now) + sum;
+
+    if(now > finish) finish += days(1);
+
+    calculate = [sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          finish = GetOnlyDateFromPoint(now) + days(1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static void minutesPattern(Calculate & calculate, Now & finish, const system_clock::time_point & now, const seconds & sum)
+{
+    auto onlyDate = GetOnlyDateFromPoint(now);
+    hh_mm_ss time(now - onlyDate);
+    finish = onlyDate + time.hours() + sum;
+
+    if(now > finish) finish += ::hours(1);
+
+    calculate = [sum](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          system_clock::time_point date = GetOnlyDateFromPoint(now);
+          hh_mm_ss time(now - date);
+          finish = date + time.hours() + ::hours(1) + sum;
+
+          return !recalc;
+       }
+       return false;
+    };
+}
+
+static bool onlyTimePattern(Calculate & calculate,
+                            Now & finish,
+                            const unsigned char seconds,
+                            const unsigned char minutes,
+                            const unsigned char hours,
+                            const system_clock::time_point & now,
+                            bool isZeroHour,
+                            bool isZeroMinute,
+                            bool isZeroSecond)
+{
+    if(hours > 0 || isZeroHour)
+    {
+       hoursPattern(calculate, finish, now, ::seconds(seconds) + ::minutes(minutes) + ::hours(hours));
+       return true;
+    }
+
+    if(minutes > 0 || isZeroMinute)
+    {
+       minutesPattern(calculate, finish, now, ::seconds(seconds) + ::minutes(minutes));
+       return true;
+    }
+
+    if(seconds > 0 || isZeroSecond)
+    {
+       ::seconds s_seconds(seconds);
+       auto onlyDate = GetOnlyDateFromPoint(now);
+       hh_mm_ss time(now - onlyDate);
+       finish = onlyDate + time.hours() + time.minutes() + s_seconds;
+
+       if(now > finish) finish += ::minutes(1);
+
+       calculate = [s_seconds](const Now & now, Now & finish, bool recalc)
+       {
+          if(now > finish || recalc)
+          {
+             system_clock::time_point date = GetOnlyDateFromPoint(now);
+             hh_mm_ss time(now - date);
+             finish = date + time.hours() + time.minutes() + ::minutes(1) + s_seconds;
+
+             return !recalc;
+          }
+          return false;
+       };
+
+       return true;
+    }
+
+    return false;
+}
+
+//-------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+inline ReferenceTask::ReferenceTask(std::string_view value, const Now & now) : origin(now){ parseFromString(value); }
+
+inline bool ReferenceTask::isValid() const
+{
+    return (calculate) ? true : false;
+}
+
+inline bool ReferenceTask::taskCalculate(const Now &now, bool recalc) const
+{
+    if(calculate) return calculate(now, finish, recalc);
+    return false;
+}
+
+inline Now ReferenceTask::nextFire() const
+{
+    return finish;
+}
+
+inline ReferenceTask::Type ReferenceTask::taskType() const
+{
+    return type;
+}
+
+inline bool ReferenceTask::isSingle() const
+{
+    return (type == SinglePoint || type == SingleInterval);
+}
+
+inline bool ReferenceTask::pointDayTaskInit(const unsigned char seconds,
+                                            const unsigned char minutes,
+                                            const unsigned char hours,
+                                            const unsigned char day,
+                                            const unsigned char month)
+{
+    calculate = nullptr;
+    type = None;
+
+    //==============================================
+
+    if(seconds > 60 || minutes > 60 || hours > 24 || day > 31 || month > 12) return false;
+    if(seconds == 0 && minutes == 0 && hours == 0 && day == 0 && month == 0) return false;
+
+    unsigned char h = hours, m = minutes, s = seconds;
+    bool isZeroHour = false, isZeroMinute = false, isZeroSecond = false;
+
+    if(hours == 24)
+    {
+       isZeroHour = true;
+       h = 0;
+    }
+
+    if(minutes == 60)
+    {
+       isZeroMinute = true;
+       m = 0;
+    }
+
+    if(seconds == 60)
+    {
+       isZeroSecond = true;
+       s = 0;
+    }
+
+    //==============================================
+
+    type = Point;
+
+    //----------------
+
+    system_clock::time_point now = origin;
+
+    //----------------
+
+    if(day > 0 && month == 0)
+    {
+       dayPattern(calculate, finish, day, now, ::seconds(s) + ::minutes(m) + ::hours(h));
+       return true;
+    }
+
+    if(day == 0 && month > 0)
+    {
+       monthPattern(calculate, finish, month, now, ::seconds(s) + ::minutes(m) + ::hours(h));
+       return true;
+    }
+
+    if(day > 0 && month > 0)
+    {
+       if(!month_day{::month(month), ::day(day)}.ok()) return false;
+       dayMonthPattern(calculate, finish, day, month, now, ::seconds(s) + ::minutes(m) + ::hours(h));
+       return true;
+    }
+
+    if(onlyTimePattern(calculate, finish, s, m, h, now, isZeroHour, isZeroMinute, isZeroSecond)) return true;
+
+    type = None;
+
+    return false;
+}
+
+inline bool ReferenceTask::singlePointDayTaskInit(const unsigned char seconds,
+                                                  const unsigned char minutes,
+                                                  const unsigned char hours,
+                                                  const unsigned char day,
+                                                  const unsigned char month)
+{
+    if(pointDayTaskInit(seconds, minutes, hours, day, month))
+    {
+       type = SinglePoint;
+       return true;
+    }
+
+    return false;
+}
+
+
+inline bool ReferenceTask::pointWeekTaskInit(const unsigned char seconds,
+                                             const unsigned char minutes,
+                                             const unsigned char hours,
+                                             const unsigned char weekday)
+{
+    calculate = nullptr;
+    type = None;
+
+    //==============================================
+
+    if(seconds >= 60 || minutes >= 60 || hours >= 24 || weekday > 7) return false;
+    if(seconds == 0 && minutes == 0 && hours == 0 && weekday == 0) return false;
+
+    //==============================================
+
+    type = Point;
+
+    //----------------
+
+    system_clock::time_point now = origin;
+
+    //----------------
+
+    if(weekday > 0)
+    {
+       weekdayPattern(calculate, finish, weekday, now, ::seconds(seconds) + ::minutes(minutes) + ::hours(hours));
+       return true;
+    }
+
+    if(onlyTimePattern(calculate, finish, seconds, minutes, hours, now, false, false, false)) return true;
+
+    type = None;
+
+    return false;
+}
+
+inline bool ReferenceTask::singlePointWeekTaskInit(const unsigned char seconds,
+                                                   const unsigned char minutes,
+                                                   const unsigned char hours,
+                                                   const unsigned char weekday)
+{
+    if(pointWeekTaskInit(seconds, minutes, hours, weekday))
+    {
+       type = SinglePoint;
+       return true;
+    }
+
+    return false;
+}
+
+inline bool ReferenceTask::intervalTaskInit(const unsigned char seconds,
+                                            const unsigned char minutes,
+                                            const unsigned char hours,
+                                            const unsigned short days)
+{
+    calculate = nullptr;
+    type = None;
+
+    //==============================================
+
+    if(seconds >= 60 || minutes >= 60 || hours >= 24) return false;
+    if(seconds == 0 && minutes == 0 && hours == 0 && days == 0) return false;
+
+    //==============================================
+
+    type = Point;
+
+    const ::seconds interval = ::seconds(seconds) + ::minutes(minutes) + ::hours(hours) + ::days(days);
+    finish = origin + interval;
+
+    calculate = [interval](const Now & now, Now & finish, bool recalc)
+    {
+       if(now > finish || recalc)
+       {
+          finish = now + interval;
+
+          return !recalc;
+       }
+       else return false;
+    };
+
+    return true;
+}
+
+inline bool ReferenceTask::singleIntervalTaskInit(const unsigned char seconds,
+                                                  const unsigned char minutes,
+                                                  const unsigned char hours,
+                                                  const unsigned short days)
+{
+    if(intervalTaskInit(seconds, minutes, hours, days))
+    {
+       type = SingleInterval;
+       return true;
+    }
+
+    return false;
+}
+
+static bool parsePoint(int offset, std::string_view value, const std::function<bool(unsigned char,unsigned char,unsigned char,unsigned char,unsigned char)> & func)
+{
+    if(value[4 + offset] != '/' || value[7 + offset] != ' ' || value[10 + offset] != ':' || value[13 + offset] != ':') return false;
+
+    std::string_view sd = value.substr(2 + offset,2);
+    if(!std::isdigit(sd[0]) || !std::isdigit(sd[1])) return false;
+
+    unsigned char day;
+    std::from_chars(sd.begin(), sd.end(), day);
+
+    std::string_view sm = value.substr(5 + offset,2);
+    if(!std::isdigit(sm[0]) || !std::isdigit(sm[1])) return false;
+
+    unsigned char month;
+    std::from_chars(sm.begin(), sm.end(), month);
+
+    std::string_view th = value.substr(8 + offset,2);
+    if(!std::isdigit(th[0]) || !std::isdigit(th[1])) return false;
+
+    unsigned char hours;
+    std::from_chars(th.begin(), th.end(), hours);
+
+    std::string_view tm = value.substr(11 + offset,2);
+    if(!std::isdigit(tm[0]) || !std::isdigit(tm[1])) return false;
+
+    unsigned char minutes;
+    std::from_chars(tm.begin(), tm.end(), minutes);
+
+    std::string_view ts = value.substr(14 + offset,2);
+    if(!std::isdigit(ts[0]) || !std::isdigit(ts[1])) return false;
+
+    unsigned char seconds;
+    std::from_chars(ts.begin(), ts.end(), seconds);
+
+    if(func) return func(seconds, minutes, hours, day, month);
+
+    return false;
+}
+
+static bool parseInterval(int offset, std::string_view value, const std::function<bool(unsigned char,unsigned char,unsigned char,unsigned short)> & func)
+{
+    if(value[7 + offset] != ' ' || value[10 + offset] != ':' || value[13 + offset] != ':') return false;
+
+    std::string_view sd = value.substr(2 + offset,5);
+    if(!std::isdigit(sd[0]) || !std::isdigit(sd[1]) || !std::isdigit(sd[2]) || !std::isdigit(sd[3]) || !std::isdigit(sd[4])) return false;
+
+    unsigned short days;
+    if(std::from_chars(sd.begin(), sd.end(), days).ec != std::errc()) return false; //was left uninitialized above 65535
+
+    std::string_view th = value.substr(8 + offset,2);
+    if(!std::isdigit(th[0]) || !std::isdigit(th[1])) return false;
+
+    unsigned char hours;
+    std::from_chars(th.begin(), th.end(), hours);
+
+    std::string_view tm = value.substr(11 + offset,2);
+    if(!std::isdigit(tm[0]) || !std::isdigit(tm[1])) return false;
+
+    unsigned char minutes;
+    std::from_chars(tm.begin(), tm.end(), minutes);
+
+    std::string_view ts = value.substr(14 + offset,2);
+    if(!std::isdigit(ts[0]) || !std::isdigit(ts[1])) return false;
+
+    unsigned char seconds;
+    std::from_chars(ts.begin(), ts.end(), seconds);
+
+    if(func) return func(seconds, minutes, hours, days);
+
+    return false;
+}
+
+static bool parseWeek(int offset, std::string_view value, const std::function<bool(unsigned char,unsigned char,unsigned char,unsigned char)> & func)
+{
+    if(value[3 + offset] != ' ' || value[6 + offset] != ':' || value[9 + offset] != ':') return false;
+
+    std::string_view swd = value.substr(2 + offset,1);
+
+    if(!std::isdigit(swd[0])) return false;
+
+    unsigned char weekday;
+    std::from_chars(swd.begin(), swd.end(), weekday);
+
+    std::string_view th = value.substr(4 + offset,2);
+    if(!std::isdigit(th[0]) || !std::isdigit(th[1])) return false;
+
+    unsigned char hours;
+    std::from_chars(th.begin(), th.end(), hours);
+
+    std::string_view tm = value.substr(7 + offset,2);
+    if(!std::isdigit(tm[0]) || !std::isdigit(tm[1])) return false;
+
+    unsigned char minutes;
+    std::from_chars(tm.begin(), tm.end(), minutes);
+
+    std::string_view ts = value.substr(10 + offset,2);
+    if(!std::isdigit(ts[0]) || !std::isdigit(ts[1])) return false;
+
+    unsigned char seconds;
+    std::from_chars(ts.begin(), ts.end(), seconds);
+
+    if(func) return func(seconds, minutes, hours, weekday);
+
+    return false;
+}
+
+inline bool ReferenceTask::parseFromString(std::string_view value)
+{
+    if(value.starts_with("P "))
+    {
+       if(value.size() != 16) return false;
+
+       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char day, unsigned char month){
+                       return pointDayTaskInit(seconds,minutes,hours,day,month); };
+
+       return parsePoint(0, value, l);
+    }
+    else if(value.starts_with("SP "))
+    {
+       if(value.size() != 17) return false;
+
+       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char day, unsigned char month){
+                       return singlePointDayTaskInit(seconds,minutes,hours,day,month); };
+
+       return parsePoint(1, value, l);
+    }
+    else if(value.starts_with("W "))
+    {
+       if(value.size() != 12) return false;
+
+       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char weekday){
+                       return pointWeekTaskInit(seconds,minutes,hours,weekday); };
+
+       return parseWeek(0, value, l);
+    }
+    else if(value.starts_with("SW "))
+    {
+       if(value.size() != 13) return false;
+
+       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned char weekday){
+                       return singlePointWeekTaskInit(seconds,minutes,hours,weekday); };
+
+       return parseWeek(1, value, l);
+    }
+    else if(value.starts_with("I "))
+    {
+       if(value.size() != 16) return false;
+
+       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned short days){
+                       return intervalTaskInit(seconds,minutes,hours,days); };
+
+       return parseInterval(0,value,l);
+    }
+    else if(value.starts_with("SI "))
+    {
+       if(value.size() != 17) return false;
+
+       auto l = [this](unsigned char seconds, unsigned char minutes, unsigned char hours, unsigned short days){
+                       return singleIntervalTaskInit(seconds,minutes,hours,days); };
+
+       return parseInterval(1,value,l);
+    }
+
+    return false;
+}
+
+#endif // REFERENCETASK_H
@@ -0,0 +1,105 @@
+/* ShardedTasksController fires and stops
+
+   fires - the tasks are spread over the shards and each fires on the thread of its shard
+   stop  - a stop() before run() has started the shard threads is kept, a stop() from a callback stops every shard
+*/
+
+#include "Check.h"
+
+#include "ShardedTasksController.h"
+
+#include <future>
+#include <set>
+#include <thread>
+
+using namespace std::chrono;
+
+//------------------fires-----------------------------
+
+static void checkFires()
+{
+    ShardedTasksController controller(4);
+    CHECK(controller.shards() == 4);
+
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic_int fired = 0;
+
+    for(int i = 0; i < 400; i++)
+    {
+        controller.addTask(nameOf("t", i), "SI 00000 00:00:00.050", [&]
+        {
+            {
+              std::lock_guard<std::mutex>lock(mutex);
+              threads.insert(std::this_thread::get_id());
+            }
+
+            if(++fired == 400) controller.stop();
+        });
+    }
+
+    unsigned used[4] = {};
+    for(int i = 0; i < 400; i++) used[controller.shardOf(nameOf("t", i))]++;
+    for(unsigned count : used) CHECK(count > 50);
+
+    auto run = std::async(std::launch::async, [&]{ controller.run(); });
+
+    CHECK(run.wait_for(seconds(5)) == std::future_status::ready);
+    CHECK(fired == 400 && threads.size() == 4 && !controller.isRun());
+}
+
+//------------------stop------------------------------
+
+static void checkStop()
+{
+    ShardedTasksController controller(4);
+    for(int i = 0; i < 40; i++) controller.addTask(nameOf("t", i), "P 00/00 00:30:00");
+
+    //the stop() of another thread comes before run() has started the shards
+    std::size_t lost = 0;
+
+    for(int round = 0; round < 200; round++)
+    {
+        auto run = std::async(std::launch::async, [&]{ controller.run(); });
+        controller.stop();
+
+        if(run.wait_for(seconds(2)) != std::future_status::ready)
+        {
+           lost++;
+           controller.stop();
+        }
+
+        run.wait();
+    }
+
+    CHECK(lost == 0 && !controller.isRun());
+
+    //kept while nothing runs: the next run() returns at once, the one after it runs again
+    controller.stop();
+
+    const auto begin = steady_clock::now();
+    controller.run();
+    CHECK(steady_clock::now() - begin < milliseconds(500));
+
+    std::atomic_int fired = 0;
+    controller.addTask("stopper", "SI 00000 00:00:00.100", [&]{ fired++; controller.stop(); });
+
+    auto run = std::async(std::launch::async, [&]{ controller.run(); });
+    CHECK(run.wait_for(seconds(5)) == std::future_status::ready && fired == 1);
+
+    //stopAndJoin() of a running controller
+    controller.addTask("beat", "I 00000 00:00:00.010", [&]{ fired++; });
+    run = std::async(std::launch::async, [&]{ controller.run(); });
+
+    while(fired.load() < 5) std::this_thread::sleep_for(milliseconds(1));
+    CHECK(controller.stopAndJoin(milliseconds(3000)));
+    CHECK(run.wait_for(seconds(5)) == std::future_status::ready && !controller.isRun());
+}
+
+int main()
+{
+    checkFires();
+    checkStop();
+
+    return checkResult();
+}
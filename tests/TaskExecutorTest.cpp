@@ -0,0 +1,112 @@
+/* TaskExecutor stealing, draining and waits from its own workers
+
+   steal - the jobs queued behind a blocked worker are stolen and run by the others
+   drain - the destructor runs every queued job before it joins the workers
+   wait  - wait() and waitUntil() on a worker return at once instead of waiting for their own job
+*/
+
+#include "Check.h"
+
+#include "TaskExecutor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std::chrono;
+
+//------------------steal-----------------------------
+
+static void checkSteal()
+{
+    TaskExecutor pool(4);
+    CHECK(pool.size() == 4);
+
+    std::atomic_bool blocked = true;
+    std::atomic_int done = 0;
+    std::atomic<std::thread::id> slow;
+
+    pool.post([&]{ slow = std::this_thread::get_id(); while(blocked.load()) std::this_thread::sleep_for(milliseconds(1)); });
+    while(slow.load() == std::thread::id()) std::this_thread::yield();
+
+    std::vector<std::thread::id> ran(400);
+    for(std::size_t i = 0; i < ran.size(); i++) pool.post([&, i]{ ran[i] = std::this_thread::get_id(); std::this_thread::sleep_for(microseconds(50)); done++; });
+
+    const auto begin = steady_clock::now();
+    while(done.load() < int(ran.size()) && steady_clock::now() - begin < seconds(10)) std::this_thread::sleep_for(milliseconds(1));
+
+    CHECK(done.load() == int(ran.size())); //a quarter of them went to the deque of the blocked worker
+    CHECK(pool.pending() == 1);
+    CHECK(std::none_of(ran.begin(), ran.end(), [&](std::thread::id id){ return id == slow.load(); }));
+
+    blocked = false;
+    pool.wait();
+    CHECK(pool.pending() == 0);
+}
+
+//------------------drain-----------------------------
+
+static void checkDrain()
+{
+    std::atomic_int done = 0;
+
+    {
+        TaskExecutor pool(3);
+        for(int i = 0; i < 3000; i++) pool.post([&, i]{ std::this_thread::sleep_for(microseconds(i % 7 == 0 ? 100 : 1)); done++; });
+    }
+
+    CHECK(done.load() == 3000);
+
+    {
+        TaskExecutor pool(2); //jobs posted by jobs while the pool is being destroyed run too
+        for(int i = 0; i < 100; i++) pool.post([&]{ pool.post([&]{ done++; }); done++; });
+    }
+
+    CHECK(done.load() == 3200);
+}
+
+//------------------wait------------------------------
+
+static void checkWait()
+{
+    TaskExecutor pool(2);
+    TaskExecutor other(1);
+
+    std::atomic_bool waited = true;
+    std::atomic_bool worker = false;
+    std::atomic_bool otherWorker = true;
+    steady_clock::duration took{};
+
+    pool.post([&]
+    {
+        const auto begin = steady_clock::now();
+        waited = pool.waitUntil(begin + seconds(5));
+        pool.wait();
+        took = steady_clock::now() - begin;
+
+        worker = pool.isWorker();
+        otherWorker = other.isWorker();
+    });
+
+    pool.wait();
+
+    CHECK(!waited && took < seconds(1));
+    CHECK(worker && !otherWorker && !pool.isWorker());
+
+    //a worker of one pool can wait for another one
+    std::atomic_bool finished = false;
+    other.post([&]{ std::this_thread::sleep_for(milliseconds(20)); });
+    pool.post([&]{ finished = other.waitUntil(steady_clock::now() + seconds(5)); });
+    pool.wait();
+
+    CHECK(finished && other.pending() == 0);
+}
+
+int main()
+{
+    checkSteal();
+    checkDrain();
+    checkWait();
+
+    return checkResult();
+}
@@ -0,0 +1,325 @@
+/* FileLease membership and the task ownership of replicas sharing one lease file
+
+   hash range - 3 replicas with the same tasks fire each task once, the tasks of a replica that leaves
+                move to the others and the rest keep their owner
+   leader     - a leader that stops renewing is taken over after its ttl, and does not take the lead back
+   sharded    - the shards of a ShardedTasksController are one replica
+   hung peer  - renew() gives up while another process holds the lock, ownership comes back after it
+   unreadable - a renewal that cannot read the table fails and leaves the rows of the peers as they are
+   unlocked   - callers add tasks and read the ownership while the scheduler waits in the backend
+*/
+
+#include "Check.h"
+
+#include "TasksController.h"
+#include "ShardedTasksController.h"
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace std::chrono;
+
+//------------------hash range------------------------
+
+static void checkHashRange(const std::string & path)
+{
+    constexpr int replicas = 3;
+    constexpr int tasks = 3000;
+
+    auto clock = std::make_shared<ManualClock>(sys_days(2025y/1/1));
+
+    std::vector<std::unique_ptr<TasksController>> controllers;
+    std::vector<std::shared_ptr<FileLease>> leases;
+    std::vector<int> fired(tasks);
+    int fires[replicas] = {};
+
+    for(int r = 0; r < replicas; r++)
+    {
+        controllers.push_back(std::make_unique<TasksController>());
+        controllers[r]->setClock(clock);
+        controllers[r]->setMetrics(true);
+        leases.push_back(std::make_shared<FileLease>(path, milliseconds(500)));
+        CHECK(leases[r]->isOpen());
+    }
+
+    for(int r = 0; r < replicas; r++) CHECK(controllers[r]->setLease(leases[r], TasksController::HashRange));
+    for(int r = 0; r < replicas; r++) controllers[r]->setLease(leases[r], TasksController::HashRange); //each sees all of them now
+    for(int r = 0; r < replicas; r++) CHECK(controllers[r]->replicas() == replicas);
+
+    for(int r = 0; r < replicas; r++)
+        for(int i = 0; i < tasks; i++) controllers[r]->addTask(nameOf("t", i), "SI 00000 00:00:05", [&, i, r]{ fired[i]++; fires[r]++; });
+
+    clock->advance(seconds(6));
+    for(int r = 0; r < replicas; r++) controllers[r]->processDue();
+
+    CHECK(std::count(fired.begin(), fired.end(), 1) == tasks);
+
+    for(int r = 0; r < replicas; r++)
+    {
+        CHECK(fires[r] > tasks / 5);
+        CHECK(controllers[r]->metrics().unowned == std::uint64_t(tasks - fires[r])); //scheduled, fired elsewhere
+    }
+
+    std::vector<int> owner(tasks, -1);
+
+    for(int i = 0; i < tasks; i++)
+    {
+        int owners = 0;
+
+        for(int r = 0; r < replicas; r++)
+        {
+            if(controllers[r]->isOwner(nameOf("t", i))){ owner[i] = r; owners++; }
+        }
+
+        CHECK(owners == 1);
+    }
+
+    //replica 1 leaves: only its tasks move
+    controllers[1]->setLease(nullptr);
+    leases[1]->release();
+    controllers[0]->setLease(leases[0], TasksController::HashRange);
+    controllers[2]->setLease(leases[2], TasksController::HashRange);
+
+    std::size_t moved = 0;
+    std::size_t wrong = 0;
+
+    for(int i = 0; i < tasks; i++)
+    {
+        const bool first = controllers[0]->isOwner(nameOf("t", i));
+        const bool last = controllers[2]->isOwner(nameOf("t", i));
+
+        wrong += first == last;
+        if(owner[i] == 1) moved++;
+        else wrong += (first ? 0 : 2) != owner[i];
+    }
+
+    CHECK(wrong == 0 && moved > 0);
+
+    for(auto & lease : leases) lease->release();
+}
+
+//------------------leader----------------------------
+
+static void checkLeader(const std::string & path)
+{
+    auto first = std::make_shared<FileLease>(path, milliseconds(300));
+    auto second = std::make_shared<FileLease>(path, milliseconds(300));
+
+    TasksController leader, follower;
+    std::atomic_int leaderFires = 0;
+    std::atomic_int followerFires = 0;
+
+    leader.setLease(first);
+    std::this_thread::sleep_for(milliseconds(2)); //joined later
+    follower.setLease(second);
+
+    leader.addTask("beat", "I 00000 00:00:00.100", [&]{ leaderFires++; });
+    follower.addTask("beat", "I 00000 00:00:00.100", [&]{ followerFires++; });
+
+    CHECK(leader.isOwner("beat") && !follower.isOwner("beat"));
+
+    leader.start();
+    follower.start();
+    std::this_thread::sleep_for(milliseconds(500));
+
+    CHECK(leaderFires >= 2 && followerFires == 0);
+
+    CHECK(leader.stopAndJoin(milliseconds(1000))); //stops renewing but keeps its row, as a hung process
+
+    const auto stopped = steady_clock::now();
+    while(followerFires == 0 && steady_clock::now() - stopped < seconds(5)) std::this_thread::sleep_for(milliseconds(1));
+
+    CHECK(followerFires > 0);
+    CHECK(steady_clock::now() - stopped < seconds(3)); //ttl and one renewal period, with room for a loaded machine
+    CHECK(follower.isOwner("beat"));
+
+    CHECK(follower.stopAndJoin(milliseconds(1000)));
+
+    leader.setLease(first); //comes back after the follower
+    CHECK(!leader.isOwner("beat"));
+
+    follower.setLease(second);
+    CHECK(follower.replicas() == 2 && follower.isOwner("beat"));
+
+    first->release();
+    second->release();
+}
+
+//------------------sharded---------------------------
+
+static void checkSharded(const std::string & path)
+{
+    auto first = std::make_shared<FileLease>(path, milliseconds(500));
+    auto second = std::make_shared<FileLease>(path, milliseconds(500));
+
+    ShardedTasksController a(4), b(4);
+
+    a.setLease(first, TasksController::HashRange);
+    b.setLease(second, TasksController::HashRange);
+    a.setLease(first, TasksController::HashRange);
+
+    std::size_t wrong = 0;
+    for(int i = 0; i < 1000; i++) wrong += a.isOwner(nameOf("t", i)) == b.isOwner(nameOf("t", i)); //both or none
+
+    CHECK(wrong == 0);
+
+    first->release();
+    second->release();
+}
+
+//------------------hung peer-------------------------
+
+static void checkHungPeer(const std::string & path)
+{
+#ifndef WIN32
+    auto lease = std::make_shared<FileLease>(path, milliseconds(300));
+
+    TasksController controller;
+    CHECK(controller.setLease(lease) && controller.replicas() == 1 && controller.isOwner("x"));
+
+    const int peer = ::open(path.c_str(), O_RDWR);
+    CHECK(peer >= 0 && ::flock(peer, LOCK_EX) == 0);
+
+    std::vector<std::uint64_t> members;
+    const auto begin = steady_clock::now();
+
+    CHECK(!lease->renew(members));
+    CHECK(steady_clock::now() - begin < milliseconds(500)); //a few ms of retries, not the lifetime of the peer
+
+    controller.setLease(lease);
+    CHECK(controller.replicas() == 0 && !controller.isOwner("x")); //owns nothing while it cannot renew
+
+    ::flock(peer, LOCK_UN);
+    ::close(peer);
+
+    controller.setLease(lease);
+    CHECK(controller.replicas() == 1 && controller.isOwner("x"));
+#else
+    (void)path;
+#endif
+}
+
+//------------------unreadable------------------------
+
+static void checkUnreadable(const std::string & path)
+{
+#ifndef WIN32
+    FileLease peer(path, milliseconds(5000));
+    std::vector<std::uint64_t> members;
+    CHECK(peer.renew(members));
+
+    const int next = ::open("/dev/null", O_RDONLY); //the lowest free descriptor, the one the lease opens next
+    ::close(next);
+
+    FileLease lease(path, milliseconds(5000));
+    CHECK(lease.renew(members) && members.size() == 2);
+
+    auto table = [&]
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), {});
+    };
+
+    const std::string before = table();
+
+    const int writeOnly = ::open(path.c_str(), O_WRONLY);
+    CHECK(writeOnly >= 0 && ::dup2(writeOnly, next) == next); //its reads fail from now on, its writes would not
+    ::close(writeOnly);
+
+    CHECK(!lease.renew(members));
+    CHECK(table() == before); //the rows of the peer are not overwritten by a table that was never read
+
+    CHECK(peer.renew(members) && members.size() == 2 && members.front() == peer.id());
+#else
+    (void)path;
+#endif
+}
+
+//------------------unlocked--------------------------
+
+struct StalledLease final : TaskLease
+{
+    std::atomic_bool stalled = false;
+    std::atomic_bool entered = false;
+
+    std::uint64_t id() const override { return 7; }
+    milliseconds ttl() const override { return milliseconds(60); }
+
+    bool renew(std::vector<std::uint64_t> & members) override
+    {
+        if(stalled.load()){ entered = true; while(stalled.load()) std::this_thread::sleep_for(milliseconds(1)); }
+
+        members = {7};
+        return true;
+    }
+
+    void release() override {}
+};
+
+static void checkUnlocked(const std::string &)
+{
+    auto lease = std::make_shared<StalledLease>();
+
+    TasksController controller;
+    controller.addTask("beat", "I 00000 00:00:00.010");
+    CHECK(controller.setLease(lease) && controller.replicas() == 1);
+
+    CHECK(controller.start());
+    lease->stalled = true;
+
+    const auto begin = steady_clock::now();
+    while(!lease->entered.load() && steady_clock::now() - begin < seconds(5)) std::this_thread::sleep_for(milliseconds(1));
+    CHECK(lease->entered.load());
+
+    //the scheduler waits in the backend, the callers do not wait for it
+    std::atomic_bool returned = false, correct = false;
+
+    std::thread caller([&]
+    {
+        correct = controller.addTask("x", "I 00000 00:00:01").isValid() && controller.contains("x") &&
+                  controller.isOwner("x") && controller.replicas() == 1;
+        returned = true;
+    });
+
+    const auto called = steady_clock::now();
+    while(!returned.load() && steady_clock::now() - called < milliseconds(500)) std::this_thread::sleep_for(milliseconds(1));
+    CHECK(returned.load() && correct.load());
+
+    lease->stalled = false;
+    caller.join();
+
+    CHECK(controller.stopAndJoin(milliseconds(2000)));
+}
+
+int main()
+{
+#ifdef WIN32
+    std::puts("skipped, FileLease has no Windows backend");
+    return 0;
+#else
+    const std::filesystem::path dir = std::filesystem::temp_directory_path();
+    const std::string path = (dir / "TaskLeaseTest.lease").string();
+
+    for(void (*check)(const std::string &) : {checkHashRange, checkLeader, checkSharded, checkHungPeer, checkUnreadable, checkUnlocked})
+    {
+        std::filesystem::remove(path);
+        check(path);
+    }
+
+    std::filesystem::remove(path);
+
+    return checkResult();
+#endif
+}
@@ -0,0 +1,141 @@
+/* Task against the closures and the parser it replaced (ReferenceTask.h), and the bulk loader
+
+   schedule - the fires of every pattern over 300k random time steps, the same as the closures
+   parser   - 500k mutated schedules, accepted and rejected like the previous parser, with the same first fire,
+              built twice: with the SSE2 layout check and with TASKSCONTROLLER_NO_SIMD, its scalar loop
+   loader   - loadTasks() reports the rejected lines and adds the rest
+*/
+
+#include "Check.h"
+#include "ReferenceTask.h"
+
+#include "TasksController.h"
+
+#include <random>
+#include <string>
+
+static Now localOf(const ManualClock & clock) //what Task reads as now
+{
+    const auto utc = clock.utc();
+    return utc + TimeZone::local().period(utc).offset;
+}
+
+//------------------schedule--------------------------
+
+static void checkSchedules()
+{
+    const char * specs[] = {"P 14/11 15:44:32", "P 00/11 00:00:00", "P 05/00 15:35:01", "P 31/00 10:00:00", "P 29/02 01:00:00",
+                            "P 00/00 15:00:00", "P 00/00 24:00:00", "P 00/00 00:35:15", "P 00/00 00:60:00", "P 00/00 00:00:35",
+                            "P 00/00 00:00:60", "W 2 15:44:32", "W 7 23:59:59", "W 0 00:10:00", "SP 05/11 15:35:01"};
+
+    ManualClock clock(sys_days(2024y/1/1) + hours(7));
+    TaskClock::setCurrent(&clock);
+
+    for(const char * spec : specs)
+    {
+        std::mt19937 random(1);
+
+        Task task(spec);
+        ReferenceTask reference(spec, localOf(clock));
+
+        CHECK(task.isValid() && reference.isValid());
+        CHECK(task.nextFire() == reference.nextFire());
+
+        std::size_t mismatches = 0;
+        std::size_t fires = 0;
+
+        for(int step = 0; step < 300000; step++)
+        {
+            clock.advance(seconds(1 + random() % 600));
+
+            const Now now = localOf(clock);
+            const bool fired = task.taskCalculate(now, clock.steady(), false);
+
+            fires += fired;
+            if(fired != reference.taskCalculate(now, false) || task.nextFire() != reference.nextFire()) mismatches++;
+        }
+
+        if(mismatches) std::fprintf(stderr, "%s: %zu of 300000 steps differ\n", spec, mismatches);
+        CHECK(mismatches == 0 && fires > 0);
+    }
+
+    TaskClock::setCurrent(nullptr);
+}
+
+//------------------parser----------------------------
+
+static void checkParser()
+{
+    const char * bases[] = {"P 14/11 15:44:32", "SP 05/11 15:35:01", "W 2 15:44:32", "SW 7 23:59:59", "I 00003 15:23:05",
+                            "SI 00000 00:00:30", "P 00/00 24:60:60", "I 65535 00:00:01", "I 65536 00:00:01"};
+    const char alphabet[] = "0123456789 /:PSWIx";
+
+    ManualClock clock(sys_days(2024y/6/1) + hours(12));
+    TaskClock::setCurrent(&clock);
+
+    std::mt19937 random(3);
+    std::size_t mismatches = 0;
+    std::size_t valid = 0;
+
+    for(int i = 0; i < 500000; i++)
+    {
+        std::string value = bases[random() % std::size(bases)];
+
+        for(unsigned k = random() % 3; k > 0; k--) value[random() % value.size()] = alphabet[random() % (sizeof(alphabet) - 1)];
+        if(random() % 50 == 0) value.pop_back();
+
+        Task task(value);
+        ReferenceTask reference(value, localOf(clock));
+
+        valid += reference.isValid();
+
+        if(task.isValid() != reference.isValid() ||
+           (reference.isValid() && (task.nextFire() != reference.nextFire() || task.isSingle() != reference.isSingle())))
+        {
+           if(mismatches++ < 5) std::fprintf(stderr, "'%s': valid %d, previous parser %d\n", value.c_str(), task.isValid(), reference.isValid());
+        }
+    }
+
+    CHECK(mismatches == 0);
+    CHECK(valid > 100000);
+
+    TaskClock::setCurrent(nullptr);
+}
+
+//------------------loader----------------------------
+
+static void checkLoader()
+{
+    const char * schedules[] = {"P 14/11 15:44:32", "W 2 15:44:32", "I 00001 00:00:00", "SI 00000 00:00:30", "C 0 30 8 * * MON-FRI"};
+
+    std::string lines;
+    for(int i = 0; i < 10000; i++) lines += "task" + std::to_string(i) + "\t" + schedules[i % std::size(schedules)] + "\n";
+    lines += "bad line\n\n# comment\ntask5\tP 14/11 15:44:32\nx\tP 99/11 15:44:32\r\ny\tW 3 10:00:00\r\n";
+
+    TasksController controller;
+    std::vector<TaskLoadError> errors;
+
+    CHECK(controller.loadTasks(lines, &errors) == 10001);
+    CHECK(controller.countTasks() == 10001 && controller.contains("y") && !controller.contains("x"));
+    CHECK(errors.size() == 3);
+
+    if(errors.size() == 3)
+    {
+       CHECK(errors[0].line == 10001 && errors[0].reason == TaskLoadError::Format);
+       CHECK(errors[1].line == 10004 && errors[1].reason == TaskLoadError::Duplicate);
+       CHECK(errors[2].line == 10005 && errors[2].reason == TaskLoadError::Schedule);
+    }
+
+    errors.clear();
+    CHECK(controller.loadTasksFromFile("/nonexistent/tasks.txt", &errors) == 0);
+    CHECK(errors.size() == 1 && errors[0].reason == TaskLoadError::File);
+}
+
+int main()
+{
+    checkSchedules();
+    checkParser();
+    checkLoader();
+
+    return checkResult();
+}
@@ -0,0 +1,931 @@
+/* TasksController, one section per feature
+
+   clock       - a year of monthly, weekly, interval, cron and delay-timer fires through advanceClock(),
+                 10k daily tasks through 30 days
+   pool        - a slow callback on the pool does not delay the others, stopAndJoin() from a callback returns at once
+   async       - the futures of the queued changes resolve with the result of the blocking calls, applied by run() or at once
+   handles     - a handle of a removed task is rejected after its slot is reused, pause(), resume() and clearTasks() while running
+   poll        - fileDescriptor() becomes readable at the next deadline and on changes, processDue() fires without run()
+   await       - coroutines suspended on nextFire() are resumed by each fire, and with false by remove() and clearTasks()
+   steps       - wall clock steps forward and back: the exact calendar fires after each, intervals keep their steady_clock cadence
+   overrun     - the fires of a slow callback on the pool under each overrun policy and under the cap on callbacks in flight
+   allocations - emplaceTask() and addTasks() allocate the node of the index and the array of the callbacks per task,
+                 a callable larger than a Callback is rejected by the constraints, not by a static_assert
+   preview     - nextOccurrences() and firesInWindow() against the fires advanceClock() produces over 26 days
+   lanes       - the tasks due together run in lane order, a critical task with its own worker runs ahead of queued bulk callbacks
+   splay       - the offsets spread the fires of tasks due together, keep their period, equal the preview
+                 and are the same in every controller and shard
+   shutdown    - a stop() right after start() and run(token) are never lost, stopAndJoin() does not wait for a run()
+                 on a thread of the caller, stop() returns while the scheduler holds the mutex
+*/
+
+#include "Check.h"
+
+#include "TasksController.h"
+#include "ShardedTasksController.h"
+
+#include <algorithm>
+#include <coroutine>
+#include <cstdlib>
+#include <future>
+#include <map>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+using namespace std::chrono;
+using Now = system_clock::time_point;
+
+//------------------clock-----------------------------
+
+static void checkClock()
+{
+    const Now start = sys_days(2025y/1/1);
+    auto clock = std::make_shared<ManualClock>(start);
+
+    {
+        TasksController controller;
+        CHECK(controller.setTimeZone("UTC"));
+        CHECK(controller.setClock(clock));
+
+        int monthly = 0, weekly = 0, daily = 0, cron = 0, timer = 0;
+        std::vector<Now> monthlyFires;
+
+        controller.addTask("monthly", "P 15/00 12:00:00", [&]{ monthly++; monthlyFires.push_back(clock->utc()); });
+        controller.addTask("weekly", "W 1 09:00:00", [&]{ weekly++; });
+        controller.addTask("daily", "I 00001 00:00:00", [&]{ daily++; });
+        controller.addTask("cron", "C 0 0-59/5 9-17 * * MON-FRI", [&]{ cron++; });
+        controller.addAfter(milliseconds(1500), [&]{ timer++; });
+        CHECK(!controller.setClock(nullptr)); //not while tasks are registered
+
+        controller.advanceClock(days(365));
+
+        CHECK(monthly == 12 && weekly == 52 && daily == 364 && timer == 1);
+        CHECK(cron == 261 * 108); //the working days of 2025
+        CHECK(clock->utc() == start + days(365));
+
+        for(Now fire : monthlyFires)
+        {
+            const auto day = floor<days>(fire);
+            CHECK(unsigned(year_month_day(day).day()) == 15 && fire - day >= hours(12) && fire - day < hours(12) + milliseconds(1));
+        }
+    }
+
+    {
+        ManualClock current(sys_days(2030y/6/1) + hours(10));
+        TaskClock::setCurrent(&current);
+        CHECK(Task("I 00000 01:00:00").nextSteadyFire() == current.steady() + hours(1));
+        TaskClock::setCurrent(nullptr);
+    }
+
+    TasksController controller;
+    controller.setTimeZone("UTC");
+    controller.setClock(std::make_shared<ManualClock>(start));
+
+    std::size_t fired = 0;
+    for(int i = 0; i < 10000; i++)
+    {
+        char value[32];
+        std::snprintf(value, sizeof(value), "P 00/00 %02d:%02d:%02d", 1 + i % 23, i % 60, (i / 60) % 60);
+        controller.addTask(nameOf("t", i), value, [&]{ fired++; });
+    }
+
+    CHECK(controller.advanceClock(days(30)) == 300000 && fired == 300000);
+}
+
+//------------------pool------------------------------
+
+static void checkPool()
+{
+    TasksController controller(1, 2);
+    CHECK(controller.threads() == 2);
+
+    std::atomic_int fast = 0;
+    std::atomic_bool slow = false;
+
+    controller.addTask("slow", "SI 00000 00:00:00.010", [&]{ slow = true; std::this_thread::sleep_for(milliseconds(800)); });
+    controller.addTask("fast", "I 00000 00:00:00.020", [&]{ fast++; });
+
+    CHECK(controller.start());
+    std::this_thread::sleep_for(milliseconds(400));
+
+    CHECK(slow && fast >= 10); //every 20 ms next to the slow callback
+
+    std::atomic_bool stopped = true;
+    std::atomic<steady_clock::duration> took{};
+
+    controller.addTask("stopper", "SI 00000 00:00:00.010", [&]
+    {
+        const auto begin = steady_clock::now();
+        stopped = controller.stopAndJoin(milliseconds(3000));
+        took = steady_clock::now() - begin;
+    });
+
+    const auto begin = steady_clock::now();
+    while(controller.isRun() && steady_clock::now() - begin < seconds(5)) std::this_thread::sleep_for(milliseconds(1));
+
+    CHECK(!controller.isRun()); //it stopped the controller
+    CHECK(controller.stopAndJoin(milliseconds(3000)));
+    CHECK(!stopped && took.load() < milliseconds(500)); //without waiting for itself until the timeout
+}
+
+//------------------async-----------------------------
+
+static void checkAsync()
+{
+    TasksController controller;
+
+    //stopped: applied at once under the mutex
+    std::future<TaskHandle> added = controller.addTaskAsync("a", "P 00/00 00:30:00");
+    CHECK(added.wait_for(seconds(0)) == std::future_status::ready);
+
+    const TaskHandle a = added.get();
+    CHECK(a.isValid() && controller.find("a") == a);
+
+    CHECK(!controller.addTaskAsync("a", "W 2 10:00:00").get().isValid()); //the name is in use
+    CHECK(!controller.addTaskAsync("b", "P 99/00 00:30:00").get().isValid());
+    CHECK(!controller.addTaskAsync("", "P 00/00 00:30:00").get().isValid());
+    CHECK(!controller.addTaskAsync("b", "P 00/00 00:30:00", {std::function<void()>()}).get().isValid());
+
+    CHECK(controller.addCallbacksAsync("a", {[]{}}).get());
+    CHECK(!controller.addCallbacksAsync("b", {[]{}}).get());
+    CHECK(controller.clearCallbacksAsync("a").get());
+    CHECK(!controller.clearCallbacksAsync("b").get());
+    CHECK(controller.removeTaskAsync("a").get() && !controller.contains("a"));
+    CHECK(!controller.removeTaskAsync("a").get());
+
+    //running: queued and applied by run() at the start of its next tick
+    std::atomic_int fires = 0;
+    controller.addTask("keep", "P 00/00 00:30:00");
+    CHECK(controller.start());
+
+    std::future<TaskHandle> beat = controller.addTaskAsync("beat", "I 00000 00:00:00.010", {[&]{ fires++; }});
+    CHECK(beat.wait_for(seconds(5)) == std::future_status::ready && beat.get().isValid());
+
+    std::vector<std::jthread> producers;
+    std::atomic_size_t accepted = 0;
+
+    for(int p = 0; p < 4; p++)
+    {
+        producers.emplace_back([&, p]
+        {
+            std::vector<std::future<TaskHandle>> futures;
+            for(int i = 0; i < 250; i++) futures.push_back(controller.addTaskAsync(nameOf("p", p * 1000 + i), "P 00/00 00:30:00"));
+            futures.push_back(controller.addTaskAsync("keep", "P 00/00 00:30:00")); //rejected
+
+            for(auto & future : futures) accepted += future.get().isValid();
+        });
+    }
+
+    producers.clear();
+    CHECK(accepted == 1000 && controller.countTasks() == 1002);
+
+    const auto begin = steady_clock::now();
+    while(fires.load() < 5 && steady_clock::now() - begin < seconds(5)) std::this_thread::sleep_for(milliseconds(1));
+    CHECK(fires.load() >= 5);
+
+    CHECK(controller.clearCallbacksAsync("beat").get());
+    const int cleared = fires.load();
+    std::this_thread::sleep_for(milliseconds(50));
+    CHECK(fires.load() <= cleared + 1); //a fire that held the callbacks before
+
+    CHECK(controller.addCallbacksAsync("beat", {[&]{ fires++; }}).get());
+    CHECK(controller.removeTaskAsync("beat").get() && !controller.contains("beat"));
+    CHECK(!controller.removeTaskAsync("beat").get());
+    CHECK(!controller.addCallbacksAsync("beat", {[]{}}).get());
+
+    CHECK(controller.stopAndJoin(milliseconds(3000)));
+
+    //stopped again: applied by the caller
+    CHECK(controller.removeTaskAsync("keep").get() && controller.countTasks() == 1000);
+}
+
+//------------------handles---------------------------
+
+template<typename Condition>
+static bool waitFor(Condition condition, milliseconds timeout = milliseconds(5000))
+{
+    const auto begin = steady_clock::now();
+    while(!condition() && steady_clock::now() - begin < timeout) std::this_thread::sleep_for(milliseconds(1));
+    return condition();
+}
+
+static void checkHandles()
+{
+    TasksController controller;
+
+    CHECK(!TaskHandle().isValid() && !controller.remove(TaskHandle()));
+
+    const TaskHandle first = controller.addTask("a", "P 00/00 00:30:00");
+    CHECK(controller.remove(first));
+
+    const TaskHandle second = controller.addTask("a", "W 2 10:00:00"); //the same slot, the next generation
+    CHECK(second.isValid() && second != first && controller.find("a") == second);
+
+    CHECK(!controller.contains(first) && controller.contains(second));
+    CHECK(!controller.remove(first) && !controller.pause(first) && !controller.resume(first) && !controller.isPaused(first));
+    CHECK(!controller.setPriority(first, TasksController::Critical) && !controller.setOverrun(first, TasksController::Skip));
+    CHECK(controller.nextOccurrences(first, 3).empty() && controller.nextOccurrences(second, 3).size() == 3);
+    CHECK(controller.pause(second) && controller.isPaused(second) && controller.contains("a"));
+    CHECK(controller.nextOccurrences(second, 3).empty());
+
+    CHECK(controller.remove("a") && !controller.contains(second) && !controller.resume(second));
+
+    //while running
+    std::atomic_int fires = 0;
+    const TaskHandle beat = controller.addTask("beat", "I 00000 00:00:00.010", [&]{ fires++; });
+    CHECK(controller.start());
+
+    CHECK(waitFor([&]{ return fires.load() >= 3; }));
+    CHECK(controller.pause(beat) && !controller.pause(beat) && controller.isPaused(beat));
+
+    int paused = fires.load();
+    std::this_thread::sleep_for(milliseconds(100));
+    CHECK(fires.load() <= paused + 1); //one that was dispatched before the pause
+
+    paused = fires.load();
+    CHECK(controller.resume(beat) && !controller.resume(beat) && !controller.isPaused(beat));
+    CHECK(waitFor([&]{ return fires.load() >= paused + 3; }));
+
+    for(int i = 0; i < 100; i++) controller.addTask(nameOf("t", i), "I 00000 00:00:00.005", [&]{ fires++; });
+
+    CHECK(controller.clearTasks() && controller.countTasks() == 0); //the baseline refused it while running
+    CHECK(!controller.contains(beat) && !controller.pause(beat) && controller.isRun());
+
+    std::this_thread::sleep_for(milliseconds(20));
+    const int cleared = fires.load();
+    std::this_thread::sleep_for(milliseconds(100));
+    CHECK(fires.load() == cleared);
+
+    const TaskHandle again = controller.addTask("beat", "I 00000 00:00:00.010", [&]{ fires++; });
+    CHECK(again.isValid() && again != beat);
+    CHECK(waitFor([&]{ return fires.load() >= cleared + 3; }));
+
+    CHECK(controller.stopAndJoin(milliseconds(3000)));
+}
+
+//------------------poll------------------------------
+
+#ifdef __linux__
+static bool readable(int fd, int timeout)
+{
+    pollfd entry = {fd, POLLIN, 0};
+    return ::poll(&entry, 1, timeout) == 1 && (entry.revents & POLLIN);
+}
+#endif
+
+static void checkPoll()
+{
+#ifdef __linux__
+    TasksController controller(1);
+
+    std::atomic_int fires = 0, timers = 0;
+    const auto begin = steady_clock::now();
+
+    controller.addTask("beat", "I 00000 00:00:00.100", [&]{ fires++; });
+
+    const int fd = controller.fileDescriptor();
+    CHECK(fd >= 0 && controller.fileDescriptor() == fd);
+
+    CHECK(readable(fd, 0)); //the first processDue() arms the deadline
+    CHECK(controller.processDue() == 0 && !readable(fd, 0));
+    CHECK(!readable(fd, 50)); //not before the deadline
+
+    CHECK(readable(fd, 1000));
+    CHECK(steady_clock::now() - begin >= milliseconds(100));
+    CHECK(controller.processDue() == 1 && fires == 1);
+    CHECK(steady_clock::now() - begin < milliseconds(400));
+
+    controller.addAfter(milliseconds(30), [&]{ timers++; });
+    CHECK(readable(fd, 0)); //a change wakes the loop at once
+    CHECK(controller.processDue() == 0);
+
+    CHECK(readable(fd, 1000) && controller.processDue() == 1 && timers == 1 && fires == 1);
+
+    std::size_t fired = 0;
+    while(fires.load() < 5 && steady_clock::now() - begin < seconds(5)){ if(readable(fd, 1000)) fired += controller.processDue(); }
+
+    CHECK(fires == 5 && fired == 4);
+    CHECK(steady_clock::now() - begin >= milliseconds(500));
+
+    //run() owns the schedule while it is active
+    CHECK(controller.start());
+    CHECK(waitFor([&]{ return fires.load() >= 6; }));
+    CHECK(controller.processDue() == 0);
+    CHECK(controller.stopAndJoin(milliseconds(3000)));
+
+    CHECK(readable(fd, 1000) && controller.processDue() <= 1); //the event loop takes over again
+#else
+    std::puts("poll: skipped, the descriptor is a Linux timerfd");
+#endif
+}
+
+//------------------await-----------------------------
+
+struct Detached //fire-and-forget coroutine
+{
+    struct promise_type
+    {
+        Detached get_return_object(){ return {}; }
+        std::suspend_never initial_suspend(){ return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void(){}
+        void unhandled_exception(){ std::terminate(); }
+    };
+};
+
+struct Waiter
+{
+    std::atomic_int fires = 0;
+    std::atomic_bool ended = false;
+    std::atomic<std::thread::id> thread;
+};
+
+static Detached awaitFires(TasksController & controller, TaskHandle handle, Waiter & waiter)
+{
+    while(true)
+    {
+        const bool fired = co_await controller.nextFire(handle); //not in the loop condition, GCC 12 miscompiles a co_await there
+        if(!fired) break;
+
+        waiter.thread = std::this_thread::get_id();
+        waiter.fires++;
+    }
+
+    waiter.ended = true; //removed
+}
+
+static void checkAwait()
+{
+    {
+        TasksController controller;
+        controller.setTimeZone("UTC");
+        controller.setClock(std::make_shared<ManualClock>(sys_days(2025y/1/1)));
+
+        Waiter waiters[3];
+        int callbacks = 0;
+
+        const TaskHandle hourly = controller.addTask("hourly", "P 00/00 00:30:00", [&]{ callbacks++; });
+        for(Waiter & waiter : waiters) awaitFires(controller, hourly, waiter);
+
+        CHECK(waiters[0].fires == 0 && !waiters[0].ended); //suspended
+
+        controller.advanceClock(hours(3));
+
+        for(Waiter & waiter : waiters) CHECK(waiter.fires == 3 && !waiter.ended && waiter.thread.load() == std::this_thread::get_id());
+        CHECK(callbacks == 3);
+
+        CHECK(controller.remove(hourly));
+        for(Waiter & waiter : waiters) CHECK(waiter.ended && waiter.fires == 3);
+
+        Waiter stale; //the handle of a removed task: not suspended, false at once
+        awaitFires(controller, hourly, stale);
+        CHECK(stale.ended && stale.fires == 0);
+
+        Waiter cleared[2];
+        const TaskHandle daily = controller.addTask("daily", "P 00/00 10:00:00");
+        for(Waiter & waiter : cleared) awaitFires(controller, daily, waiter);
+
+        controller.advanceClock(days(2));
+        CHECK(cleared[0].fires == 2 && cleared[1].fires == 2 && !cleared[0].ended);
+
+        controller.clearTasks();
+        CHECK(cleared[0].ended && cleared[1].ended);
+    }
+
+    //resumed by run() on its thread, and with false by a removal from another thread
+    TasksController controller;
+    Waiter waiter;
+    std::atomic<std::thread::id> scheduler;
+
+    const TaskHandle beat = controller.addTask("beat", "I 00000 00:00:00.010", [&]{ scheduler = std::this_thread::get_id(); });
+    awaitFires(controller, beat, waiter);
+
+    CHECK(controller.start());
+    CHECK(waitFor([&]{ return waiter.fires.load() >= 3; }));
+    CHECK(waiter.thread.load() == scheduler.load() && waiter.thread.load() != std::this_thread::get_id());
+
+    CHECK(controller.removeTaskAsync("beat").get());
+    CHECK(waitFor([&]{ return waiter.ended.load(); }));
+    CHECK(controller.stopAndJoin(milliseconds(3000)));
+}
+
+//------------------steps-----------------------------
+
+static void checkSteps()
+{
+    const Now start = sys_days(2025y/1/1);
+    auto clock = std::make_shared<ManualClock>(start);
+
+    TasksController controller;
+    controller.setTimeZone("UTC");
+    controller.setClock(clock);
+    controller.setMetrics(true);
+
+    //the fires in minutes since the start, advanceClock() fires a nanosecond after the deadline
+    std::vector<int> hourly, daily;
+    int interval = 0;
+
+    auto at = [&]{ return int(floor<minutes>(clock->utc() - start).count()); };
+
+    controller.addTask("hourly", "P 00/00 00:30:00", [&]{ hourly.push_back(at()); });
+    controller.addTask("daily", "P 00/00 07:00:00", [&]{ daily.push_back(at()); });
+    controller.addTask("interval", "I 00000 00:10:00", [&]{ interval++; });
+
+    controller.advanceClock(hours(2) + minutes(5));
+    CHECK(hourly == std::vector<int>({30, 90}) && daily.empty() && interval == 12);
+
+    //forward to 07:05 over five hourly fires and 07:00: each stepped-over schedule fires once at the step, then from the new time
+    clock->setUtc(start + hours(7) + minutes(5));
+    controller.advanceClock(minutes(90));
+
+    CHECK(hourly == std::vector<int>({30, 90, 425, 450, 510}));
+    CHECK(daily == std::vector<int>({425}));
+    CHECK(interval == 21); //every 10 minutes of steady_clock, the step does not move it
+
+    //back by 3 hours to 05:35: the repeated 06:30, 07:00 and 07:30 fire again
+    clock->setUtc(clock->utc() - hours(3));
+    controller.advanceClock(hours(2));
+
+    CHECK(hourly == std::vector<int>({30, 90, 425, 450, 510, 390, 450}));
+    CHECK(daily == std::vector<int>({425, 420}));
+    CHECK(interval == 33);
+
+    CHECK(controller.metrics().clockSteps == 2);
+}
+
+//------------------overrun---------------------------
+
+struct Overruns
+{
+    int runs = 0;
+    int most = 0; //runs at the same time
+    std::uint64_t skipped = 0;
+    std::uint64_t shed = 0;
+};
+
+//ten fires of an interval task whose callbacks block until all of them are dispatched and busy of them run
+static Overruns overrun(TasksController::Overrun policy, unsigned limit, int busy, std::size_t cap = 0)
+{
+    std::atomic_int runs = 0, running = 0, most = 0;
+    std::atomic_bool open = false;
+    Overruns result;
+
+    {
+        TasksController controller(1, 4);
+        controller.setClock(std::make_shared<ManualClock>(sys_days(2025y/1/1)));
+        controller.setMetrics(true);
+        controller.setMaxCallbacksInFlight(cap);
+
+        controller.addTask("slow", "I 00000 00:00:01", [&]
+        {
+            const int now = ++running;
+            for(int seen = most.load(); now > seen && !most.compare_exchange_weak(seen, now););
+
+            while(!open.load()) std::this_thread::sleep_for(milliseconds(1));
+
+            runs++;
+            running--;
+        });
+
+        CHECK(controller.setOverrun("slow", policy, limit));
+        CHECK(controller.advanceClock(milliseconds(10500)) == 10);
+
+        result.skipped = controller.metrics().skipped;
+        result.shed = controller.metrics().shed;
+
+        CHECK(waitFor([&]{ return running.load() == busy; }));
+        open = true; //the pool runs what was admitted before it is joined
+    }
+
+    result.runs = runs.load();
+    result.most = most.load();
+
+    return result;
+}
+
+static void checkOverrun()
+{
+    Overruns r = overrun(TasksController::Overlap, 0, 4);
+    CHECK(r.runs == 10 && r.most == 4 && r.skipped == 0); //one per worker of the pool
+
+    r = overrun(TasksController::Overlap, 2, 2);
+    CHECK(r.runs == 2 && r.most == 2 && r.skipped == 8);
+
+    r = overrun(TasksController::Skip, 0, 1);
+    CHECK(r.runs == 1 && r.most == 1 && r.skipped == 9);
+
+    r = overrun(TasksController::Coalesce, 0, 1); //nine fires merged into one run after the first
+    CHECK(r.runs == 2 && r.most == 1 && r.skipped == 8);
+
+    r = overrun(TasksController::Queue, 3, 1);
+    CHECK(r.runs == 4 && r.most == 1 && r.skipped == 6);
+
+    r = overrun(TasksController::Queue, 0, 1);
+    CHECK(r.runs == 10 && r.most == 1 && r.skipped == 0);
+
+    //the cap sheds the fires over it before the policy sees them
+    r = overrun(TasksController::Overlap, 0, 3, 3);
+    CHECK(r.runs == 3 && r.most == 3 && r.shed == 7 && r.skipped == 0);
+
+    r = overrun(TasksController::Queue, 0, 1, 1);
+    CHECK(r.runs == 1 && r.shed == 9 && r.skipped == 0);
+}
+
+//------------------allocations-----------------------
+
+static thread_local bool counting = false;
+static std::size_t allocations = 0;
+
+void * operator new(std::size_t size)
+{
+    if(counting) allocations++;
+    if(void * p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size){ return ::operator new(size); }
+
+//Out of line, see benchmark/TaskBenchmark.cpp
+[[gnu::noinline]] void operator delete(void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { ::operator delete(p); }
+void operator delete[](void * p) noexcept { ::operator delete(p); }
+void operator delete[](void * p, std::size_t) noexcept { ::operator delete(p); }
+
+struct Large
+{
+    char bytes[64] = {};
+    void operator()() const {}
+};
+
+template<typename F>
+concept Emplaceable = requires(TasksController & controller, F && callable) { controller.emplaceTask(std::string(), Task(), std::forward<F>(callable)); };
+
+static void checkAllocations()
+{
+    //the constraints reject a callable that does not fit, std::function takes it
+    static_assert(!std::is_constructible_v<TasksController::Callback, Large> && !Emplaceable<Large>);
+    static_assert(std::is_constructible_v<TasksController::Callback, std::function<void()>> && Emplaceable<void(*)()>);
+
+    const int count = 1000;
+    const Task task("I 00000 00:01:00");
+
+    TasksController controller;
+    controller.setClock(std::make_shared<ManualClock>(sys_days(2025y/1/1)));
+
+    std::vector<std::string> names;
+    for(int i = 0; i < count; i++) names.push_back(nameOf("t", i)); //in the small string buffer
+
+    auto measure = [&](auto && add) //after clearTasks() the slots, the heaps and the buckets of the index keep their capacity
+    {
+        for(int i = 0; i < count; i++) add(std::string(names[i]));
+        controller.clearTasks();
+
+        std::vector<std::string> moved = names;
+
+        allocations = 0;
+        counting = true;
+        for(int i = 0; i < count; i++) add(std::move(moved[i]));
+        counting = false;
+
+        CHECK(controller.countTasks() == std::size_t(count));
+        controller.clearTasks();
+
+        return allocations;
+    };
+
+    int fires = 0;
+
+    //the node of the index and the array of the callbacks, one of them without callbacks
+    CHECK(measure([&](std::string && name){ controller.emplaceTask(std::move(name), task); }) == std::size_t(count));
+    CHECK(measure([&](std::string && name){ controller.emplaceTask(std::move(name), task, [&]{ fires++; }, [&]{ fires--; }); }) == std::size_t(count) * 2);
+
+    std::vector<TasksController::Entry> entries(count);
+    for(int i = 0; i < count; i++) entries[i] = {names[i], task, {[&]{ fires++; }}};
+
+    controller.addTasks(entries); //grows the slots and the heaps
+    controller.clearTasks();
+
+    allocations = 0;
+    counting = true;
+    CHECK(controller.addTasks(std::move(entries)) == std::size_t(count));
+    counting = false;
+
+    CHECK(allocations == std::size_t(count) * 2);
+}
+
+//------------------preview---------------------------
+
+static void checkPreview()
+{
+    const Now start = sys_days(2025y/3/1);
+    auto clock = std::make_shared<ManualClock>(start);
+
+    TasksController controller;
+    controller.setTimeZone("UTC");
+    controller.setClock(clock);
+
+    const char * specs[] = {"P 00/00 00:30:00", "W 3 09:15:00", "P 15/00 12:00:00", "I 00000 02:30:00",
+                            "C 0 0-59/20 9-11 * * MON-FRI", "SP 20/03 08:00:00", "P 00/00 00:00:45"};
+
+    std::vector<std::pair<Now, std::string>> actual;
+
+    for(std::size_t i = 0; i < std::size(specs); i++)
+    {
+        const std::string name = nameOf("t", i);
+        controller.addTask(name, specs[i], [&, name]{ actual.push_back({clock->utc(), name}); });
+    }
+
+    const std::vector<Now> next = controller.nextOccurrences("t0", 3);
+    CHECK(next.size() == 3 && next[0] == start + minutes(30) && next[1] == start + minutes(90));
+    CHECK(controller.nextOccurrences("t5", 5).size() == 1);
+
+    const std::vector<Now> interval = controller.nextOccurrences(controller.find("t3"), 4);
+    CHECK(interval.size() == 4 && interval[1] - interval[0] == minutes(150));
+
+    const Now from = start + days(2) + hours(3) + seconds(7);
+    const Now to = start + days(25);
+
+    const auto window = controller.firesInWindow(from, to);
+    const auto first = controller.firesInWindow(from, to, 10);
+
+    CHECK(first.size() == 10);
+    for(std::size_t i = 0; i < first.size() && i < window.size(); i++) CHECK(first[i].time == window[i].time);
+    for(std::size_t i = 1; i < window.size(); i++) CHECK(window[i - 1].time <= window[i].time);
+
+    controller.advanceClock(days(26));
+
+    std::vector<std::pair<Now, std::string>> expected, previewed;
+
+    for(auto & [time, name] : actual)
+    {
+        const Now fire = floor<seconds>(time); //advanceClock() fires 1 ns after the deadline
+        if(fire >= from && fire < to) expected.push_back({fire, name});
+    }
+
+    for(auto & occurrence : window) previewed.push_back({occurrence.time, occurrence.name});
+
+    std::sort(expected.begin(), expected.end());
+    std::sort(previewed.begin(), previewed.end());
+
+    CHECK(!expected.empty() && previewed == expected);
+    CHECK(controller.firesInWindow(from, to).empty()); //all of them are in the past now
+
+    const std::vector<Now> daily = Task("P 00/00 15:00:00").nextOccurrences(3);
+    CHECK(daily.size() == 3 && daily[1] - daily[0] == days(1) && daily[2] - daily[1] == days(1));
+}
+
+
+//------------------lanes-----------------------------
+
+static void checkLanes()
+{
+    auto clock = std::make_shared<ManualClock>(sys_days(2025y/1/1));
+
+    {
+        TasksController controller; //on the calling thread: the tasks due together run in lane order, added in reverse
+        controller.setClock(clock);
+
+        std::string order;
+        const std::pair<char, TasksController::Priority> lanes[] = {{'l', TasksController::Low}, {'n', TasksController::Normal},
+                                                                    {'h', TasksController::High}, {'c', TasksController::Critical}};
+
+        for(auto [letter, lane] : lanes)
+        {
+            const std::string name(1, letter);
+            controller.addTask(name, "I 00000 00:01:00", [&, letter]{ order += letter; });
+            CHECK(controller.setPriority(name, lane));
+        }
+
+        controller.advanceClock(seconds(150));
+        CHECK(order == "chnlchnl");
+    }
+
+    //one shared worker blocked by a bulk callback, the critical task fires on its own worker meanwhile
+    TasksController controller(1, 1);
+    controller.setClock(clock);
+    CHECK(controller.setLaneWorkers(TasksController::Critical, 1) && controller.laneWorkers(TasksController::Critical) == 1);
+
+    std::atomic_bool open = false;
+    std::atomic_int bulk = 0, critical = 0;
+    std::atomic<std::thread::id> bulkThread, criticalThread;
+
+    for(int i = 0; i < 5; i++)
+    {
+        controller.addTask(nameOf("bulk", i), "I 00000 00:01:00", [&]
+        {
+            bulkThread = std::this_thread::get_id();
+            while(!open.load()) std::this_thread::sleep_for(milliseconds(1));
+            bulk++;
+        });
+
+        controller.setPriority(nameOf("bulk", i), TasksController::Low);
+    }
+
+    controller.addTask("critical", "I 00000 00:01:00", [&]{ criticalThread = std::this_thread::get_id(); critical++; });
+    controller.setPriority("critical", TasksController::Critical);
+
+    controller.advanceClock(seconds(150)); //two ticks: ten bulk callbacks queued behind the first one
+
+    CHECK(waitFor([&]{ return critical.load() == 2; }));
+    CHECK(bulk.load() == 0); //ahead of every queued bulk callback
+
+    open = true;
+    CHECK(waitFor([&]{ return bulk.load() == 10; }));
+    CHECK(criticalThread.load() != bulkThread.load() && criticalThread.load() != std::this_thread::get_id());
+}
+
+//------------------splay-----------------------------
+
+static void checkSplay()
+{
+    const Now start = sys_days(2025y/1/1);
+
+    for(milliseconds window : {milliseconds(0), milliseconds(60000), milliseconds(2 * 3600 * 1000)})
+    {
+        auto clock = std::make_shared<ManualClock>(start);
+
+        TasksController controller;
+        controller.setTimeZone("UTC");
+        controller.setClock(clock);
+
+        std::map<std::string, std::vector<Now>> fired;
+
+        for(int i = 0; i < 1000; i++)
+        {
+            const std::string calendar = nameOf("calendar", i);
+            const std::string interval = nameOf("interval", i);
+            controller.addTask(calendar, "P 00/00 00:30:00", [&, calendar]{ fired[calendar].push_back(clock->utc()); });
+            controller.addTask(interval, "I 00000 01:00:00", [&, interval]{ fired[interval].push_back(clock->utc()); });
+        }
+
+        controller.addTask("own", "P 00/00 00:30:00", [&]{ fired["own"].push_back(clock->utc()); });
+
+        CHECK(controller.setSplay(window) && controller.splay() == window);
+        CHECK(controller.setSplay("own", milliseconds(0)));
+
+        const std::vector<std::size_t> density = controller.fireDensity(start + hours(3), start + hours(6));
+        std::size_t total = 0;
+        for(std::size_t count : density) total += count;
+
+        const std::size_t peak = *std::max_element(density.begin(), density.end());
+
+        CHECK(total == 3 * 2001);
+        CHECK((window.count() == 0) ? peak >= 1001 : peak < 100);
+
+        const auto preview = controller.firesInWindow(start, start + hours(10));
+        controller.advanceClock(hours(10));
+
+        std::map<std::string, std::vector<Now>> previewed;
+        for(auto & occurrence : preview) previewed[occurrence.name].push_back(occurrence.time);
+
+        std::size_t mismatches = 0;
+
+        for(auto & [name, times] : fired)
+        {
+            const std::vector<Now> & expected = previewed[name];
+            if(expected.size() != times.size()){ mismatches++; continue; }
+
+            for(std::size_t i = 0; i < times.size(); i++) mismatches += abs(times[i] - expected[i]) >= milliseconds(1);
+            for(std::size_t i = 1; i < times.size(); i++) mismatches += abs(times[i] - times[i - 1] - hours(1)) >= milliseconds(20); //the period is kept
+        }
+
+        CHECK(mismatches == 0);
+        CHECK(fired["own"].front() - start < minutes(30) + milliseconds(20)); //its own window of 0
+    }
+
+    //the offset depends only on the name and the window: the same in another controller, after a pause and in shards
+    TasksController first, second;
+    ShardedTasksController sharded(4);
+
+    first.setTimeZone("UTC");
+    second.setTimeZone("UTC");
+    second.setSplay(seconds(60));
+    sharded.setSplay(seconds(60));
+
+    for(int i = 0; i < 50; i++)
+    {
+        const std::string name = nameOf("x", i);
+        first.addTask(name, "P 00/00 00:30:00");
+        second.addTask(name, "P 00/00 00:30:00");
+        sharded.addTask(name, "P 00/00 00:30:00");
+    }
+
+    first.pause(first.find("x3"));
+    first.setSplay(seconds(60));
+    first.resume(first.find("x3"));
+
+    for(int i = 0; i < 50; i++)
+    {
+        const std::string name = nameOf("x", i);
+        CHECK(first.nextOccurrences(name, 1) == second.nextOccurrences(name, 1));
+        CHECK(sharded.nextOccurrences(name, 1) == second.nextOccurrences(name, 1));
+    }
+
+    const Now now = system_clock::now();
+    CHECK(first.fireDensity(now, now + hours(2)) == sharded.fireDensity(now, now + hours(2)));
+}
+
+//------------------shutdown--------------------------
+
+static void checkShutdown()
+{
+    std::size_t lost = 0;
+
+    for(int i = 0; i < 100; i++)
+    {
+        TasksController controller;
+        controller.addTask("far", "P 00/00 00:30:00");
+
+        CHECK(controller.start());
+        controller.stop();
+
+        const auto begin = steady_clock::now();
+        CHECK(controller.stopAndJoin(milliseconds(2000)));
+        if(steady_clock::now() - begin > milliseconds(500) || controller.isRun()) lost++;
+
+        CHECK(controller.stopToken().stop_requested());
+    }
+
+    CHECK(lost == 0);
+
+    TasksController controller;
+    controller.addTask("far", "P 00/00 00:30:00");
+
+    for(int i = 0; i < 3; i++)
+    {
+        std::jthread thread([&](std::stop_token token){ controller.run(token); });
+        while(!controller.isRun()) std::this_thread::yield();
+
+        thread.request_stop();
+        thread.join();
+        CHECK(!controller.isRun());
+    }
+
+    //stopAndJoin() stops a run() on a thread of the caller and returns false at once, the caller joins it
+    {
+       std::thread thread([&]{ controller.run(); });
+       while(!controller.isRun()) std::this_thread::yield();
+
+       const auto begin = steady_clock::now();
+       CHECK(!controller.stopAndJoin(milliseconds(2000)) && steady_clock::now() - begin < milliseconds(500));
+
+       thread.join();
+       CHECK(!controller.isRun() && controller.stopAndJoin(milliseconds(2000)));
+    }
+
+    //stop() and stopToken() take no lock: they return while the scheduler holds the mutex in a stalled clock
+    struct StalledClock final : TaskClock
+    {
+        mutable std::atomic_bool stalled = false, entered = false;
+
+        system_clock::time_point utc() const override
+        {
+            if(stalled.load()){ entered = true; while(stalled.load()) std::this_thread::sleep_for(milliseconds(1)); }
+            return system_clock::now();
+        }
+
+        steady_clock::time_point steady() const override { return steady_clock::now(); }
+    };
+
+    auto clock = std::make_shared<StalledClock>();
+    TasksController stalled;
+    stalled.setClock(clock);
+    stalled.addTask("often", "I 00000 00:00:00.010");
+
+    CHECK(stalled.start());
+    clock->stalled = true;
+    CHECK(waitFor([&]{ return clock->entered.load(); }));
+
+    std::atomic_bool returned = false, requested = false;
+    std::thread stopper([&]{ stalled.stop(); requested = stalled.stopToken().stop_requested(); returned = true; });
+
+    CHECK(waitFor([&]{ return returned.load(); }, milliseconds(500)));
+    CHECK(requested && !stalled.isRun());
+
+    clock->stalled = false;
+    stopper.join();
+    CHECK(stalled.stopAndJoin(milliseconds(2000)));
+}
+
+int main()
+{
+    checkClock();
+    checkPool();
+    checkAsync();
+    checkHandles();
+    checkPoll();
+    checkAwait();
+    checkSteps();
+    checkOverrun();
+    checkAllocations();
+    checkPreview();
+    checkLanes();
+    checkSplay();
+    checkShutdown();
+
+    return checkResult();
+}
@@ -0,0 +1,159 @@
+/* TimeZone periods at the transitions of POSIX rules, of a TZif file and of the installed database
+
+   rules    - European, southern hemisphere, US default and fixed rules: the offset on both sides of each
+              change and the bounds of the periods
+   tzif     - a TZif v2 file written here: its transitions, then the footer rule after the last one
+   database - Europe/Berlin and America/New_York in 2025 and in 2100, skipped without the IANA database
+*/
+
+#include "Check.h"
+
+#include "TimeZone.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace std::chrono;
+using Time = system_clock::time_point;
+
+static Time at(sys_days day, hours hour)
+{
+    return Time(day) + hour;
+}
+
+//one change of the offset at change (UTC): before holds up to it, after from it
+static void checkChange(const TimeZone & zone, Time change, seconds before, seconds after)
+{
+    const TimeZone::Period earlier = zone.period(change - seconds(1));
+    const TimeZone::Period later = zone.period(change);
+
+    CHECK(earlier.offset == before && earlier.end == change);
+    CHECK(later.offset == after && later.begin == change);
+}
+
+//------------------rules-----------------------------
+
+static void checkRules()
+{
+    const TimeZone europe("CET-1CEST,M3.5.0,M10.5.0/3");
+    CHECK(europe.isValid());
+    checkChange(europe, at(sys_days(2025y/3/30), hours(1)), hours(1), hours(2));
+    checkChange(europe, at(sys_days(2025y/10/26), hours(1)), hours(2), hours(1));
+    CHECK(europe.period(at(sys_days(2025y/7/1), hours(0))).end == at(sys_days(2025y/10/26), hours(1)));
+    checkChange(europe, at(sys_days(2040y/3/25), hours(1)), hours(1), hours(2));
+
+    const TimeZone sydney("AEST-10AEDT,M10.1.0,M4.1.0/3"); //summer over the new year
+    CHECK(sydney.isValid());
+    checkChange(sydney, at(sys_days(2025y/4/5), hours(16)), hours(11), hours(10));
+    checkChange(sydney, at(sys_days(2025y/10/4), hours(16)), hours(10), hours(11));
+    CHECK(sydney.period(at(sys_days(2026y/1/1), hours(0))).offset == hours(11));
+
+    const TimeZone us("EST5EDT"); //without dates: the US rule
+    CHECK(us.isValid());
+    checkChange(us, at(sys_days(2025y/3/9), hours(7)), hours(-5), hours(-4));
+    checkChange(us, at(sys_days(2025y/11/2), hours(6)), hours(-4), hours(-5));
+
+    const TimeZone fixed("<+0330>-3:30");
+    CHECK(fixed.isValid());
+    CHECK(fixed.period(at(sys_days(2025y/6/1), hours(0))).offset == hours(3) + minutes(30));
+    CHECK(fixed.period(at(sys_days(2025y/6/1), hours(0))).end == Time::max());
+
+    const TimeZone utc("UTC");
+    CHECK(utc.isValid() && utc.period(Time()).offset == seconds(0));
+    CHECK(TimeZone().isValid() && TimeZone().period(Time()).offset == seconds(0));
+
+    CHECK(!TimeZone("Nowhere/City").isValid());
+    CHECK(!TimeZone("../etc/passwd").isValid());
+    CHECK(!TimeZone("CET-1CEST,M3.5.0").isValid());
+    CHECK(!TimeZone("CET-1CEST,M13.5.0,M10.5.0").isValid());
+}
+
+//------------------tzif------------------------------
+
+static void appendBigEndian(std::string & out, std::uint64_t value, unsigned size)
+{
+    for(unsigned i = size; i > 0; i--) out.push_back(static_cast<char>(value >> ((i - 1) * 8)));
+}
+
+static std::string tzifFile(const std::int64_t (&times)[2]) //RFC 8536 version 2, CET/CEST of 2000, the footer rule after it
+{
+    std::string data;
+
+    for(unsigned timeSize : {4u, 8u})
+    {
+        data += "TZif2";
+        data.append(15, '\0');
+        for(std::uint32_t count : {0u, 0u, 0u, 2u, 2u, 8u}) appendBigEndian(data, count, 4); //isut, isstd, leap, time, type, char
+
+        for(std::int64_t time : times) appendBigEndian(data, static_cast<std::uint64_t>(time), timeSize);
+        data += '\1';
+        data += '\0';
+
+        appendBigEndian(data, 3600, 4); data += '\0'; data += '\0'; //CET
+        appendBigEndian(data, 7200, 4); data += '\1'; data += '\4'; //CEST
+        data.append("CET\0CEST", 8);
+    }
+
+    return data + "\nCET-1CEST,M3.5.0,M10.5.0/3\n";
+}
+
+static void checkTzif()
+{
+#if __cpp_lib_chrono >= 201907L || defined(WIN32)
+    std::puts("tzif: skipped, zones come from the tzdb of the standard library"); //a path is not a zone name there
+#else
+    const std::int64_t times[2] = {954032400, 972781200}; //2000-03-26 01:00, 2000-10-29 01:00 UTC
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "TimeZoneTest.tzif";
+
+    std::ofstream(path, std::ios::binary) << tzifFile(times);
+
+    const TimeZone zone(path.string());
+    CHECK(zone.isValid());
+
+    checkChange(zone, Time(seconds(times[0])), hours(1), hours(2));
+    checkChange(zone, Time(seconds(times[1])), hours(2), hours(1));
+    CHECK(zone.period(Time(seconds(times[1]))).end == at(sys_days(2001y/3/25), hours(1))); //from the footer
+    checkChange(zone, at(sys_days(2030y/10/27), hours(1)), hours(2), hours(1));
+
+    std::filesystem::remove(path);
+
+    std::ofstream(path, std::ios::binary) << tzifFile(times).substr(0, 60); //cut inside the data
+    CHECK(!TimeZone(path.string()).isValid());
+
+    std::filesystem::remove(path);
+#endif
+}
+
+//------------------database--------------------------
+
+static void checkDatabase()
+{
+    const TimeZone berlin("Europe/Berlin");
+    const TimeZone york("America/New_York");
+
+    if(!berlin.isValid() || !york.isValid())
+    {
+       std::puts("database: skipped, the IANA database is not installed");
+       return;
+    }
+
+    checkChange(berlin, at(sys_days(2025y/3/30), hours(1)), hours(1), hours(2));
+    checkChange(berlin, at(sys_days(2025y/10/26), hours(1)), hours(2), hours(1));
+    checkChange(berlin, at(sys_days(2100y/3/28), hours(1)), hours(1), hours(2)); //after the table of the file
+    checkChange(berlin, at(sys_days(2100y/10/31), hours(1)), hours(2), hours(1));
+    CHECK(berlin.period(at(sys_days(1970y/1/1), hours(0))).offset == hours(1));
+
+    checkChange(york, at(sys_days(2025y/3/9), hours(7)), hours(-5), hours(-4));
+    checkChange(york, at(sys_days(2025y/11/2), hours(6)), hours(-4), hours(-5));
+}
+
+int main()
+{
+    checkRules();
+    checkTzif();
+    checkDatabase();
+
+    return checkResult();
+}
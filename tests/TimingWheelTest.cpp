@@ -0,0 +1,166 @@
+/* TimingWheel expiry, cancel and delays in the past
+
+   expiry - timers on every level fire at the first advance() at or after their deadline and before one more
+            resolution has passed, also when a delay is cascaded down through the levels or parked in the top one
+   cancel - a cancelled timer never fires, cancel() after the expiry and with the handle of a reused node fails
+   past   - a delay at or before the origin of the wheel or its current tick fires on the next tick, never at once
+*/
+
+#include "Check.h"
+
+#include "TimingWheel.h"
+
+#include <random>
+
+using namespace std::chrono;
+using Clock = TimingWheel::Clock;
+
+//------------------expiry----------------------------
+
+static void checkExpiry(milliseconds resolution)
+{
+    TimingWheel wheel(resolution);
+    const Clock::time_point base = Clock::now();
+
+    std::vector<Clock::duration> delays;
+
+    for(std::int64_t level : {1LL, 1LL << 8, 1LL << 16, 1LL << 24, 1LL << 32}) //the first tick of each level and around it
+    {
+        for(std::int64_t ticks : {level - 1, level, level + 1})
+            if(ticks > 0) delays.push_back(resolution * ticks);
+    }
+
+    delays.push_back(resolution * ((1LL << 32) + 300)); //parked in the top level and cascaded again
+
+    std::mt19937_64 random(2);
+    for(int i = 0; i < 3000; i++) delays.push_back(nanoseconds(random() % (std::uint64_t(resolution.count()) << (8 + random() % 20)) * 1000000));
+
+    std::vector<Clock::time_point> at(delays.size()); //the now of the advance() that fired it
+    std::vector<Clock::time_point> previous(delays.size()); //of the advance() before
+    std::vector<std::function<void()>> expired;
+
+    Clock::time_point now = base;
+    Clock::time_point before = base;
+    std::size_t total = 0;
+
+    for(std::size_t i = 0; i < delays.size(); i++)
+    {
+        CHECK(wheel.add(base, delays[i], [&, i]{ at[i] = now; previous[i] = before; total++; }) != 0);
+    }
+
+    CHECK(wheel.size() == delays.size());
+
+    while(!wheel.empty())
+    {
+        const Clock::time_point next = wheel.nextExpiry();
+        CHECK(next > now);
+
+        //random steps up to the next expiry, past it or far beyond
+        switch(random() % 3)
+        {
+            case 0: now = next - nanoseconds(random() % 1000 + 1); break;
+            case 1: now = next + nanoseconds(random() % std::uint64_t(duration_cast<nanoseconds>(resolution).count())); break;
+            default: now = next + nanoseconds(random() % 5000000000ULL); break;
+        }
+
+        expired.clear();
+        wheel.advance(now, expired);
+
+        for(auto & callback : expired) callback();
+
+        before = now;
+    }
+
+    CHECK(total == delays.size());
+
+    std::size_t early = 0, late = 0;
+
+    for(std::size_t i = 0; i < delays.size(); i++)
+    {
+        const Clock::time_point deadline = base + delays[i];
+        early += at[i] < deadline;
+        late += previous[i] >= deadline + resolution; //an advance() before had passed it by a whole tick
+    }
+
+    CHECK(early == 0 && late == 0);
+}
+
+//------------------cancel----------------------------
+
+static void checkCancel()
+{
+    TimingWheel wheel;
+    const Clock::time_point base = Clock::now();
+
+    int fires = 0;
+    std::vector<TimingWheel::Timer> timers;
+
+    for(int i = 0; i < 1000; i++) timers.push_back(wheel.add(base, milliseconds(1 + i * 997 % 400000), [&]{ fires++; }));
+
+    std::size_t cancelled = 0;
+    for(std::size_t i = 0; i < timers.size(); i += 2) cancelled += wheel.cancel(timers[i]);
+
+    CHECK(cancelled == 500 && wheel.size() == 500);
+    CHECK(!wheel.cancel(timers[0]) && !wheel.contains(timers[0]) && wheel.contains(timers[1]));
+
+    std::vector<std::function<void()>> expired;
+    CHECK(wheel.advance(base + milliseconds(400001), expired) == 500);
+    for(auto & callback : expired) callback();
+
+    CHECK(fires == 500 && wheel.empty());
+    CHECK(!wheel.cancel(timers[1]) && !wheel.contains(timers[1])); //after the expiry
+
+    //the node of a fired timer is reused, its old handle does not reach the new timer
+    const TimingWheel::Timer reused = wheel.add(base, milliseconds(500000), [&]{ fires++; });
+    CHECK(static_cast<std::uint32_t>(reused) < 1000);
+
+    std::size_t stale = 0;
+    for(TimingWheel::Timer timer : timers) stale += wheel.cancel(timer);
+
+    CHECK(stale == 0 && wheel.contains(reused));
+    CHECK(wheel.cancel(reused) && wheel.empty());
+    CHECK(!wheel.cancel(0));
+}
+
+//------------------past------------------------------
+
+static void checkPast()
+{
+    const milliseconds resolution(10);
+
+    TimingWheel wheel(resolution);
+    const Clock::time_point base = Clock::now();
+
+    int fires = 0;
+    std::vector<std::function<void()>> expired;
+
+    wheel.add(base - hours(1), milliseconds(0), [&]{ fires++; }); //before the origin
+    wheel.add(base, -seconds(5), [&]{ fires++; });
+    CHECK(wheel.nextExpiry() <= base + resolution);
+
+    CHECK(wheel.advance(base + resolution * 2, expired) == 2);
+
+    const Clock::time_point now = base + seconds(10);
+    wheel.advance(now, expired);
+
+    wheel.add(now, milliseconds(0), [&]{ fires++; });
+    wheel.add(now, -milliseconds(20), [&]{ fires++; });
+    wheel.add(now - seconds(3), milliseconds(1), [&]{ fires++; });
+
+    CHECK(wheel.advance(now, expired) == 0); //the current tick has been expired already
+    CHECK(wheel.nextExpiry() <= now + resolution);
+    CHECK(wheel.advance(now + resolution, expired) == 3);
+
+    for(auto & callback : expired) callback();
+    CHECK(fires == 5 && wheel.empty());
+}
+
+int main()
+{
+    checkExpiry(milliseconds(1));
+    checkExpiry(milliseconds(7));
+    checkCancel();
+    checkPast();
+
+    return checkResult();
+}